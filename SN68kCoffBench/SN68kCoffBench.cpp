@@ -0,0 +1,511 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffbench - SNASM68K COFF parse benchmarks
+// ============================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "stdafx.h"
+
+#include "FileCOFF.h"
+#include "OutputStream.h"
+#include "Rebase.h"
+#include "SN68kCoffAPI.h"
+#include "Stats.h"
+#include "SyntheticCOFF.h"
+
+struct Arguments
+{
+	Arguments()
+	{
+		numIterations = 5;
+		numQueries = 1000000;
+		keepFiles = false;
+	}
+
+	SyntheticCOFF generator;
+	std::string inputFilename;
+	std::string outputFilename;
+	u32 numIterations;
+	u32 numQueries;
+	bool keepFiles;
+};
+
+void PrintUsage(OutputStream& stream)
+{
+	stream << "Usage:\n";
+	stream << "\tsn68kcoffbench [options]\n";
+	stream << "Options:\n";
+	stream << "\t-symbols [count]\tSymbols in generated file (default 100000)\n";
+	stream << "\t-lines [count]\t\tLine records in generated file (default 100000)\n";
+	stream << "\t\t\t\tAbove 65535, extra text sections are added past the three SNASM2 sections\n";
+	stream << "\t-relocations [count]\tROM section relocations in generated file (default 10000, max 65535, capped by ROM size)\n";
+	stream << "\t-linesperfile [count]\tLines per source file in generated file (default 4000)\n";
+	stream << "\t-seed [value]\t\tGenerator seed (default 1)\n";
+	stream << "\t-output [filename]\tGenerated file path (default sn68kcoffbench.cof)\n";
+	stream << "\t-input [filename]\tBenchmarks an existing COFF file instead of generating one\n";
+	stream << "\t-iterations [count]\tTimed runs per measurement, median is reported (default 5)\n";
+	stream << "\t-queries [count]\tLookups per throughput run (default 1000000)\n";
+	stream << "\t-generate\t\tOnly writes the generated file\n";
+	stream << "\t-keep\t\t\tKeeps generated COFF and index files\n";
+}
+
+bool FileExists(const std::string& filename)
+{
+	FILE* file = fopen(filename.c_str(), "rb");
+	if(file)
+	{
+		fclose(file);
+		return true;
+	}
+
+	return false;
+}
+
+u64 GetMedian(std::vector<u64>& samples)
+{
+	std::sort(samples.begin(), samples.end());
+	return samples[samples.size() / 2];
+}
+
+//Deterministic query sequence, same for every run and build
+u32 NextRandom(u32& state)
+{
+	state = state * 1664525 + 1013904223;
+	return state >> 8;
+}
+
+void PrintResult(OutputStream& stream, const char* name, u64 value, const char* unit)
+{
+	stream << name;
+	for(int i = (int)strlen(name); i < 32; i++)
+		stream << ' ';
+	stream << value;
+	if(*unit)
+		stream << ' ' << unit;
+	stream << "\n";
+}
+
+//Median wall time of loading the file, with or without the index cache
+bool BenchmarkLoad(const std::string& filename, bool useIndexCache, u32 numIterations, u64& medianNs, std::string& error)
+{
+	std::vector<u64> samples;
+
+	for(u32 i = 0; i < numIterations; i++)
+	{
+		FileCOFF* coffFile = new FileCOFF();
+
+		//Tables are decoded on demand, time the full decode
+		u64 startTime = GetTimeNs();
+		bool loaded = coffFile->Load(filename, useIndexCache) && coffFile->LoadSymbolTable() && coffFile->LoadLineTable();
+		u64 endTime = GetTimeNs();
+
+		if(!loaded)
+		{
+			error = coffFile->GetError();
+		}
+
+		//Unmap and free outside of the timed region
+		delete coffFile;
+
+		if(!loaded)
+		{
+			return false;
+		}
+
+		samples.push_back(endTime - startTime);
+	}
+
+	medianNs = GetMedian(samples);
+	return true;
+}
+
+//Random addresses over the range covering all lines and symbols, returns false if there's none
+bool GenerateQueryAddresses(const FileCOFF& coffFile, u32 numQueries, std::vector<u32>& addresses)
+{
+	u32 minAddress = 0xFFFFFFFF;
+	u32 maxAddress = 0;
+
+	if(coffFile.GetLineTable().GetCount() > 0)
+	{
+		minAddress = coffFile.GetLineTable().addresses.front();
+		maxAddress = coffFile.GetLineTable().endAddresses.back();
+	}
+
+	const ArrayView<FileCOFF::Symbol>& symbols = coffFile.GetSymbols();
+	const ArrayView<u32>& sortedIndices = coffFile.GetSortedSymbolIndices();
+
+	if(!sortedIndices.empty())
+	{
+		if(symbols[sortedIndices.front()].value < minAddress)
+			minAddress = symbols[sortedIndices.front()].value;
+		if(symbols[sortedIndices.back()].value + 1 > maxAddress)
+			maxAddress = symbols[sortedIndices.back()].value + 1;
+	}
+
+	if(maxAddress <= minAddress)
+	{
+		return false;
+	}
+
+	addresses.resize(numQueries);
+	u32 state = 1;
+	for(u32 i = 0; i < numQueries; i++)
+	{
+		addresses[i] = minAddress + (NextRandom(state) % (maxAddress - minAddress));
+	}
+
+	return true;
+}
+
+//Median nanoseconds per addr2line query, file/line plus nearest symbol as the tool does
+u64 BenchmarkAddressLookup(const FileCOFF& coffFile, u32 numQueries, u32 numIterations, u64& numFound)
+{
+	std::vector<u32> addresses;
+	if(!GenerateQueryAddresses(coffFile, numQueries, addresses))
+	{
+		return 0;
+	}
+
+	std::vector<u64> samples;
+
+	for(u32 i = 0; i < numIterations; i++)
+	{
+		numFound = 0;
+
+		u64 startTime = GetTimeNs();
+
+		for(u32 j = 0; j < numQueries; j++)
+		{
+			FileCOFF::LineInfo lineInfo;
+			if(coffFile.FindLine(addresses[j], lineInfo))
+				numFound++;
+			if(coffFile.FindNearestSymbol(addresses[j]))
+				numFound++;
+		}
+
+		samples.push_back(GetTimeNs() - startTime);
+	}
+
+	return (GetMedian(samples) + numQueries / 2) / numQueries;
+}
+
+//Median nanoseconds per containing function query, over the same addresses
+u64 BenchmarkFunctionLookup(const FileCOFF& coffFile, u32 numQueries, u32 numIterations, u64& numFound)
+{
+	std::vector<u32> addresses;
+	if(!GenerateQueryAddresses(coffFile, numQueries, addresses))
+	{
+		return 0;
+	}
+
+	std::vector<u64> samples;
+
+	for(u32 i = 0; i < numIterations; i++)
+	{
+		numFound = 0;
+
+		u64 startTime = GetTimeNs();
+
+		for(u32 j = 0; j < numQueries; j++)
+		{
+			if(coffFile.FindFunction(addresses[j]))
+				numFound++;
+		}
+
+		samples.push_back(GetTimeNs() - startTime);
+	}
+
+	return (GetMedian(samples) + numQueries / 2) / numQueries;
+}
+
+//Median nanoseconds per address query through the C API, with all lookups
+u64 BenchmarkAPIAddressLookup(const FileCOFF& coffFile, const SN68kCoffFile* apiFile, u32 numQueries, u32 numIterations, u64& numFound)
+{
+	std::vector<u32> addresses;
+	if(!GenerateQueryAddresses(coffFile, numQueries, addresses))
+	{
+		return 0;
+	}
+
+	std::vector<u64> samples;
+
+	for(u32 i = 0; i < numIterations; i++)
+	{
+		numFound = 0;
+
+		u64 startTime = GetTimeNs();
+
+		for(u32 j = 0; j < numQueries; j++)
+		{
+			SN68kCoffAddressInfo info;
+			if(SN68kCoffQueryAddress(apiFile, addresses[j], SN68KCOFF_QUERY_ALL, &info))
+				numFound++;
+		}
+
+		samples.push_back(GetTimeNs() - startTime);
+	}
+
+	return (GetMedian(samples) + numQueries / 2) / numQueries;
+}
+
+//Median nanoseconds per sym2addr query over existing names
+u64 BenchmarkSymbolLookup(const FileCOFF& coffFile, u32 numQueries, u32 numIterations, u64& numFound)
+{
+	if(coffFile.GetSymbols().empty())
+	{
+		return 0;
+	}
+
+	std::vector<const char*> names(numQueries);
+	u32 state = 2;
+	for(u32 i = 0; i < numQueries; i++)
+	{
+		names[i] = coffFile.GetSymbolName(coffFile.GetSymbols()[NextRandom(state) % coffFile.GetSymbols().size()]);
+	}
+
+	std::vector<u64> samples;
+
+	for(u32 i = 0; i < numIterations; i++)
+	{
+		numFound = 0;
+
+		u64 startTime = GetTimeNs();
+
+		for(u32 j = 0; j < numQueries; j++)
+		{
+			if(coffFile.FindSymbol(names[j]))
+				numFound++;
+		}
+
+		samples.push_back(GetTimeNs() - startTime);
+	}
+
+	return (GetMedian(samples) + numQueries / 2) / numQueries;
+}
+
+//Median nanoseconds to rebase the ROM section, copy included
+bool BenchmarkRebase(const FileCOFF& coffFile, u32 numIterations, u64& medianNs, std::string& error)
+{
+	const FileCOFF::SectionHeader& section = coffFile.m_sectionHeaders[COFF_SECTION_ROM_DATA];
+	std::vector<u8> data;
+	std::vector<u64> samples;
+
+	for(u32 i = 0; i < numIterations; i++)
+	{
+		RebaseResult result;
+
+		u64 startTime = GetTimeNs();
+		bool rebased = RebaseSection(coffFile, COFF_SECTION_ROM_DATA, section.virtualAddr + 0x10000, data, result, error);
+		u64 endTime = GetTimeNs();
+
+		if(!rebased)
+		{
+			return false;
+		}
+
+		samples.push_back(endTime - startTime);
+	}
+
+	medianNs = GetMedian(samples);
+	return true;
+}
+
+int RunBenchmarks(const Arguments& args, const std::string& filename, OutputStream& stream)
+{
+	std::string error;
+	u64 medianNs = 0;
+
+	std::string indexFilename = IndexCache::GetFilename(filename);
+	bool removeIndex = !args.keepFiles && !FileExists(indexFilename);
+
+	//Untimed load to warm the page cache, peak memory is for a single loaded file
+	u64 peakMemoryBeforeKB = GetPeakMemoryKB();
+	FileCOFF coffFile;
+	if(!coffFile.Load(filename) || !coffFile.LoadSymbolTable() || !coffFile.LoadLineTable())
+	{
+		stream << "Error: " << coffFile.GetError() << "\n";
+		return 1;
+	}
+
+	u64 peakMemoryLoadedKB = GetPeakMemoryKB();
+
+	//Aux records counted through their symbols
+	u64 numAuxRecords = 0;
+	for(u32 i = 0; i < coffFile.GetSymbols().size(); i++)
+	{
+		numAuxRecords += coffFile.GetSymbols()[i].auxCount;
+	}
+
+	PrintResult(stream, "symbols", coffFile.GetSymbols().size(), "");
+	PrintResult(stream, "aux_records", numAuxRecords, "");
+	PrintResult(stream, "line_records", coffFile.GetLineTable().GetCount(), "");
+	PrintResult(stream, "sections", coffFile.m_sectionHeaders.size(), "");
+	PrintResult(stream, "peak_memory_before_load", peakMemoryBeforeKB, "KB");
+	PrintResult(stream, "peak_memory_loaded", peakMemoryLoadedKB, "KB");
+
+	if(!BenchmarkLoad(filename, false, args.numIterations, medianNs, error))
+	{
+		stream << "Error: " << error << "\n";
+		return 1;
+	}
+
+	PrintResult(stream, "load_time", medianNs / 1000, "us");
+
+	//First index cache load builds the index, the rest read it
+	u64 startTime = GetTimeNs();
+	{
+		FileCOFF indexedFile;
+		if(!indexedFile.Load(filename, true) || !indexedFile.LoadSymbolTable())
+		{
+			stream << "Error: " << indexedFile.GetError() << "\n";
+			return 1;
+		}
+	}
+	PrintResult(stream, "index_cache_build_time", (GetTimeNs() - startTime) / 1000, "us");
+
+	if(!BenchmarkLoad(filename, true, args.numIterations, medianNs, error))
+	{
+		stream << "Error: " << error << "\n";
+		return 1;
+	}
+
+	PrintResult(stream, "index_cache_load_time", medianNs / 1000, "us");
+
+	if(removeIndex)
+	{
+		remove(indexFilename.c_str());
+	}
+
+	u64 numFound = 0;
+	u64 nsPerQuery = BenchmarkAddressLookup(coffFile, args.numQueries, args.numIterations, numFound);
+	PrintResult(stream, "addr2line_time", nsPerQuery, "ns/query");
+	PrintResult(stream, "addr2line_throughput", nsPerQuery ? (1000000000ull / nsPerQuery) : 0, "queries/s");
+	PrintResult(stream, "addr2line_hits", numFound, "");
+
+	nsPerQuery = BenchmarkFunctionLookup(coffFile, args.numQueries, args.numIterations, numFound);
+	PrintResult(stream, "function_lookup_time", nsPerQuery, "ns/query");
+	PrintResult(stream, "function_lookup_hits", numFound, "");
+
+	char apiError[256];
+	SN68kCoffFile* apiFile = SN68kCoffOpen(filename.c_str(), 0, apiError, sizeof(apiError));
+	if(!apiFile)
+	{
+		stream << "Error: " << apiError << "\n";
+		return 1;
+	}
+
+	nsPerQuery = BenchmarkAPIAddressLookup(coffFile, apiFile, args.numQueries, args.numIterations, numFound);
+	SN68kCoffClose(apiFile);
+
+	PrintResult(stream, "api_addr2line_time", nsPerQuery, "ns/query");
+	PrintResult(stream, "api_addr2line_hits", numFound, "");
+
+	startTime = GetTimeNs();
+	coffFile.BuildSymbolNameIndex();
+	PrintResult(stream, "symbol_index_build_time", (GetTimeNs() - startTime) / 1000, "us");
+
+	nsPerQuery = BenchmarkSymbolLookup(coffFile, args.numQueries, args.numIterations, numFound);
+	PrintResult(stream, "sym2addr_time", nsPerQuery, "ns/query");
+	PrintResult(stream, "sym2addr_throughput", nsPerQuery ? (1000000000ull / nsPerQuery) : 0, "queries/s");
+	PrintResult(stream, "sym2addr_hits", numFound, "");
+
+	if(coffFile.m_sectionHeaders.size() > COFF_SECTION_ROM_DATA)
+	{
+		if(!coffFile.LoadRelocations() || !BenchmarkRebase(coffFile, args.numIterations, medianNs, error))
+		{
+			stream << "Error: " << (error.empty() ? coffFile.GetError() : error) << "\n";
+			return 1;
+		}
+
+		PrintResult(stream, "relocations", coffFile.m_sectionHeaders[COFF_SECTION_ROM_DATA].numRelocationEntries, "");
+		PrintResult(stream, "rebase_time", medianNs / 1000, "us");
+	}
+
+	return 0;
+}
+
+int _tmain(int argc, _TCHAR* argv[])
+{
+	OutputStream textStream(stdout);
+
+	Arguments args;
+	args.outputFilename = "sn68kcoffbench.cof";
+	bool generateOnly = false;
+	bool argError = false;
+
+	for(int i = 1; i < argc; i++)
+	{
+		//Every option except flags needs a value
+		bool hasValue = (i < (argc - 1));
+
+		if(_stricmp(argv[i], "-generate") == 0)
+			generateOnly = true;
+		else if(_stricmp(argv[i], "-keep") == 0)
+			args.keepFiles = true;
+		else if(!hasValue)
+			argError = true;
+		else if(_stricmp(argv[i], "-symbols") == 0)
+			args.generator.numSymbols = strtoul(argv[++i], NULL, 10);
+		else if(_stricmp(argv[i], "-lines") == 0)
+			args.generator.numLines = strtoul(argv[++i], NULL, 10);
+		else if(_stricmp(argv[i], "-relocations") == 0)
+			args.generator.numRelocations = strtoul(argv[++i], NULL, 10);
+		else if(_stricmp(argv[i], "-linesperfile") == 0)
+			args.generator.linesPerFile = strtoul(argv[++i], NULL, 10);
+		else if(_stricmp(argv[i], "-seed") == 0)
+			args.generator.seed = strtoul(argv[++i], NULL, 10);
+		else if(_stricmp(argv[i], "-output") == 0)
+			args.outputFilename = argv[++i];
+		else if(_stricmp(argv[i], "-input") == 0)
+			args.inputFilename = argv[++i];
+		else if(_stricmp(argv[i], "-iterations") == 0)
+			args.numIterations = strtoul(argv[++i], NULL, 10);
+		else if(_stricmp(argv[i], "-queries") == 0)
+			args.numQueries = strtoul(argv[++i], NULL, 10);
+		else
+			argError = true;
+	}
+
+	if(argError || args.numIterations == 0 || args.numQueries == 0 || (generateOnly && !args.inputFilename.empty()))
+	{
+		PrintUsage(textStream);
+		return 1;
+	}
+
+	std::string filename = args.inputFilename;
+
+	if(filename.empty())
+	{
+		filename = args.outputFilename;
+
+		u64 startTime = GetTimeNs();
+		if(!args.generator.Write(filename))
+		{
+			textStream << "Error: " << args.generator.GetError() << "\n";
+			return 1;
+		}
+
+		if(generateOnly)
+		{
+			PrintResult(textStream, "generate_time", (GetTimeNs() - startTime) / 1000, "us");
+			return 0;
+		}
+	}
+
+	int result = RunBenchmarks(args, filename, textStream);
+
+	if(args.inputFilename.empty() && !args.keepFiles)
+	{
+		remove(filename.c_str());
+	}
+
+	return result;
+}
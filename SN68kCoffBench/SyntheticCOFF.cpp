@@ -0,0 +1,491 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffbench - SNASM68K COFF parse benchmarks
+// ============================================================
+
+#include <cstdio>
+#include <cstring>
+
+#include "SyntheticCOFF.h"
+#include "FileCOFF.h"
+
+#define SYNTHETIC_EXEC_HEADER_SIZE	28
+#define SYNTHETIC_TIMESTAMP			1453507200
+
+//Symbol storage classes
+#define SYNTHETIC_CLASS_EXTERNAL	2
+#define SYNTHETIC_CLASS_STATIC		3
+#define SYNTHETIC_CLASS_LABEL		6
+
+//Symbol type of routines, derived type function returning void
+#define SYNTHETIC_TYPE_FUNCTION		((COFF_DERIVED_TYPE_FUNCTION << COFF_SYMBOL_TYPE_DERIVED_SHIFT) | 1)
+
+static void WriteU8(OutputStream& stream, u8 value)
+{
+	stream.Write((const char*)&value, 1);
+}
+
+static void WriteU16(OutputStream& stream, u16 value)
+{
+	u8 bytes[2] = { (u8)value, (u8)(value >> 8) };
+	stream.Write((const char*)bytes, sizeof(bytes));
+}
+
+static void WriteU32(OutputStream& stream, u32 value)
+{
+	u8 bytes[4] = { (u8)value, (u8)(value >> 8), (u8)(value >> 16), (u8)(value >> 24) };
+	stream.Write((const char*)bytes, sizeof(bytes));
+}
+
+SyntheticCOFF::SyntheticCOFF()
+{
+	numSymbols = 100000;
+	numLines = 100000;
+	numRelocations = 10000;
+	linesPerFile = 4000;
+	baseAddress = 0x200;
+	seed = 1;
+
+	m_filenamesSize = 0;
+	m_stringTableSize = 0;
+	m_endAddress = 0;
+	m_numRelocations = 0;
+	m_numSymbolRecords = 0;
+}
+
+bool SyntheticCOFF::Write(const std::string& filename)
+{
+	m_error.clear();
+
+	if(linesPerFile == 0 || linesPerFile > SYNTHETIC_MAX_FILE_LINES)
+	{
+		m_error = "Lines per file must be between 1 and 32767";
+		return false;
+	}
+
+	PlanSections();
+
+	if(m_sections.size() + COFF_SECTION_ROM_DATA > 0xFFFF)
+	{
+		m_error = "Too many line records";
+		return false;
+	}
+
+	if(numRelocations > SYNTHETIC_MAX_RELOCATIONS)
+	{
+		m_error = "Too many relocations";
+		return false;
+	}
+
+	FILE* file = fopen(filename.c_str(), "wb");
+	if(!file)
+	{
+		m_error = "Could not create file " + filename;
+		return false;
+	}
+
+	{
+		OutputStream stream(file, 1024 * 1024);
+
+		WriteHeaders(stream);
+
+		//Filenames section data
+		char name[64];
+		for(u32 i = 0; i < GetNumFiles(); i++)
+		{
+			GetFilename(i, name, sizeof(name));
+			stream.Write(name, strlen(name) + 1);
+		}
+
+		for(int i = 0; i < m_sections.size(); i++)
+		{
+			WriteSectionData(stream, m_sections[i]);
+		}
+
+		for(int i = 0; i < m_sections.size(); i++)
+		{
+			WriteLineTable(stream, m_sections[i]);
+		}
+
+		WriteRelocations(stream);
+
+		WriteSymbols(stream);
+		WriteStringTable(stream);
+	}
+
+	bool writeError = (ferror(file) != 0);
+
+	if(fclose(file) != 0 || writeError)
+	{
+		m_error = "Could not write file " + filename;
+		return false;
+	}
+
+	return true;
+}
+
+void SyntheticCOFF::PlanSections()
+{
+	m_sections.clear();
+
+	SectionPlan section;
+	section.address = baseAddress;
+	section.size = 0;
+	section.firstLine = 0;
+	section.numLines = 0;
+	section.numEntries = 0;
+
+	for(u32 i = 0; i < numLines; i++)
+	{
+		//Each section and each new file starts with a filename record
+		bool newFile = (section.numEntries == 0) || ((i % linesPerFile) == 0);
+		u32 numEntries = newFile ? 2 : 1;
+
+		if(section.numEntries + numEntries > SYNTHETIC_MAX_SECTION_LINES)
+		{
+			//Line table full, continue in a new section
+			m_sections.push_back(section);
+
+			section.address += section.size;
+			section.size = 0;
+			section.firstLine = i;
+			section.numLines = 0;
+			section.numEntries = 0;
+			numEntries = 2;
+		}
+
+		section.size += GetInstructionSize(i);
+		section.numLines++;
+		section.numEntries += numEntries;
+	}
+
+	//Without lines, still give symbols an address range
+	if(numLines == 0)
+	{
+		section.size = (numSymbols * 4 > 0x1000) ? (numSymbols * 4) : 0x1000;
+	}
+
+	m_sections.push_back(section);
+	m_endAddress = section.address + section.size;
+
+	//Long fields in the ROM section, at most one per 4 bytes, and each needs a target symbol
+	m_numRelocations = (numSymbols > 0) ? numRelocations : 0;
+	if(m_numRelocations > m_sections[0].size / 4)
+	{
+		m_numRelocations = m_sections[0].size / 4;
+	}
+
+	m_filenamesSize = 0;
+	char name[64];
+	for(u32 i = 0; i < GetNumFiles(); i++)
+	{
+		GetFilename(i, name, sizeof(name));
+		m_filenamesSize += (u32)strlen(name) + 1;
+	}
+
+	m_stringTableSize = sizeof(u32);
+	for(u32 i = 0; i < numSymbols; i++)
+	{
+		GetSymbolName(i, name, sizeof(name));
+		u32 length = (u32)strlen(name);
+		if(length > COFF_SECTION_NAME_SIZE)
+		{
+			m_stringTableSize += length + 1;
+		}
+	}
+
+	//Table index of each symbol, functions are followed by an aux record
+	m_symbolRecords.resize(numSymbols);
+	m_numSymbolRecords = 0;
+	for(u32 i = 0; i < numSymbols; i++)
+	{
+		m_symbolRecords[i] = m_numSymbolRecords;
+		m_numSymbolRecords += IsFunction(i) ? 2 : 1;
+	}
+}
+
+void SyntheticCOFF::WriteHeaders(OutputStream& stream)
+{
+	u16 numSections = (u16)(m_sections.size() + COFF_SECTION_ROM_DATA);
+
+	u32 filenamesOffset = COFF_FILE_HEADER_SIZE + SYNTHETIC_EXEC_HEADER_SIZE + (numSections * COFF_SECTION_HEADER_SIZE);
+	u32 dataOffset = filenamesOffset + m_filenamesSize;
+
+	u32 lineTableOffset = dataOffset;
+	for(int i = 0; i < m_sections.size(); i++)
+	{
+		lineTableOffset += m_sections[i].size;
+	}
+
+	u32 relocationTableOffset = lineTableOffset;
+	for(int i = 0; i < m_sections.size(); i++)
+	{
+		relocationTableOffset += m_sections[i].numEntries * COFF_LINE_NUMBER_SIZE;
+	}
+
+	u32 symbolTableOffset = relocationTableOffset + (m_numRelocations * COFF_RELOCATION_SIZE);
+
+	//File header
+	WriteU16(stream, COFF_MACHINE_68000);
+	WriteU16(stream, numSections);
+	WriteU32(stream, SYNTHETIC_TIMESTAMP);
+	WriteU32(stream, symbolTableOffset);
+	WriteU32(stream, m_numSymbolRecords);
+	WriteU16(stream, SYNTHETIC_EXEC_HEADER_SIZE);
+	WriteU16(stream, 0);
+
+	//Executable header
+	WriteU16(stream, 0x10b);
+	WriteU16(stream, 1);
+	WriteU32(stream, m_sections[0].size);
+	WriteU32(stream, 0);
+	WriteU32(stream, 0);
+	WriteU32(stream, baseAddress);
+	WriteU32(stream, baseAddress);
+	WriteU32(stream, 0);
+
+	//SNASM2 fixed sections, then overflow text sections
+	WriteSectionHeader(stream, ".file", 0, m_filenamesSize, filenamesOffset, 0, 0, 0, 0, 0);
+	WriteSectionHeader(stream, ".dbg", 0, 0, 0, 0, 0, 0, 0, 0);
+
+	for(int i = 0; i < m_sections.size(); i++)
+	{
+		//Truncated to 8 characters in the header
+		char name[16];
+		if(i == 0)
+			strcpy(name, ".text");
+		else
+			snprintf(name, sizeof(name), ".text%d", i);
+
+		//Only the ROM section has relocations
+		const SectionPlan& section = m_sections[i];
+		u16 numSectionRelocations = (i == 0) ? (u16)m_numRelocations : 0;
+		WriteSectionHeader(stream, name, section.address, section.size, dataOffset, numSectionRelocations ? relocationTableOffset : 0, lineTableOffset, numSectionRelocations, (u16)section.numEntries, COFF_SECTION_FLAG_TEXT);
+
+		dataOffset += section.size;
+		lineTableOffset += section.numEntries * COFF_LINE_NUMBER_SIZE;
+	}
+}
+
+void SyntheticCOFF::WriteSectionHeader(OutputStream& stream, const char* name, u32 address, u32 size, u32 dataOffset, u32 relocationTableOffset, u32 lineTableOffset, u16 numRelocations, u16 numLineEntries, u32 flags)
+{
+	char paddedName[COFF_SECTION_NAME_SIZE] = { 0 };
+	strncpy(paddedName, name, COFF_SECTION_NAME_SIZE);
+	stream.Write(paddedName, COFF_SECTION_NAME_SIZE);
+
+	WriteU32(stream, address);
+	WriteU32(stream, address);
+	WriteU32(stream, size);
+	WriteU32(stream, dataOffset);
+	WriteU32(stream, relocationTableOffset);
+	WriteU32(stream, lineTableOffset);
+	WriteU16(stream, numRelocations);
+	WriteU16(stream, numLineEntries);
+	WriteU32(stream, flags);
+}
+
+void SyntheticCOFF::WriteSectionData(OutputStream& stream, const SectionPlan& section)
+{
+	//Noise standing in for code, one word at a time
+	for(u32 i = 0; i < section.size; i += 2)
+	{
+		u32 word = Random(section.address + i, 0);
+		WriteU8(stream, (u8)(word >> 8));
+
+		if(i + 1 < section.size)
+		{
+			WriteU8(stream, (u8)word);
+		}
+	}
+}
+
+void SyntheticCOFF::WriteLineTable(OutputStream& stream, const SectionPlan& section)
+{
+	u32 address = section.address;
+
+	for(u32 i = section.firstLine; i < section.firstLine + section.numLines; i++)
+	{
+		if(i == section.firstLine || (i % linesPerFile) == 0)
+		{
+			//Filename record, 1-based index
+			WriteU32(stream, (i / linesPerFile) + 1);
+			WriteU16(stream, 0);
+		}
+
+		WriteU32(stream, address);
+		WriteU16(stream, (u16)((i % linesPerFile) + 1));
+
+		address += GetInstructionSize(i);
+	}
+}
+
+void SyntheticCOFF::WriteRelocations(OutputStream& stream)
+{
+	const SectionPlan& section = m_sections[0];
+	u32 numFields = section.size / 4;
+
+	for(u32 i = 0; i < m_numRelocations; i++)
+	{
+		//Evenly spaced long fields, half absolute and half PC relative, against any symbol
+		u32 field = (u32)(((u64)numFields * i) / m_numRelocations);
+		u16 type = (Random(i, 4) & 1) ? COFF_RELOCATION_ABSOLUTE_LONG : COFF_RELOCATION_RELATIVE_LONG;
+
+		WriteU32(stream, section.address + (field * 4));
+		WriteU32(stream, m_symbolRecords[Random(i, 5) % numSymbols]);
+		WriteU16(stream, type);
+	}
+}
+
+void SyntheticCOFF::WriteSymbols(OutputStream& stream)
+{
+	u32 stringTableOffset = sizeof(u32);
+	int sectionIdx = 0;
+	char name[64];
+
+	for(u32 i = 0; i < numSymbols; i++)
+	{
+		GetSymbolName(i, name, sizeof(name));
+		u32 length = (u32)strlen(name);
+
+		if(length > COFF_SECTION_NAME_SIZE)
+		{
+			//Long name, zero marker then string table offset
+			WriteU32(stream, 0);
+			WriteU32(stream, stringTableOffset);
+			stringTableOffset += length + 1;
+		}
+		else
+		{
+			char shortName[COFF_SECTION_NAME_SIZE] = { 0 };
+			memcpy(shortName, name, length);
+			stream.Write(shortName, COFF_SECTION_NAME_SIZE);
+		}
+
+		//Addresses ascend, so the owning section only moves forwards
+		u32 address = GetSymbolAddress(i);
+		while(sectionIdx + 1 < m_sections.size() && address >= m_sections[sectionIdx + 1].address)
+		{
+			sectionIdx++;
+		}
+
+		bool function = IsFunction(i);
+
+		WriteU32(stream, address);
+		WriteU16(stream, (u16)(sectionIdx + COFF_SECTION_ROM_DATA + 1));
+		WriteU16(stream, function ? SYNTHETIC_TYPE_FUNCTION : 0);
+		WriteU8(stream, (u8)GetStorageClass(i));
+		WriteU8(stream, function ? 1 : 0);
+
+		if(function)
+		{
+			//Function aux record: tag index, size, line pointer, next function index, padding
+			WriteU32(stream, 0);
+			WriteU32(stream, GetFunctionSize(i));
+			WriteU32(stream, 0);
+			WriteU32(stream, 0);
+			WriteU16(stream, 0);
+		}
+	}
+}
+
+void SyntheticCOFF::WriteStringTable(OutputStream& stream)
+{
+	WriteU32(stream, m_stringTableSize);
+
+	char name[64];
+	for(u32 i = 0; i < numSymbols; i++)
+	{
+		GetSymbolName(i, name, sizeof(name));
+		u32 length = (u32)strlen(name);
+
+		if(length > COFF_SECTION_NAME_SIZE)
+		{
+			stream.Write(name, length + 1);
+		}
+	}
+}
+
+u32 SyntheticCOFF::Random(u32 index, u32 stream) const
+{
+	//Murmur3 finaliser over seed, stream and index
+	u32 hash = index ^ (seed * 0x9E3779B9) ^ (stream * 0x85EBCA6B);
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6B;
+	hash ^= hash >> 13;
+	hash *= 0xC2B2AE35;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+u32 SyntheticCOFF::GetInstructionSize(u32 line) const
+{
+	//68000 instructions are 2 to 10 bytes, short ones most common
+	static const u32 sizes[8] = { 2, 2, 2, 4, 4, 4, 6, 10 };
+	return sizes[Random(line, 2) & 7];
+}
+
+s8 SyntheticCOFF::GetStorageClass(u32 symbol) const
+{
+	//Mostly local labels, with some externals and statics
+	u32 kind = Random(symbol, 1) % 16;
+	return (kind == 0) ? SYNTHETIC_CLASS_EXTERNAL : ((kind == 1) ? SYNTHETIC_CLASS_STATIC : SYNTHETIC_CLASS_LABEL);
+}
+
+bool SyntheticCOFF::IsFunction(u32 symbol) const
+{
+	//External and static routines
+	return (Random(symbol, 3) % 4) == 0 && GetStorageClass(symbol) != SYNTHETIC_CLASS_LABEL;
+}
+
+u32 SyntheticCOFF::GetFunctionSize(u32 symbol) const
+{
+	//Up to the next routine, or the end of the code
+	u32 next = symbol + 1;
+	while(next < numSymbols && !IsFunction(next))
+	{
+		next++;
+	}
+
+	u32 endAddress = (next < numSymbols) ? GetSymbolAddress(next) : m_endAddress;
+	return endAddress - GetSymbolAddress(symbol);
+}
+
+u32 SyntheticCOFF::GetSymbolAddress(u32 symbol) const
+{
+	//Spread evenly over the code, word aligned
+	u64 range = m_endAddress - baseAddress;
+	return (baseAddress + (u32)((range * symbol) / numSymbols)) & ~1;
+}
+
+void SyntheticCOFF::GetSymbolName(u32 symbol, char* name, int nameSize) const
+{
+	//Mix of short names stored in the record and long names in the string table
+	switch(Random(symbol, 3) % 4)
+	{
+	case 0:
+		snprintf(name, nameSize, "Routine_%u_%s", symbol, (symbol & 1) ? "Update" : "Init");
+		break;
+	case 1:
+		snprintf(name, nameSize, "Data%u", symbol);
+		break;
+	case 2:
+		snprintf(name, nameSize, "@loop%u", symbol);
+		break;
+	default:
+		snprintf(name, nameSize, "L%x", symbol);
+		break;
+	}
+}
+
+void SyntheticCOFF::GetFilename(u32 file, char* name, int nameSize) const
+{
+	snprintf(name, nameSize, "src/module%04u.asm", file);
+}
+
+u32 SyntheticCOFF::GetNumFiles() const
+{
+	return (numLines + linesPerFile - 1) / linesPerFile;
+}
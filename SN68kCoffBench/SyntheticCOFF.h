@@ -0,0 +1,93 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffbench - SNASM68K COFF parse benchmarks
+// ============================================================
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "atoms.h"
+#include "OutputStream.h"
+
+//Max line number records per section, count is a u16 in the section header
+#define SYNTHETIC_MAX_SECTION_LINES	0xFFFF
+
+//Max relocations in the ROM section, count is a u16 in the section header
+#define SYNTHETIC_MAX_RELOCATIONS	0xFFFF
+
+//Max lines per source file, line numbers are s16
+#define SYNTHETIC_MAX_FILE_LINES	0x7FFF
+
+//Writes a deterministic SNASM68K COFF in the layout FileCOFF expects: the filenames,
+//debug and ROM sections, then line tables, ROM relocations, symbol table and string table.
+//Up to 65535 line records this is the three section SNASM2 layout. Beyond that, extra
+//text sections carry the overflow, which FileCOFF parses but sn68kcoffdump rejects.
+//Relocations are capped at one long field per 4 bytes of the ROM section. External and static
+//routines are typed as functions with an aux record holding their size, up to the next routine.
+//The same parameters and seed always produce an identical file.
+class SyntheticCOFF
+{
+public:
+	SyntheticCOFF();
+
+	bool Write(const std::string& filename);
+
+	//Reason the last Write failed
+	const std::string& GetError() const { return m_error; }
+
+	u32 numSymbols;
+	u32 numLines;
+	u32 numRelocations;
+	u32 linesPerFile;
+	u32 baseAddress;
+	u32 seed;
+
+private:
+	//Line-bearing section, the first one is the ROM section
+	struct SectionPlan
+	{
+		u32 address;
+		u32 size;
+		u32 firstLine;
+		u32 numLines;
+		u32 numEntries;
+	};
+
+	void PlanSections();
+	void WriteHeaders(OutputStream& stream);
+	void WriteSectionHeader(OutputStream& stream, const char* name, u32 address, u32 size, u32 dataOffset, u32 relocationTableOffset, u32 lineTableOffset, u16 numRelocations, u16 numLineEntries, u32 flags);
+	void WriteSectionData(OutputStream& stream, const SectionPlan& section);
+	void WriteLineTable(OutputStream& stream, const SectionPlan& section);
+	void WriteRelocations(OutputStream& stream);
+	void WriteSymbols(OutputStream& stream);
+	void WriteStringTable(OutputStream& stream);
+
+	//Stateless hash, so any record can be regenerated from its index alone
+	u32 Random(u32 index, u32 stream) const;
+
+	u32 GetInstructionSize(u32 line) const;
+	s8 GetStorageClass(u32 symbol) const;
+	bool IsFunction(u32 symbol) const;
+	u32 GetFunctionSize(u32 symbol) const;
+	u32 GetSymbolAddress(u32 symbol) const;
+	void GetSymbolName(u32 symbol, char* name, int nameSize) const;
+	void GetFilename(u32 file, char* name, int nameSize) const;
+	u32 GetNumFiles() const;
+
+	std::vector<SectionPlan> m_sections;
+	u32 m_filenamesSize;
+	u32 m_stringTableSize;
+	u32 m_endAddress;
+	u32 m_numRelocations;
+
+	//Table index of each symbol, counting aux records before it
+	std::vector<u32> m_symbolRecords;
+	u32 m_numSymbolRecords;
+
+	std::string m_error;
+};
@@ -0,0 +1,52 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+//Read only view of an array held elsewhere, e.g. a std::vector or an array in a mapped file.
+//Reads like a const std::vector, so tables can be decoded into memory or used in place.
+//The data must outlive the view, and a viewed vector must not be resized while viewed.
+template <typename T> class ArrayView
+{
+public:
+	ArrayView()
+	{
+		m_data = NULL;
+		m_size = 0;
+	}
+
+	ArrayView(const T* data, size_t size)
+	{
+		m_data = data;
+		m_size = size;
+	}
+
+	ArrayView(const std::vector<T>& vector)
+	{
+		m_data = vector.data();
+		m_size = vector.size();
+	}
+
+	const T& operator [] (size_t index) const { return m_data[index]; }
+	const T& front() const { return m_data[0]; }
+	const T& back() const { return m_data[m_size - 1]; }
+
+	const T* data() const { return m_data; }
+	size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+
+	const T* begin() const { return m_data; }
+	const T* end() const { return m_data + m_size; }
+
+private:
+	const T* m_data;
+	size_t m_size;
+};
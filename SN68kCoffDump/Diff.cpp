@@ -0,0 +1,465 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#include <algorithm>
+#include <cstring>
+
+#include "Diff.h"
+#include "RadixSort.h"
+#include "SizeMap.h"
+
+//ROM bytes compared per memcmp before looking for the differing bytes
+#define DIFF_BLOCK_SIZE	4096
+
+//Symbols worth comparing, ordered by name hash, then name, then address. Both builds use the same
+//order, which is all the merge-join needs, and hashes make most comparisons integer ones.
+static void SortSymbolsByName(const FileCOFF& coffFile, std::vector<u32>& nameOrder, std::vector<u32>& nameHashes)
+{
+	const ArrayView<FileCOFF::Symbol>& symbols = coffFile.GetSymbols();
+	const ArrayView<u32>& sortedIndices = coffFile.GetSortedSymbolIndices();
+
+	//Hash in table order, the order names sit in the pool
+	std::vector<u32> hashes(symbols.size());
+	for(u32 i = 0; i < symbols.size(); i++)
+	{
+		hashes[i] = FileCOFF::HashSymbolName(coffFile.GetSymbolName(symbols[i]));
+	}
+
+	//Hash and position in address order, so equal names sort by address
+	std::vector<u64> keys;
+	keys.reserve(sortedIndices.size());
+
+	for(u32 i = 0; i < sortedIndices.size(); i++)
+	{
+		const FileCOFF::Symbol& symbol = symbols[sortedIndices[i]];
+
+		if(symbol.storageClass != COFF_STORAGE_CLASS_FILE && !coffFile.IsSectionSymbol(symbol))
+		{
+			keys.push_back(((u64)hashes[sortedIndices[i]] << 32) | i);
+		}
+	}
+
+	//Positions start in order, only the hashes need sorting
+	RadixSortKeys(keys, 32);
+
+	nameOrder.resize(keys.size());
+	nameHashes.resize(keys.size());
+
+	for(u32 i = 0; i < keys.size(); i++)
+	{
+		nameOrder[i] = sortedIndices[(u32)keys[i]];
+		nameHashes[i] = (u32)(keys[i] >> 32);
+	}
+
+	//Different names sharing a hash are rare, order those runs by name
+	for(u32 runStart = 0; runStart < keys.size(); )
+	{
+		u32 runEnd = runStart + 1;
+		bool sameName = true;
+
+		for(; runEnd < keys.size() && nameHashes[runEnd] == nameHashes[runStart]; runEnd++)
+		{
+			if(sameName && strcmp(coffFile.GetSymbolName(symbols[nameOrder[runEnd]]), coffFile.GetSymbolName(symbols[nameOrder[runStart]])) != 0)
+				sameName = false;
+		}
+
+		if(!sameName)
+		{
+			std::stable_sort(nameOrder.begin() + runStart, nameOrder.begin() + runEnd, [&](u32 lhs, u32 rhs)
+			{
+				return strcmp(coffFile.GetSymbolName(symbols[lhs]), coffFile.GetSymbolName(symbols[rhs])) < 0;
+			});
+		}
+
+		runStart = runEnd;
+	}
+}
+
+//Size map span of each symbol, 0 for aliases and symbols outside the sections
+static void GetSymbolSizes(const FileCOFF& coffFile, std::vector<u32>& sizes)
+{
+	SizeMap sizeMap;
+	BuildSizeMap(coffFile, sizeMap);
+
+	sizes.assign(coffFile.GetSymbols().size(), 0);
+
+	for(u32 i = 0; i < sizeMap.symbols.size(); i++)
+	{
+		sizes[sizeMap.symbols[i].index] = sizeMap.symbols[i].size;
+	}
+}
+
+static void DiffSymbols(const FileCOFF& oldFile, const FileCOFF& newFile, COFFDiff& diff)
+{
+	const ArrayView<FileCOFF::Symbol>& oldSymbols = oldFile.GetSymbols();
+	const ArrayView<FileCOFF::Symbol>& newSymbols = newFile.GetSymbols();
+
+	std::vector<u32> oldOrder;
+	std::vector<u32> newOrder;
+	std::vector<u32> oldHashes;
+	std::vector<u32> newHashes;
+	SortSymbolsByName(oldFile, oldOrder, oldHashes);
+	SortSymbolsByName(newFile, newOrder, newHashes);
+
+	//Merge-join on name, the nth symbol of a name in one build pairs with the nth in the other
+	std::vector<u32> oldMatches(oldSymbols.size(), (u32)-1);
+	std::vector<u32> newMatches(newSymbols.size(), (u32)-1);
+	u32 oldPos = 0;
+	u32 newPos = 0;
+
+	while(oldPos < oldOrder.size() && newPos < newOrder.size())
+	{
+		int order = (oldHashes[oldPos] < newHashes[newPos]) ? -1 : ((oldHashes[oldPos] > newHashes[newPos]) ? 1 : 0);
+		if(order == 0)
+			order = strcmp(oldFile.GetSymbolName(oldSymbols[oldOrder[oldPos]]), newFile.GetSymbolName(newSymbols[newOrder[newPos]]));
+
+		if(order < 0)
+		{
+			oldPos++;
+		}
+		else if(order > 0)
+		{
+			newPos++;
+		}
+		else
+		{
+			oldMatches[oldOrder[oldPos]] = newOrder[newPos];
+			newMatches[newOrder[newPos]] = oldOrder[oldPos];
+			oldPos++;
+			newPos++;
+			diff.numMatched++;
+		}
+	}
+
+	std::vector<u32> oldSizes;
+	std::vector<u32> newSizes;
+	GetSymbolSizes(oldFile, oldSizes);
+	GetSymbolSizes(newFile, newSizes);
+
+	//Walk each build in address order, so every list comes out address ordered
+	const ArrayView<u32>& newSortedIndices = newFile.GetSortedSymbolIndices();
+	for(u32 i = 0; i < newSortedIndices.size(); i++)
+	{
+		u32 newIndex = newSortedIndices[i];
+		const FileCOFF::Symbol& symbol = newSymbols[newIndex];
+
+		if(symbol.storageClass == COFF_STORAGE_CLASS_FILE || newFile.IsSectionSymbol(symbol))
+			continue;
+
+		u32 oldIndex = newMatches[newIndex];
+		SymbolDiff symbolDiff = { oldIndex, newIndex, (oldIndex != (u32)-1) ? oldSizes[oldIndex] : 0, newSizes[newIndex] };
+
+		if(oldIndex == (u32)-1)
+		{
+			diff.added.push_back(symbolDiff);
+			continue;
+		}
+
+		if(oldSymbols[oldIndex].value != symbol.value)
+			diff.moved.push_back(symbolDiff);
+
+		if(symbolDiff.oldSize != symbolDiff.newSize)
+			diff.resized.push_back(symbolDiff);
+	}
+
+	const ArrayView<u32>& oldSortedIndices = oldFile.GetSortedSymbolIndices();
+	for(u32 i = 0; i < oldSortedIndices.size(); i++)
+	{
+		u32 oldIndex = oldSortedIndices[i];
+		const FileCOFF::Symbol& symbol = oldSymbols[oldIndex];
+
+		if(symbol.storageClass == COFF_STORAGE_CLASS_FILE || oldFile.IsSectionSymbol(symbol) || oldMatches[oldIndex] != (u32)-1)
+			continue;
+
+		SymbolDiff symbolDiff = { oldIndex, (u32)-1, oldSizes[oldIndex], 0 };
+		diff.removed.push_back(symbolDiff);
+	}
+}
+
+static void DiffROM(const FileCOFF& oldFile, const FileCOFF& newFile, COFFDiff& diff)
+{
+	const FileCOFF::SectionHeader& oldSection = oldFile.m_sectionHeaders[COFF_SECTION_ROM_DATA];
+	const FileCOFF::SectionHeader& newSection = newFile.m_sectionHeaders[COFF_SECTION_ROM_DATA];
+	const u8* oldData = oldSection.data;
+	const u8* newData = newSection.data;
+
+	diff.oldROMSize = oldData ? oldSection.size : 0;
+	diff.newROMSize = newData ? newSection.size : 0;
+
+	//Both sections are mapped, so comparing blocks in place is cheaper than hashing them
+	u32 commonSize = std::min(diff.oldROMSize, diff.newROMSize);
+	bool inRange = false;
+	u32 rangeStart = 0;
+
+	for(u32 blockStart = 0; blockStart < commonSize; blockStart += DIFF_BLOCK_SIZE)
+	{
+		u32 blockEnd = std::min(blockStart + DIFF_BLOCK_SIZE, commonSize);
+
+		if(memcmp(oldData + blockStart, newData + blockStart, blockEnd - blockStart) == 0)
+		{
+			if(inRange)
+			{
+				ROMRangeDiff range = { rangeStart, blockStart - rangeStart };
+				diff.ranges.push_back(range);
+				inRange = false;
+			}
+
+			continue;
+		}
+
+		for(u32 offset = blockStart; offset < blockEnd; offset++)
+		{
+			bool differs = (oldData[offset] != newData[offset]);
+
+			if(differs && !inRange)
+			{
+				rangeStart = offset;
+				inRange = true;
+			}
+			else if(!differs && inRange)
+			{
+				ROMRangeDiff range = { rangeStart, offset - rangeStart };
+				diff.ranges.push_back(range);
+				inRange = false;
+			}
+		}
+	}
+
+	if(inRange)
+	{
+		ROMRangeDiff range = { rangeStart, commonSize - rangeStart };
+		diff.ranges.push_back(range);
+	}
+
+	//Grown or shrunk tail
+	if(diff.oldROMSize != diff.newROMSize)
+	{
+		ROMRangeDiff range = { commonSize, std::max(diff.oldROMSize, diff.newROMSize) - commonSize };
+		diff.ranges.push_back(range);
+	}
+}
+
+void DiffCOFF(const FileCOFF& oldFile, const FileCOFF& newFile, COFFDiff& diff)
+{
+	diff = COFFDiff();
+	DiffSymbols(oldFile, newFile, diff);
+	DiffROM(oldFile, newFile, diff);
+}
+
+static void WriteDelta(s64 delta, OutputStream& stream)
+{
+	if(delta >= 0)
+		stream << "+";
+
+	stream << (long long)delta;
+}
+
+enum DiffTable
+{
+	DIFF_TABLE_ADDED,
+	DIFF_TABLE_REMOVED,
+	DIFF_TABLE_MOVED,
+	DIFF_TABLE_RESIZED
+};
+
+static void WriteSymbolDiffs(const FileCOFF& oldFile, const FileCOFF& newFile, const std::vector<SymbolDiff>& symbolDiffs, DiffTable table, OutputFormat format, OutputStream& stream)
+{
+	static const char* tableNames[] = { "added", "removed", "moved", "resized" };
+	static const char* textTitles[] = { "Added symbols\n", "Removed symbols\n", "Moved symbols\n", "Resized symbols\n" };
+	static const char* textHeaders[] = { "Address\tSize\tSymbol\n", "Address\tSize\tSymbol\n", "Old address\tNew address\tShift\tSymbol\n", "Old size\tNew size\tDelta\tSymbol\n" };
+
+	if(format == FORMAT_TEXT)
+	{
+		stream << textTitles[table] << textHeaders[table];
+	}
+
+	for(u32 i = 0; i < symbolDiffs.size(); i++)
+	{
+		const SymbolDiff& symbolDiff = symbolDiffs[i];
+		bool hasOld = (symbolDiff.oldIndex != (u32)-1);
+		bool hasNew = (symbolDiff.newIndex != (u32)-1);
+		u32 oldAddress = hasOld ? oldFile.GetSymbols()[symbolDiff.oldIndex].value : 0;
+		u32 newAddress = hasNew ? newFile.GetSymbols()[symbolDiff.newIndex].value : 0;
+		const char* name = hasNew ? newFile.GetSymbolName(newFile.GetSymbols()[symbolDiff.newIndex]) : oldFile.GetSymbolName(oldFile.GetSymbols()[symbolDiff.oldIndex]);
+
+		if(format == FORMAT_JSON)
+		{
+			stream << "{\"type\":\"diffSymbol\",\"change\":\"" << tableNames[table] << "\",\"name\":";
+			WriteJSONString(name, stream);
+
+			if(hasOld)
+				stream << ",\"oldAddress\":" << oldAddress << ",\"oldSize\":" << symbolDiff.oldSize;
+			if(hasNew)
+				stream << ",\"newAddress\":" << newAddress << ",\"newSize\":" << symbolDiff.newSize;
+
+			stream << "}\n";
+		}
+		else if(format == FORMAT_CSV)
+		{
+			stream << tableNames[table] << ",";
+			WriteCSVField(name, stream);
+			stream << ",";
+
+			if(hasOld)
+				stream << oldAddress << "," << symbolDiff.oldSize;
+			else
+				stream << ",";
+
+			stream << ",";
+
+			if(hasNew)
+				stream << newAddress << "," << symbolDiff.newSize;
+			else
+				stream << ",";
+
+			stream << "\n";
+		}
+		else if(table == DIFF_TABLE_ADDED || table == DIFF_TABLE_REMOVED)
+		{
+			stream << "0x" << Hex(hasNew ? newAddress : oldAddress) << "\t" << (hasNew ? symbolDiff.newSize : symbolDiff.oldSize) << "\t" << name << "\n";
+		}
+		else if(table == DIFF_TABLE_MOVED)
+		{
+			stream << "0x" << Hex(oldAddress) << "\t0x" << Hex(newAddress) << "\t";
+			WriteDelta((s64)newAddress - (s64)oldAddress, stream);
+			stream << "\t" << name << "\n";
+		}
+		else
+		{
+			stream << symbolDiff.oldSize << "\t" << symbolDiff.newSize << "\t";
+			WriteDelta((s64)symbolDiff.newSize - (s64)symbolDiff.oldSize, stream);
+			stream << "\t" << name << "\n";
+		}
+	}
+
+	if(format == FORMAT_TEXT)
+	{
+		stream << "\n";
+	}
+}
+
+static void WriteROMRangeDiffs(const FileCOFF& oldFile, const FileCOFF& newFile, const COFFDiff& diff, OutputFormat format, OutputStream& stream)
+{
+	u32 oldBaseAddress = oldFile.m_sectionHeaders[COFF_SECTION_ROM_DATA].physicalAddr;
+	u32 baseAddress = newFile.m_sectionHeaders[COFF_SECTION_ROM_DATA].physicalAddr;
+
+	if(format == FORMAT_TEXT)
+	{
+		stream << "Changed ROM ranges\n";
+		stream << "Start\tEnd\tSize\tSymbol\n";
+	}
+
+	for(u32 i = 0; i < diff.ranges.size(); i++)
+	{
+		const ROMRangeDiff& range = diff.ranges[i];
+		u32 address = baseAddress + range.offset;
+
+		//Owner in the new build, past its end for a shrunk ROM
+		const FileCOFF::Symbol* symbol = NULL;
+		if(range.offset < diff.newROMSize)
+		{
+			symbol = newFile.FindFunction(address);
+			if(!symbol)
+				symbol = newFile.FindNearestSymbol(address);
+		}
+
+		const char* name = symbol ? newFile.GetSymbolName(*symbol) : NULL;
+
+		if(format == FORMAT_JSON)
+		{
+			stream << "{\"type\":\"diffRange\",\"address\":" << address << ",\"offset\":" << range.offset << ",\"size\":" << range.size << ",\"symbol\":";
+
+			if(name)
+				WriteJSONString(name, stream);
+			else
+				stream << "null";
+
+			stream << "}\n";
+		}
+		else if(format == FORMAT_CSV)
+		{
+			//Old and new columns for whichever builds have these bytes
+			stream << "range,";
+
+			if(name)
+				WriteCSVField(name, stream);
+
+			stream << ",";
+
+			if(range.offset < diff.oldROMSize)
+				stream << (oldBaseAddress + range.offset) << "," << range.size;
+			else
+				stream << ",";
+
+			stream << ",";
+
+			if(range.offset < diff.newROMSize)
+				stream << address << "," << range.size;
+			else
+				stream << ",";
+
+			stream << "\n";
+		}
+		else
+		{
+			stream << "0x" << Hex(address) << "\t0x" << Hex(address + range.size) << "\t" << range.size << "\t" << (name ? name : "??") << "\n";
+		}
+	}
+
+	if(format == FORMAT_TEXT)
+	{
+		stream << "\n";
+	}
+}
+
+void WriteCOFFDiff(const FileCOFF& oldFile, const FileCOFF& newFile, const COFFDiff& diff, OutputFormat format, OutputStream& stream)
+{
+	u64 changedBytes = 0;
+	for(u32 i = 0; i < diff.ranges.size(); i++)
+	{
+		changedBytes += diff.ranges[i].size;
+	}
+
+	if(format == FORMAT_TEXT)
+	{
+		stream << "-------------------------------------\n";
+		stream << "DIFF\n";
+		stream << "-------------------------------------\n";
+		stream << "Old: " << oldFile.GetFilename() << "\n";
+		stream << "New: " << newFile.GetFilename() << "\n";
+		stream << "ROM size: " << diff.oldROMSize << " -> " << diff.newROMSize << " (";
+		WriteDelta((s64)diff.newROMSize - (s64)diff.oldROMSize, stream);
+		stream << " bytes)\n";
+		stream << "Symbols matched: " << diff.numMatched << "\n";
+		stream << "Symbols added: " << (u32)diff.added.size() << "\n";
+		stream << "Symbols removed: " << (u32)diff.removed.size() << "\n";
+		stream << "Symbols moved: " << (u32)diff.moved.size() << "\n";
+		stream << "Symbols resized: " << (u32)diff.resized.size() << "\n";
+		stream << "Changed ROM ranges: " << (u32)diff.ranges.size() << " (" << changedBytes << " bytes)\n\n";
+	}
+	else if(format == FORMAT_JSON)
+	{
+		stream << "{\"type\":\"diff\",\"old\":";
+		WriteJSONString(oldFile.GetFilename().c_str(), stream);
+		stream << ",\"new\":";
+		WriteJSONString(newFile.GetFilename().c_str(), stream);
+		stream << ",\"oldROMSize\":" << diff.oldROMSize << ",\"newROMSize\":" << diff.newROMSize << ",\"matched\":" << diff.numMatched;
+		stream << ",\"added\":" << (u32)diff.added.size() << ",\"removed\":" << (u32)diff.removed.size() << ",\"moved\":" << (u32)diff.moved.size();
+		stream << ",\"resized\":" << (u32)diff.resized.size() << ",\"ranges\":" << (u32)diff.ranges.size() << ",\"changedBytes\":" << changedBytes << "}\n";
+	}
+	else if(format == FORMAT_CSV)
+	{
+		stream << "table,name,oldAddress,oldSize,newAddress,newSize\n";
+	}
+
+	WriteSymbolDiffs(oldFile, newFile, diff.added, DIFF_TABLE_ADDED, format, stream);
+	WriteSymbolDiffs(oldFile, newFile, diff.removed, DIFF_TABLE_REMOVED, format, stream);
+	WriteSymbolDiffs(oldFile, newFile, diff.moved, DIFF_TABLE_MOVED, format, stream);
+	WriteSymbolDiffs(oldFile, newFile, diff.resized, DIFF_TABLE_RESIZED, format, stream);
+	WriteROMRangeDiffs(oldFile, newFile, diff, format, stream);
+}
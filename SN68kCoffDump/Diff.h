@@ -0,0 +1,64 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#pragma once
+
+#include <vector>
+
+#include "FileCOFF.h"
+#include "OutputStream.h"
+#include "TableWriter.h"
+
+//A symbol in either build, indices are -1 where it's missing from that build.
+//Sizes are size map spans, see SizeMap.h.
+struct SymbolDiff
+{
+	u32 oldIndex;
+	u32 newIndex;
+	u32 oldSize;
+	u32 newSize;
+};
+
+//Changed bytes, as offsets into the ROM sections
+struct ROMRangeDiff
+{
+	u32 offset;
+	u32 size;
+};
+
+struct COFFDiff
+{
+	COFFDiff()
+	{
+		numMatched = 0;
+		oldROMSize = 0;
+		newROMSize = 0;
+	}
+
+	//Added and removed in address order, moved and resized in new build address order.
+	//A symbol that moved and changed size is in both.
+	std::vector<SymbolDiff> added;
+	std::vector<SymbolDiff> removed;
+	std::vector<SymbolDiff> moved;
+	std::vector<SymbolDiff> resized;
+	u32 numMatched;
+
+	//Contiguous runs of differing bytes, then the tail of the longer ROM
+	std::vector<ROMRangeDiff> ranges;
+	u32 oldROMSize;
+	u32 newROMSize;
+};
+
+//Symbols are matched by name, by merge-joining both tables sorted by name hash and name. Names used more than once
+//(local labels) pair up in address order. Section and .file symbols aren't compared. The ROM sections are
+//compared a block at a time, and only differing blocks are scanned byte by byte.
+//Requires the symbol and line tables of both files.
+void DiffCOFF(const FileCOFF& oldFile, const FileCOFF& newFile, COFFDiff& diff);
+
+//Binary format is not supported
+void WriteCOFFDiff(const FileCOFF& oldFile, const FileCOFF& newFile, const COFFDiff& diff, OutputFormat format, OutputStream& stream);
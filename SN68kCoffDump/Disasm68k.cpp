@@ -0,0 +1,890 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#include <mutex>
+
+#include "Disasm68k.h"
+#include "archive.h"
+
+//Effective address modes an instruction accepts, one bit per mode, mode 7 by register
+#define EA_DN			0x0001
+#define EA_AN			0x0002
+#define EA_IND			0x0004
+#define EA_POSTINC		0x0008
+#define EA_PREDEC		0x0010
+#define EA_DISP			0x0020
+#define EA_INDEX		0x0040
+#define EA_ABS_WORD		0x0080
+#define EA_ABS_LONG		0x0100
+#define EA_PC_DISP		0x0200
+#define EA_PC_INDEX		0x0400
+#define EA_IMMEDIATE	0x0800
+
+#define EA_ALL				0x0FFF
+#define EA_DATA				(EA_ALL & ~EA_AN)
+#define EA_MEMORY			(EA_ALL & ~(EA_DN | EA_AN))
+#define EA_CONTROL			(EA_IND | EA_DISP | EA_INDEX | EA_ABS_WORD | EA_ABS_LONG | EA_PC_DISP | EA_PC_INDEX)
+#define EA_ALTERABLE		(EA_DN | EA_AN | EA_IND | EA_POSTINC | EA_PREDEC | EA_DISP | EA_INDEX | EA_ABS_WORD | EA_ABS_LONG)
+#define EA_DATA_ALTERABLE	(EA_ALTERABLE & ~EA_AN)
+#define EA_MEMORY_ALTERABLE	(EA_ALTERABLE & ~(EA_DN | EA_AN))
+#define EA_CONTROL_ALTERABLE	(EA_CONTROL & EA_ALTERABLE)
+
+//Mnemonic suffix from opcode bits 8-11
+#define PATTERN_CONDITION			0x01	//Scc and DBcc, t/f/hi...
+#define PATTERN_BRANCH_CONDITION	0x02	//Bcc, ra/sr/hi...
+
+enum OperandSize
+{
+	SIZE_NONE,
+	SIZE_BYTE,
+	SIZE_WORD,
+	SIZE_LONG
+};
+
+//Operand layouts, Dx/Ax are opcode bits 9-11, Dy/Ay and <ea> bits 0-5
+enum OperandFormat
+{
+	FORMAT_NONE,
+	FORMAT_EA,					//<ea>
+	FORMAT_IMM_EA,				//#imm,<ea>
+	FORMAT_BIT_IMM_EA,			//#bit,<ea>
+	FORMAT_IMM_CCR,				//#imm,ccr
+	FORMAT_IMM_SR,				//#imm,sr
+	FORMAT_DX_EA,				//Dx,<ea>
+	FORMAT_EA_DX,				//<ea>,Dx
+	FORMAT_EA_AX,				//<ea>,Ax
+	FORMAT_SR_EA,				//sr,<ea>
+	FORMAT_EA_CCR,				//<ea>,ccr
+	FORMAT_EA_SR,				//<ea>,sr
+	FORMAT_MOVE,				//<ea>,<ea> with the destination in bits 6-11
+	FORMAT_MOVEP_TO_REG,		//d16(Ay),Dx
+	FORMAT_MOVEP_TO_MEM,		//Dx,d16(Ay)
+	FORMAT_DY,					//Dy
+	FORMAT_AY,					//Ay
+	FORMAT_TRAP,				//#vector
+	FORMAT_LINK,				//Ay,#disp
+	FORMAT_AY_USP,				//Ay,usp
+	FORMAT_USP_AY,				//usp,Ay
+	FORMAT_STOP,				//#imm
+	FORMAT_MOVEM_TO_MEM,		//list,<ea>
+	FORMAT_MOVEM_TO_REG,		//<ea>,list
+	FORMAT_QUICK_EA,			//#1-8,<ea>
+	FORMAT_DBCC,				//Dy,label
+	FORMAT_BRANCH,				//label
+	FORMAT_MOVEQ,				//#imm8,Dx
+	FORMAT_DY_DX,				//Dy,Dx
+	FORMAT_PREDEC_PREDEC,		//-(Ay),-(Ax)
+	FORMAT_POSTINC_POSTINC,		//(Ay)+,(Ax)+
+	FORMAT_EXG_DD,				//Dx,Dy
+	FORMAT_EXG_AA,				//Ax,Ay
+	FORMAT_EXG_DA,				//Dx,Ay
+	FORMAT_SHIFT_REG,			//#1-8,Dy or Dx,Dy, mnemonic from bits 3-4 and 8
+	FORMAT_SHIFT_MEM			//<ea>, mnemonic from bits 8-10
+};
+
+//An opcode matches if (opcode & mask) == match and its <ea> fields are in the accepted modes.
+//First match wins, so more specific patterns come first.
+struct OpcodePattern
+{
+	u16 mask;
+	u16 match;
+	const char* mnemonic;
+	u8 size;
+	u8 format;
+	u8 flags;
+	u16 sourceModes;
+	u16 destModes;
+};
+
+static const OpcodePattern s_patterns[] =
+{
+	//Bit manipulation, MOVEP, immediate
+	{ 0xFFFF, 0x003C, "ori", SIZE_BYTE, FORMAT_IMM_CCR, 0, 0, 0 },
+	{ 0xFFFF, 0x007C, "ori", SIZE_WORD, FORMAT_IMM_SR, 0, 0, 0 },
+	{ 0xFFFF, 0x023C, "andi", SIZE_BYTE, FORMAT_IMM_CCR, 0, 0, 0 },
+	{ 0xFFFF, 0x027C, "andi", SIZE_WORD, FORMAT_IMM_SR, 0, 0, 0 },
+	{ 0xFFFF, 0x0A3C, "eori", SIZE_BYTE, FORMAT_IMM_CCR, 0, 0, 0 },
+	{ 0xFFFF, 0x0A7C, "eori", SIZE_WORD, FORMAT_IMM_SR, 0, 0, 0 },
+	{ 0xF1F8, 0x0108, "movep", SIZE_WORD, FORMAT_MOVEP_TO_REG, 0, 0, 0 },
+	{ 0xF1F8, 0x0148, "movep", SIZE_LONG, FORMAT_MOVEP_TO_REG, 0, 0, 0 },
+	{ 0xF1F8, 0x0188, "movep", SIZE_WORD, FORMAT_MOVEP_TO_MEM, 0, 0, 0 },
+	{ 0xF1F8, 0x01C8, "movep", SIZE_LONG, FORMAT_MOVEP_TO_MEM, 0, 0, 0 },
+	{ 0xF1C0, 0x0100, "btst", SIZE_NONE, FORMAT_DX_EA, 0, EA_DATA, 0 },
+	{ 0xF1C0, 0x0140, "bchg", SIZE_NONE, FORMAT_DX_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xF1C0, 0x0180, "bclr", SIZE_NONE, FORMAT_DX_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xF1C0, 0x01C0, "bset", SIZE_NONE, FORMAT_DX_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x0800, "btst", SIZE_NONE, FORMAT_BIT_IMM_EA, 0, EA_DATA & ~EA_IMMEDIATE, 0 },
+	{ 0xFFC0, 0x0840, "bchg", SIZE_NONE, FORMAT_BIT_IMM_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x0880, "bclr", SIZE_NONE, FORMAT_BIT_IMM_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x08C0, "bset", SIZE_NONE, FORMAT_BIT_IMM_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x0000, "ori", SIZE_BYTE, FORMAT_IMM_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x0040, "ori", SIZE_WORD, FORMAT_IMM_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x0080, "ori", SIZE_LONG, FORMAT_IMM_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x0200, "andi", SIZE_BYTE, FORMAT_IMM_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x0240, "andi", SIZE_WORD, FORMAT_IMM_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x0280, "andi", SIZE_LONG, FORMAT_IMM_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x0400, "subi", SIZE_BYTE, FORMAT_IMM_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x0440, "subi", SIZE_WORD, FORMAT_IMM_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x0480, "subi", SIZE_LONG, FORMAT_IMM_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x0600, "addi", SIZE_BYTE, FORMAT_IMM_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x0640, "addi", SIZE_WORD, FORMAT_IMM_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x0680, "addi", SIZE_LONG, FORMAT_IMM_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x0A00, "eori", SIZE_BYTE, FORMAT_IMM_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x0A40, "eori", SIZE_WORD, FORMAT_IMM_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x0A80, "eori", SIZE_LONG, FORMAT_IMM_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x0C00, "cmpi", SIZE_BYTE, FORMAT_IMM_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x0C40, "cmpi", SIZE_WORD, FORMAT_IMM_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x0C80, "cmpi", SIZE_LONG, FORMAT_IMM_EA, 0, EA_DATA_ALTERABLE, 0 },
+
+	//Moves, byte moves can't read An
+	{ 0xF1C0, 0x2040, "movea", SIZE_LONG, FORMAT_EA_AX, 0, EA_ALL, 0 },
+	{ 0xF1C0, 0x3040, "movea", SIZE_WORD, FORMAT_EA_AX, 0, EA_ALL, 0 },
+	{ 0xF000, 0x1000, "move", SIZE_BYTE, FORMAT_MOVE, 0, EA_ALL & ~EA_AN, EA_DATA_ALTERABLE },
+	{ 0xF000, 0x2000, "move", SIZE_LONG, FORMAT_MOVE, 0, EA_ALL, EA_DATA_ALTERABLE },
+	{ 0xF000, 0x3000, "move", SIZE_WORD, FORMAT_MOVE, 0, EA_ALL, EA_DATA_ALTERABLE },
+
+	//Miscellaneous
+	{ 0xFFC0, 0x40C0, "move", SIZE_WORD, FORMAT_SR_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x44C0, "move", SIZE_WORD, FORMAT_EA_CCR, 0, EA_DATA, 0 },
+	{ 0xFFC0, 0x46C0, "move", SIZE_WORD, FORMAT_EA_SR, 0, EA_DATA, 0 },
+	{ 0xFFC0, 0x4000, "negx", SIZE_BYTE, FORMAT_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x4040, "negx", SIZE_WORD, FORMAT_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x4080, "negx", SIZE_LONG, FORMAT_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x4200, "clr", SIZE_BYTE, FORMAT_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x4240, "clr", SIZE_WORD, FORMAT_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x4280, "clr", SIZE_LONG, FORMAT_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x4400, "neg", SIZE_BYTE, FORMAT_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x4440, "neg", SIZE_WORD, FORMAT_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x4480, "neg", SIZE_LONG, FORMAT_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x4600, "not", SIZE_BYTE, FORMAT_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x4640, "not", SIZE_WORD, FORMAT_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x4680, "not", SIZE_LONG, FORMAT_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xF1C0, 0x4180, "chk", SIZE_WORD, FORMAT_EA_DX, 0, EA_DATA, 0 },
+	{ 0xF1C0, 0x41C0, "lea", SIZE_NONE, FORMAT_EA_AX, 0, EA_CONTROL, 0 },
+	{ 0xFFF8, 0x4840, "swap", SIZE_NONE, FORMAT_DY, 0, 0, 0 },
+	{ 0xFFF8, 0x4880, "ext", SIZE_WORD, FORMAT_DY, 0, 0, 0 },
+	{ 0xFFF8, 0x48C0, "ext", SIZE_LONG, FORMAT_DY, 0, 0, 0 },
+	{ 0xFFC0, 0x4800, "nbcd", SIZE_NONE, FORMAT_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x4840, "pea", SIZE_NONE, FORMAT_EA, 0, EA_CONTROL, 0 },
+	{ 0xFFC0, 0x4880, "movem", SIZE_WORD, FORMAT_MOVEM_TO_MEM, 0, EA_CONTROL_ALTERABLE | EA_PREDEC, 0 },
+	{ 0xFFC0, 0x48C0, "movem", SIZE_LONG, FORMAT_MOVEM_TO_MEM, 0, EA_CONTROL_ALTERABLE | EA_PREDEC, 0 },
+	{ 0xFFC0, 0x4C80, "movem", SIZE_WORD, FORMAT_MOVEM_TO_REG, 0, EA_CONTROL | EA_POSTINC, 0 },
+	{ 0xFFC0, 0x4CC0, "movem", SIZE_LONG, FORMAT_MOVEM_TO_REG, 0, EA_CONTROL | EA_POSTINC, 0 },
+	{ 0xFFFF, 0x4AFC, "illegal", SIZE_NONE, FORMAT_NONE, 0, 0, 0 },
+	{ 0xFFC0, 0x4AC0, "tas", SIZE_NONE, FORMAT_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x4A00, "tst", SIZE_BYTE, FORMAT_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x4A40, "tst", SIZE_WORD, FORMAT_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFC0, 0x4A80, "tst", SIZE_LONG, FORMAT_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xFFF0, 0x4E40, "trap", SIZE_NONE, FORMAT_TRAP, 0, 0, 0 },
+	{ 0xFFF8, 0x4E50, "link", SIZE_NONE, FORMAT_LINK, 0, 0, 0 },
+	{ 0xFFF8, 0x4E58, "unlk", SIZE_NONE, FORMAT_AY, 0, 0, 0 },
+	{ 0xFFF8, 0x4E60, "move", SIZE_LONG, FORMAT_AY_USP, 0, 0, 0 },
+	{ 0xFFF8, 0x4E68, "move", SIZE_LONG, FORMAT_USP_AY, 0, 0, 0 },
+	{ 0xFFFF, 0x4E70, "reset", SIZE_NONE, FORMAT_NONE, 0, 0, 0 },
+	{ 0xFFFF, 0x4E71, "nop", SIZE_NONE, FORMAT_NONE, 0, 0, 0 },
+	{ 0xFFFF, 0x4E72, "stop", SIZE_NONE, FORMAT_STOP, 0, 0, 0 },
+	{ 0xFFFF, 0x4E73, "rte", SIZE_NONE, FORMAT_NONE, 0, 0, 0 },
+	{ 0xFFFF, 0x4E75, "rts", SIZE_NONE, FORMAT_NONE, 0, 0, 0 },
+	{ 0xFFFF, 0x4E76, "trapv", SIZE_NONE, FORMAT_NONE, 0, 0, 0 },
+	{ 0xFFFF, 0x4E77, "rtr", SIZE_NONE, FORMAT_NONE, 0, 0, 0 },
+	{ 0xFFC0, 0x4E80, "jsr", SIZE_NONE, FORMAT_EA, 0, EA_CONTROL, 0 },
+	{ 0xFFC0, 0x4EC0, "jmp", SIZE_NONE, FORMAT_EA, 0, EA_CONTROL, 0 },
+
+	//ADDQ, SUBQ, Scc, DBcc, byte ops can't write An
+	{ 0xF0F8, 0x50C8, "db", SIZE_NONE, FORMAT_DBCC, PATTERN_CONDITION, 0, 0 },
+	{ 0xF0C0, 0x50C0, "s", SIZE_NONE, FORMAT_EA, PATTERN_CONDITION, EA_DATA_ALTERABLE, 0 },
+	{ 0xF1C0, 0x5000, "addq", SIZE_BYTE, FORMAT_QUICK_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xF1C0, 0x5040, "addq", SIZE_WORD, FORMAT_QUICK_EA, 0, EA_ALTERABLE, 0 },
+	{ 0xF1C0, 0x5080, "addq", SIZE_LONG, FORMAT_QUICK_EA, 0, EA_ALTERABLE, 0 },
+	{ 0xF1C0, 0x5100, "subq", SIZE_BYTE, FORMAT_QUICK_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xF1C0, 0x5140, "subq", SIZE_WORD, FORMAT_QUICK_EA, 0, EA_ALTERABLE, 0 },
+	{ 0xF1C0, 0x5180, "subq", SIZE_LONG, FORMAT_QUICK_EA, 0, EA_ALTERABLE, 0 },
+
+	//Branches, MOVEQ
+	{ 0xF000, 0x6000, "b", SIZE_NONE, FORMAT_BRANCH, PATTERN_BRANCH_CONDITION, 0, 0 },
+	{ 0xF100, 0x7000, "moveq", SIZE_NONE, FORMAT_MOVEQ, 0, 0, 0 },
+
+	//OR, DIV, SBCD
+	{ 0xF1C0, 0x80C0, "divu", SIZE_WORD, FORMAT_EA_DX, 0, EA_DATA, 0 },
+	{ 0xF1C0, 0x81C0, "divs", SIZE_WORD, FORMAT_EA_DX, 0, EA_DATA, 0 },
+	{ 0xF1F8, 0x8100, "sbcd", SIZE_NONE, FORMAT_DY_DX, 0, 0, 0 },
+	{ 0xF1F8, 0x8108, "sbcd", SIZE_NONE, FORMAT_PREDEC_PREDEC, 0, 0, 0 },
+	{ 0xF1C0, 0x8000, "or", SIZE_BYTE, FORMAT_EA_DX, 0, EA_DATA, 0 },
+	{ 0xF1C0, 0x8040, "or", SIZE_WORD, FORMAT_EA_DX, 0, EA_DATA, 0 },
+	{ 0xF1C0, 0x8080, "or", SIZE_LONG, FORMAT_EA_DX, 0, EA_DATA, 0 },
+	{ 0xF1C0, 0x8100, "or", SIZE_BYTE, FORMAT_DX_EA, 0, EA_MEMORY_ALTERABLE, 0 },
+	{ 0xF1C0, 0x8140, "or", SIZE_WORD, FORMAT_DX_EA, 0, EA_MEMORY_ALTERABLE, 0 },
+	{ 0xF1C0, 0x8180, "or", SIZE_LONG, FORMAT_DX_EA, 0, EA_MEMORY_ALTERABLE, 0 },
+
+	//SUB, SUBA, SUBX
+	{ 0xF1C0, 0x90C0, "suba", SIZE_WORD, FORMAT_EA_AX, 0, EA_ALL, 0 },
+	{ 0xF1C0, 0x91C0, "suba", SIZE_LONG, FORMAT_EA_AX, 0, EA_ALL, 0 },
+	{ 0xF1F8, 0x9100, "subx", SIZE_BYTE, FORMAT_DY_DX, 0, 0, 0 },
+	{ 0xF1F8, 0x9108, "subx", SIZE_BYTE, FORMAT_PREDEC_PREDEC, 0, 0, 0 },
+	{ 0xF1F8, 0x9140, "subx", SIZE_WORD, FORMAT_DY_DX, 0, 0, 0 },
+	{ 0xF1F8, 0x9148, "subx", SIZE_WORD, FORMAT_PREDEC_PREDEC, 0, 0, 0 },
+	{ 0xF1F8, 0x9180, "subx", SIZE_LONG, FORMAT_DY_DX, 0, 0, 0 },
+	{ 0xF1F8, 0x9188, "subx", SIZE_LONG, FORMAT_PREDEC_PREDEC, 0, 0, 0 },
+	{ 0xF1C0, 0x9000, "sub", SIZE_BYTE, FORMAT_EA_DX, 0, EA_ALL & ~EA_AN, 0 },
+	{ 0xF1C0, 0x9040, "sub", SIZE_WORD, FORMAT_EA_DX, 0, EA_ALL, 0 },
+	{ 0xF1C0, 0x9080, "sub", SIZE_LONG, FORMAT_EA_DX, 0, EA_ALL, 0 },
+	{ 0xF1C0, 0x9100, "sub", SIZE_BYTE, FORMAT_DX_EA, 0, EA_MEMORY_ALTERABLE, 0 },
+	{ 0xF1C0, 0x9140, "sub", SIZE_WORD, FORMAT_DX_EA, 0, EA_MEMORY_ALTERABLE, 0 },
+	{ 0xF1C0, 0x9180, "sub", SIZE_LONG, FORMAT_DX_EA, 0, EA_MEMORY_ALTERABLE, 0 },
+
+	//CMP, CMPA, CMPM, EOR
+	{ 0xF1C0, 0xB0C0, "cmpa", SIZE_WORD, FORMAT_EA_AX, 0, EA_ALL, 0 },
+	{ 0xF1C0, 0xB1C0, "cmpa", SIZE_LONG, FORMAT_EA_AX, 0, EA_ALL, 0 },
+	{ 0xF1F8, 0xB108, "cmpm", SIZE_BYTE, FORMAT_POSTINC_POSTINC, 0, 0, 0 },
+	{ 0xF1F8, 0xB148, "cmpm", SIZE_WORD, FORMAT_POSTINC_POSTINC, 0, 0, 0 },
+	{ 0xF1F8, 0xB188, "cmpm", SIZE_LONG, FORMAT_POSTINC_POSTINC, 0, 0, 0 },
+	{ 0xF1C0, 0xB000, "cmp", SIZE_BYTE, FORMAT_EA_DX, 0, EA_ALL & ~EA_AN, 0 },
+	{ 0xF1C0, 0xB040, "cmp", SIZE_WORD, FORMAT_EA_DX, 0, EA_ALL, 0 },
+	{ 0xF1C0, 0xB080, "cmp", SIZE_LONG, FORMAT_EA_DX, 0, EA_ALL, 0 },
+	{ 0xF1C0, 0xB100, "eor", SIZE_BYTE, FORMAT_DX_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xF1C0, 0xB140, "eor", SIZE_WORD, FORMAT_DX_EA, 0, EA_DATA_ALTERABLE, 0 },
+	{ 0xF1C0, 0xB180, "eor", SIZE_LONG, FORMAT_DX_EA, 0, EA_DATA_ALTERABLE, 0 },
+
+	//AND, MUL, ABCD, EXG
+	{ 0xF1C0, 0xC0C0, "mulu", SIZE_WORD, FORMAT_EA_DX, 0, EA_DATA, 0 },
+	{ 0xF1C0, 0xC1C0, "muls", SIZE_WORD, FORMAT_EA_DX, 0, EA_DATA, 0 },
+	{ 0xF1F8, 0xC100, "abcd", SIZE_NONE, FORMAT_DY_DX, 0, 0, 0 },
+	{ 0xF1F8, 0xC108, "abcd", SIZE_NONE, FORMAT_PREDEC_PREDEC, 0, 0, 0 },
+	{ 0xF1F8, 0xC140, "exg", SIZE_NONE, FORMAT_EXG_DD, 0, 0, 0 },
+	{ 0xF1F8, 0xC148, "exg", SIZE_NONE, FORMAT_EXG_AA, 0, 0, 0 },
+	{ 0xF1F8, 0xC188, "exg", SIZE_NONE, FORMAT_EXG_DA, 0, 0, 0 },
+	{ 0xF1C0, 0xC000, "and", SIZE_BYTE, FORMAT_EA_DX, 0, EA_DATA, 0 },
+	{ 0xF1C0, 0xC040, "and", SIZE_WORD, FORMAT_EA_DX, 0, EA_DATA, 0 },
+	{ 0xF1C0, 0xC080, "and", SIZE_LONG, FORMAT_EA_DX, 0, EA_DATA, 0 },
+	{ 0xF1C0, 0xC100, "and", SIZE_BYTE, FORMAT_DX_EA, 0, EA_MEMORY_ALTERABLE, 0 },
+	{ 0xF1C0, 0xC140, "and", SIZE_WORD, FORMAT_DX_EA, 0, EA_MEMORY_ALTERABLE, 0 },
+	{ 0xF1C0, 0xC180, "and", SIZE_LONG, FORMAT_DX_EA, 0, EA_MEMORY_ALTERABLE, 0 },
+
+	//ADD, ADDA, ADDX
+	{ 0xF1C0, 0xD0C0, "adda", SIZE_WORD, FORMAT_EA_AX, 0, EA_ALL, 0 },
+	{ 0xF1C0, 0xD1C0, "adda", SIZE_LONG, FORMAT_EA_AX, 0, EA_ALL, 0 },
+	{ 0xF1F8, 0xD100, "addx", SIZE_BYTE, FORMAT_DY_DX, 0, 0, 0 },
+	{ 0xF1F8, 0xD108, "addx", SIZE_BYTE, FORMAT_PREDEC_PREDEC, 0, 0, 0 },
+	{ 0xF1F8, 0xD140, "addx", SIZE_WORD, FORMAT_DY_DX, 0, 0, 0 },
+	{ 0xF1F8, 0xD148, "addx", SIZE_WORD, FORMAT_PREDEC_PREDEC, 0, 0, 0 },
+	{ 0xF1F8, 0xD180, "addx", SIZE_LONG, FORMAT_DY_DX, 0, 0, 0 },
+	{ 0xF1F8, 0xD188, "addx", SIZE_LONG, FORMAT_PREDEC_PREDEC, 0, 0, 0 },
+	{ 0xF1C0, 0xD000, "add", SIZE_BYTE, FORMAT_EA_DX, 0, EA_ALL & ~EA_AN, 0 },
+	{ 0xF1C0, 0xD040, "add", SIZE_WORD, FORMAT_EA_DX, 0, EA_ALL, 0 },
+	{ 0xF1C0, 0xD080, "add", SIZE_LONG, FORMAT_EA_DX, 0, EA_ALL, 0 },
+	{ 0xF1C0, 0xD100, "add", SIZE_BYTE, FORMAT_DX_EA, 0, EA_MEMORY_ALTERABLE, 0 },
+	{ 0xF1C0, 0xD140, "add", SIZE_WORD, FORMAT_DX_EA, 0, EA_MEMORY_ALTERABLE, 0 },
+	{ 0xF1C0, 0xD180, "add", SIZE_LONG, FORMAT_DX_EA, 0, EA_MEMORY_ALTERABLE, 0 },
+
+	//Shifts and rotates, memory forms are word only
+	{ 0xF8C0, 0xE0C0, "", SIZE_WORD, FORMAT_SHIFT_MEM, 0, EA_MEMORY_ALTERABLE, 0 },
+	{ 0xF0C0, 0xE000, "", SIZE_BYTE, FORMAT_SHIFT_REG, 0, 0, 0 },
+	{ 0xF0C0, 0xE040, "", SIZE_WORD, FORMAT_SHIFT_REG, 0, 0, 0 },
+	{ 0xF0C0, 0xE080, "", SIZE_LONG, FORMAT_SHIFT_REG, 0, 0, 0 },
+};
+
+static const u32 s_numPatterns = sizeof(s_patterns) / sizeof(s_patterns[0]);
+
+static const char* s_conditionNames[] = { "t", "f", "hi", "ls", "cc", "cs", "ne", "eq", "vc", "vs", "pl", "mi", "ge", "lt", "gt", "le" };
+static const char* s_branchConditionNames[] = { "ra", "sr", "hi", "ls", "cc", "cs", "ne", "eq", "vc", "vs", "pl", "mi", "ge", "lt", "gt", "le" };
+static const char* s_shiftNames[] = { "as", "ls", "rox", "ro" };
+static const char* s_sizeSuffixes[] = { "", ".b", ".w", ".l" };
+
+//Pattern index + 1 of every opcode word, 0 if none matches
+static u8 s_opcodeTable[0x10000];
+static std::once_flag s_opcodeTableBuilt;
+
+//Bit of an <ea> mode/register pair in the EA_ masks, 0 for mode 7 registers 5-7
+static u16 GetEAModeBit(u32 mode, u32 reg)
+{
+	if(mode < 7)
+		return (u16)(1 << mode);
+	if(reg < 5)
+		return (u16)(1 << (7 + reg));
+
+	return 0;
+}
+
+static bool MatchesPattern(const OpcodePattern& pattern, u32 opcode)
+{
+	if((opcode & pattern.mask) != pattern.match)
+		return false;
+
+	if(pattern.sourceModes && !(GetEAModeBit((opcode >> 3) & 7, opcode & 7) & pattern.sourceModes))
+		return false;
+
+	//MOVE destination has register and mode swapped
+	if(pattern.destModes && !(GetEAModeBit((opcode >> 6) & 7, (opcode >> 9) & 7) & pattern.destModes))
+		return false;
+
+	return true;
+}
+
+static void BuildOpcodeTable()
+{
+	for(u32 opcode = 0; opcode < 0x10000; opcode++)
+	{
+		s_opcodeTable[opcode] = 0;
+
+		for(u32 i = 0; i < s_numPatterns; i++)
+		{
+			if(MatchesPattern(s_patterns[i], opcode))
+			{
+				s_opcodeTable[opcode] = (u8)(i + 1);
+				break;
+			}
+		}
+	}
+}
+
+//Instruction bytes and text being built
+struct DecodeContext
+{
+	const u8* data;
+	u32 size;
+	u32 offset;
+	bool ok;
+	Instruction68k* instruction;
+	u32 textLength;
+};
+
+static u16 ReadExtension(DecodeContext& context)
+{
+	if(context.offset + 2 > context.size)
+	{
+		context.ok = false;
+		return 0;
+	}
+
+	u16 word = ReadU16BE(context.data + context.offset);
+	context.offset += 2;
+	return word;
+}
+
+static void Append(DecodeContext& context, const char* string)
+{
+	char* text = context.instruction->text;
+
+	while(*string && context.textLength < DISASM_MAX_TEXT_SIZE - 1)
+	{
+		text[context.textLength++] = *string++;
+	}
+
+	text[context.textLength] = 0;
+}
+
+static void AppendChar(DecodeContext& context, char character)
+{
+	char string[2] = { character, 0 };
+	Append(context, string);
+}
+
+static void AppendHex(DecodeContext& context, u32 value)
+{
+	static const char digits[] = "0123456789abcdef";
+	char string[10];
+	int length = 0;
+
+	do
+	{
+		string[length++] = digits[value & 0xF];
+		value >>= 4;
+	}
+	while(value);
+
+	AppendChar(context, '$');
+
+	while(length > 0)
+	{
+		AppendChar(context, string[--length]);
+	}
+}
+
+static void AppendSignedHex(DecodeContext& context, s32 value)
+{
+	if(value < 0)
+	{
+		AppendChar(context, '-');
+		AppendHex(context, 0 - (u32)value);
+	}
+	else
+	{
+		AppendHex(context, (u32)value);
+	}
+}
+
+static void AppendRegister(DecodeContext& context, char type, u32 reg)
+{
+	AppendChar(context, type);
+	AppendChar(context, (char)('0' + reg));
+}
+
+static void SetTarget(DecodeContext& context, u32 target)
+{
+	//First address operand wins
+	if(!context.instruction->hasTarget)
+	{
+		context.instruction->hasTarget = true;
+		context.instruction->target = target;
+	}
+}
+
+//(d8,An,Xn.s) style brief extension word, index register and displacement
+static void AppendIndex(DecodeContext& context, u16 extension)
+{
+	AppendChar(context, ',');
+	AppendRegister(context, (extension & 0x8000) ? 'a' : 'd', (extension >> 12) & 7);
+	Append(context, (extension & 0x0800) ? ".l)" : ".w)");
+}
+
+static void AppendImmediate(DecodeContext& context, u32 size)
+{
+	u32 value = ReadExtension(context);
+
+	if(size == SIZE_LONG)
+		value = (value << 16) | ReadExtension(context);
+	else if(size != SIZE_WORD)
+		value &= 0xFF;
+
+	AppendChar(context, '#');
+	AppendHex(context, value);
+}
+
+static void AppendEA(DecodeContext& context, u32 mode, u32 reg, u32 size)
+{
+	switch(mode)
+	{
+	case 0:
+		AppendRegister(context, 'd', reg);
+		break;
+	case 1:
+		AppendRegister(context, 'a', reg);
+		break;
+	case 2:
+		AppendChar(context, '(');
+		AppendRegister(context, 'a', reg);
+		AppendChar(context, ')');
+		break;
+	case 3:
+		AppendChar(context, '(');
+		AppendRegister(context, 'a', reg);
+		Append(context, ")+");
+		break;
+	case 4:
+		Append(context, "-(");
+		AppendRegister(context, 'a', reg);
+		AppendChar(context, ')');
+		break;
+	case 5:
+		AppendSignedHex(context, (s16)ReadExtension(context));
+		AppendChar(context, '(');
+		AppendRegister(context, 'a', reg);
+		AppendChar(context, ')');
+		break;
+	case 6:
+	{
+		u16 extension = ReadExtension(context);
+		AppendSignedHex(context, (s8)(extension & 0xFF));
+		AppendChar(context, '(');
+		AppendRegister(context, 'a', reg);
+		AppendIndex(context, extension);
+		break;
+	}
+	default:
+		switch(reg)
+		{
+		case 0:
+		{
+			u16 address = ReadExtension(context);
+			SetTarget(context, (u32)(s32)(s16)address);
+			AppendChar(context, '(');
+			AppendHex(context, address);
+			Append(context, ").w");
+			break;
+		}
+		case 1:
+		{
+			u32 address = ReadExtension(context) << 16;
+			address |= ReadExtension(context);
+			SetTarget(context, address);
+			AppendChar(context, '(');
+			AppendHex(context, address);
+			Append(context, ").l");
+			break;
+		}
+		case 2:
+		{
+			//Relative to the extension word
+			u32 base = context.instruction->address + context.offset;
+			u32 target = base + (s16)ReadExtension(context);
+			SetTarget(context, target);
+			AppendHex(context, target);
+			Append(context, "(pc)");
+			break;
+		}
+		case 3:
+		{
+			u32 base = context.instruction->address + context.offset;
+			u16 extension = ReadExtension(context);
+			u32 target = base + (s8)(extension & 0xFF);
+			SetTarget(context, target);
+			AppendHex(context, target);
+			Append(context, "(pc");
+			AppendIndex(context, extension);
+			break;
+		}
+		default:
+			AppendImmediate(context, size);
+			break;
+		}
+		break;
+	}
+}
+
+//MOVEM register mask as ranges, e.g. d0-d3/a0/a6. Predecrement masks run a7 to d0.
+static void AppendRegisterList(DecodeContext& context, u16 mask, bool reversed)
+{
+	if(reversed)
+	{
+		u16 normal = 0;
+		for(u32 i = 0; i < 16; i++)
+		{
+			if(mask & (1 << i))
+				normal |= (u16)(0x8000 >> i);
+		}
+
+		mask = normal;
+	}
+
+	bool first = true;
+
+	for(u32 i = 0; i < 16; )
+	{
+		if(!(mask & (1 << i)))
+		{
+			i++;
+			continue;
+		}
+
+		//Ranges don't cross from data to address registers
+		u32 end = i;
+		while(end + 1 < 16 && (end + 1) % 8 != 0 && (mask & (1 << (end + 1))))
+			end++;
+
+		if(!first)
+			AppendChar(context, '/');
+
+		AppendRegister(context, (i < 8) ? 'd' : 'a', i & 7);
+
+		if(end > i)
+		{
+			AppendChar(context, '-');
+			AppendRegister(context, (end < 8) ? 'd' : 'a', end & 7);
+		}
+
+		first = false;
+		i = end + 1;
+	}
+}
+
+static void AppendMnemonic(DecodeContext& context, const OpcodePattern& pattern, u32 opcode)
+{
+	if(pattern.format == FORMAT_SHIFT_REG)
+		Append(context, s_shiftNames[(opcode >> 3) & 3]);
+	else if(pattern.format == FORMAT_SHIFT_MEM)
+		Append(context, s_shiftNames[(opcode >> 9) & 3]);
+	else
+		Append(context, pattern.mnemonic);
+
+	if(pattern.format == FORMAT_SHIFT_REG || pattern.format == FORMAT_SHIFT_MEM)
+		AppendChar(context, (opcode & 0x100) ? 'l' : 'r');
+
+	if(pattern.flags & PATTERN_CONDITION)
+		Append(context, s_conditionNames[(opcode >> 8) & 0xF]);
+	else if(pattern.flags & PATTERN_BRANCH_CONDITION)
+		Append(context, s_branchConditionNames[(opcode >> 8) & 0xF]);
+
+	if(pattern.format == FORMAT_BRANCH)
+		Append(context, (opcode & 0xFF) ? ".s" : ".w");
+	else
+		Append(context, s_sizeSuffixes[pattern.size]);
+
+	if(pattern.format != FORMAT_NONE)
+	{
+		//Operands in a column
+		do
+		{
+			AppendChar(context, ' ');
+		}
+		while(context.textLength < 8);
+	}
+}
+
+static void AppendOperands(DecodeContext& context, const OpcodePattern& pattern, u32 opcode)
+{
+	u32 eaMode = (opcode >> 3) & 7;
+	u32 eaReg = opcode & 7;
+	u32 regX = (opcode >> 9) & 7;
+	u32 regY = opcode & 7;
+	u32 address = context.instruction->address;
+
+	switch(pattern.format)
+	{
+	case FORMAT_NONE:
+		break;
+	case FORMAT_EA:
+	case FORMAT_SHIFT_MEM:
+		AppendEA(context, eaMode, eaReg, pattern.size);
+		break;
+	case FORMAT_IMM_EA:
+		AppendImmediate(context, pattern.size);
+		AppendChar(context, ',');
+		AppendEA(context, eaMode, eaReg, pattern.size);
+		break;
+	case FORMAT_BIT_IMM_EA:
+		AppendImmediate(context, SIZE_BYTE);
+		AppendChar(context, ',');
+		AppendEA(context, eaMode, eaReg, SIZE_BYTE);
+		break;
+	case FORMAT_IMM_CCR:
+		AppendImmediate(context, SIZE_BYTE);
+		Append(context, ",ccr");
+		break;
+	case FORMAT_IMM_SR:
+		AppendImmediate(context, SIZE_WORD);
+		Append(context, ",sr");
+		break;
+	case FORMAT_DX_EA:
+		AppendRegister(context, 'd', regX);
+		AppendChar(context, ',');
+		AppendEA(context, eaMode, eaReg, pattern.size);
+		break;
+	case FORMAT_EA_DX:
+		AppendEA(context, eaMode, eaReg, pattern.size);
+		AppendChar(context, ',');
+		AppendRegister(context, 'd', regX);
+		break;
+	case FORMAT_EA_AX:
+		AppendEA(context, eaMode, eaReg, pattern.size);
+		AppendChar(context, ',');
+		AppendRegister(context, 'a', regX);
+		break;
+	case FORMAT_SR_EA:
+		Append(context, "sr,");
+		AppendEA(context, eaMode, eaReg, pattern.size);
+		break;
+	case FORMAT_EA_CCR:
+		AppendEA(context, eaMode, eaReg, pattern.size);
+		Append(context, ",ccr");
+		break;
+	case FORMAT_EA_SR:
+		AppendEA(context, eaMode, eaReg, pattern.size);
+		Append(context, ",sr");
+		break;
+	case FORMAT_MOVE:
+		AppendEA(context, eaMode, eaReg, pattern.size);
+		AppendChar(context, ',');
+		AppendEA(context, (opcode >> 6) & 7, regX, pattern.size);
+		break;
+	case FORMAT_MOVEP_TO_REG:
+		AppendSignedHex(context, (s16)ReadExtension(context));
+		AppendChar(context, '(');
+		AppendRegister(context, 'a', regY);
+		Append(context, "),");
+		AppendRegister(context, 'd', regX);
+		break;
+	case FORMAT_MOVEP_TO_MEM:
+		AppendRegister(context, 'd', regX);
+		AppendChar(context, ',');
+		AppendSignedHex(context, (s16)ReadExtension(context));
+		AppendChar(context, '(');
+		AppendRegister(context, 'a', regY);
+		AppendChar(context, ')');
+		break;
+	case FORMAT_DY:
+		AppendRegister(context, 'd', regY);
+		break;
+	case FORMAT_AY:
+		AppendRegister(context, 'a', regY);
+		break;
+	case FORMAT_TRAP:
+		AppendChar(context, '#');
+		AppendHex(context, opcode & 0xF);
+		break;
+	case FORMAT_LINK:
+		AppendRegister(context, 'a', regY);
+		Append(context, ",#");
+		AppendSignedHex(context, (s16)ReadExtension(context));
+		break;
+	case FORMAT_AY_USP:
+		AppendRegister(context, 'a', regY);
+		Append(context, ",usp");
+		break;
+	case FORMAT_USP_AY:
+		Append(context, "usp,");
+		AppendRegister(context, 'a', regY);
+		break;
+	case FORMAT_STOP:
+		AppendImmediate(context, SIZE_WORD);
+		break;
+	case FORMAT_MOVEM_TO_MEM:
+	{
+		//Mask word comes before the <ea> extension
+		u16 mask = ReadExtension(context);
+		AppendRegisterList(context, mask, eaMode == 4);
+		AppendChar(context, ',');
+		AppendEA(context, eaMode, eaReg, pattern.size);
+		break;
+	}
+	case FORMAT_MOVEM_TO_REG:
+	{
+		u16 mask = ReadExtension(context);
+		AppendEA(context, eaMode, eaReg, pattern.size);
+		AppendChar(context, ',');
+		AppendRegisterList(context, mask, false);
+		break;
+	}
+	case FORMAT_QUICK_EA:
+		AppendChar(context, '#');
+		AppendChar(context, (char)('0' + (regX ? regX : 8)));
+		AppendChar(context, ',');
+		AppendEA(context, eaMode, eaReg, pattern.size);
+		break;
+	case FORMAT_DBCC:
+	{
+		u32 target = address + 2 + (s16)ReadExtension(context);
+		AppendRegister(context, 'd', regY);
+		AppendChar(context, ',');
+		AppendHex(context, target);
+		SetTarget(context, target);
+		break;
+	}
+	case FORMAT_BRANCH:
+	{
+		s32 displacement = (s8)(opcode & 0xFF);
+
+		if(displacement == 0)
+			displacement = (s16)ReadExtension(context);
+		else if(displacement == -1)
+			context.ok = false;		//68020 long branch
+
+		u32 target = address + 2 + displacement;
+		AppendHex(context, target);
+		SetTarget(context, target);
+		break;
+	}
+	case FORMAT_MOVEQ:
+		AppendChar(context, '#');
+		AppendSignedHex(context, (s8)(opcode & 0xFF));
+		AppendChar(context, ',');
+		AppendRegister(context, 'd', regX);
+		break;
+	case FORMAT_DY_DX:
+	case FORMAT_EXG_DD:
+		AppendRegister(context, 'd', (pattern.format == FORMAT_DY_DX) ? regY : regX);
+		AppendChar(context, ',');
+		AppendRegister(context, 'd', (pattern.format == FORMAT_DY_DX) ? regX : regY);
+		break;
+	case FORMAT_PREDEC_PREDEC:
+		Append(context, "-(");
+		AppendRegister(context, 'a', regY);
+		Append(context, "),-(");
+		AppendRegister(context, 'a', regX);
+		AppendChar(context, ')');
+		break;
+	case FORMAT_POSTINC_POSTINC:
+		AppendChar(context, '(');
+		AppendRegister(context, 'a', regY);
+		Append(context, ")+,(");
+		AppendRegister(context, 'a', regX);
+		Append(context, ")+");
+		break;
+	case FORMAT_EXG_AA:
+		AppendRegister(context, 'a', regX);
+		AppendChar(context, ',');
+		AppendRegister(context, 'a', regY);
+		break;
+	case FORMAT_EXG_DA:
+		AppendRegister(context, 'd', regX);
+		AppendChar(context, ',');
+		AppendRegister(context, 'a', regY);
+		break;
+	case FORMAT_SHIFT_REG:
+		if(opcode & 0x20)
+		{
+			AppendRegister(context, 'd', regX);
+		}
+		else
+		{
+			AppendChar(context, '#');
+			AppendChar(context, (char)('0' + (regX ? regX : 8)));
+		}
+
+		AppendChar(context, ',');
+		AppendRegister(context, 'd', regY);
+		break;
+	}
+}
+
+void Disassemble68k(const u8* data, u32 size, u32 address, Instruction68k& instruction)
+{
+	std::call_once(s_opcodeTableBuilt, BuildOpcodeTable);
+
+	instruction.address = address;
+	instruction.size = 0;
+	instruction.valid = false;
+	instruction.hasTarget = false;
+	instruction.target = 0;
+	instruction.text[0] = 0;
+
+	DecodeContext context;
+	context.data = data;
+	context.size = size;
+	context.offset = 2;
+	context.ok = true;
+	context.instruction = &instruction;
+	context.textLength = 0;
+
+	if(size == 0)
+	{
+		return;
+	}
+
+	//Instructions are word aligned
+	if((address & 1) || size < 2)
+	{
+		Append(context, "dc.b    ");
+		AppendHex(context, data[0]);
+		instruction.size = 1;
+		return;
+	}
+
+	u16 opcode = ReadU16BE(data);
+	u8 patternIdx = s_opcodeTable[opcode];
+
+	if(patternIdx > 0)
+	{
+		const OpcodePattern& pattern = s_patterns[patternIdx - 1];
+		AppendMnemonic(context, pattern, opcode);
+		AppendOperands(context, pattern, opcode);
+	}
+
+	if(patternIdx == 0 || !context.ok)
+	{
+		//Not an instruction, or its extension words run past the end
+		context.textLength = 0;
+		instruction.hasTarget = false;
+		Append(context, "dc.w    ");
+		AppendHex(context, opcode);
+		instruction.size = 2;
+		return;
+	}
+
+	instruction.size = context.offset;
+	instruction.valid = true;
+}
@@ -0,0 +1,37 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#pragma once
+
+#include "atoms.h"
+
+//Longest 68000 instruction, move.l #imm,abs.l
+#define DISASM_MAX_INSTRUCTION_SIZE	10
+
+//Mnemonic and operands, e.g. "move.l  d0,(a1)+"
+#define DISASM_MAX_TEXT_SIZE		64
+
+//One decoded instruction. Words that don't decode as a 68000 instruction come back as dc.w,
+//and an odd address as dc.b, with valid false.
+struct Instruction68k
+{
+	u32 address;
+	u32 size;
+	bool valid;
+
+	//Branch, jump or PC relative/absolute operand address, for symbol annotation
+	bool hasTarget;
+	u32 target;
+
+	char text[DISASM_MAX_TEXT_SIZE];
+};
+
+//Decodes the big endian instruction at data, of at most size bytes, located at address.
+//Each opcode word is looked up in a 64K entry table, built on first use, giving its
+//instruction pattern, so decoding never walks the opcode bit fields.
+void Disassemble68k(const u8* data, u32 size, u32 address, Instruction68k& instruction);
@@ -0,0 +1,330 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Disassembler.h"
+#include "Disasm68k.h"
+
+//Bytes per chunk of work, chunks end at the first label after this
+#define DISASM_CHUNK_SIZE	(64 * 1024)
+
+//Instruction words shown before the text, longer instructions still show all their bytes
+#define DISASM_BYTES_COLUMN_WORDS	5
+
+//ROM symbols usable as labels, in address order
+struct DisasmLabels
+{
+	std::vector<u32> indices;
+	std::vector<u32> addresses;
+};
+
+static void CollectLabels(const FileCOFF& coffFile, DisasmLabels& labels)
+{
+	const ArrayView<FileCOFF::Symbol>& symbols = coffFile.GetSymbols();
+	const ArrayView<u32>& sortedIndices = coffFile.GetSortedSymbolIndices();
+
+	for(u32 i = 0; i < sortedIndices.size(); i++)
+	{
+		const FileCOFF::Symbol& symbol = symbols[sortedIndices[i]];
+
+		if(symbol.sectionIndex == COFF_SECTION_ROM_DATA + 1 && symbol.storageClass != COFF_STORAGE_CLASS_FILE && !coffFile.IsSectionSymbol(symbol))
+		{
+			labels.indices.push_back(sortedIndices[i]);
+			labels.addresses.push_back(symbol.value);
+		}
+	}
+}
+
+//Position of the first, best ranked label of those nearest at or before address, or -1
+static int FindLabel(const DisasmLabels& labels, u32 address)
+{
+	std::vector<u32>::const_iterator it = std::upper_bound(labels.addresses.begin(), labels.addresses.end(), address);
+	if(it == labels.addresses.begin())
+	{
+		return -1;
+	}
+
+	it = std::lower_bound(labels.addresses.begin(), it, *(it - 1));
+	return (int)(it - labels.addresses.begin());
+}
+
+static void WriteInstructionBytes(const FileCOFF::SectionHeader& section, const Instruction68k& instruction, OutputFormat format, OutputStream& stream)
+{
+	const u8* bytes = section.data + (instruction.address - section.physicalAddr);
+
+	if(instruction.size == 1)
+	{
+		stream << Hex(bytes[0], 2);
+		return;
+	}
+
+	for(u32 i = 0; i < instruction.size; i += 2)
+	{
+		if(i > 0 && format == FORMAT_TEXT)
+			stream << " ";
+
+		stream << Hex(ReadU16BE(bytes + i), 4);
+	}
+}
+
+static void DisassembleChunk(const FileCOFF& coffFile, const DisasmLabels& labels, u32 chunkStart, u32 chunkEnd, OutputFormat format, OutputStream& stream)
+{
+	const ArrayView<FileCOFF::Symbol>& symbols = coffFile.GetSymbols();
+	const FileCOFF::LineTable& lineTable = coffFile.GetLineTable();
+	const FileCOFF::SectionHeader& section = coffFile.m_sectionHeaders[COFF_SECTION_ROM_DATA];
+	u32 numLabels = (u32)labels.addresses.size();
+	u32 numLines = lineTable.GetCount();
+
+	//Label and line cursors, both advance with the address
+	u32 labelPos = (u32)(std::lower_bound(labels.addresses.begin(), labels.addresses.end(), chunkStart) - labels.addresses.begin());
+	u32 nextLine = (u32)(std::upper_bound(lineTable.addresses.begin(), lineTable.addresses.end(), chunkStart) - lineTable.addresses.begin());
+	int currentLine = -1;
+
+	Instruction68k instruction;
+
+	for(u32 address = chunkStart; address < chunkEnd; address += instruction.size)
+	{
+		const char* label = NULL;
+
+		for(; labelPos < numLabels && labels.addresses[labelPos] <= address; labelPos++)
+		{
+			const char* name = coffFile.GetSymbolName(symbols[labels.indices[labelPos]]);
+
+			if(!label)
+			{
+				label = name;
+
+				if(format == FORMAT_TEXT)
+					stream << "\n";
+			}
+
+			if(format == FORMAT_TEXT)
+				stream << name << ":\n";
+		}
+
+		while(nextLine < numLines && lineTable.addresses[nextLine] <= address)
+		{
+			nextLine++;
+		}
+
+		int lineIdx = (nextLine > 0 && address < lineTable.endAddresses[nextLine - 1]) ? (int)nextLine - 1 : -1;
+		const char* filename = (lineIdx >= 0) ? coffFile.GetLineFilename(lineTable.fileIndices[lineIdx]) : NULL;
+
+		if(format == FORMAT_TEXT && lineIdx >= 0 && lineIdx != currentLine)
+		{
+			stream << "; " << filename << ":" << lineTable.lineNumbers[lineIdx] << "\n";
+		}
+
+		currentLine = lineIdx;
+
+		//Stop at the next label, code resumes there
+		u32 limit = (labelPos < numLabels && labels.addresses[labelPos] < chunkEnd) ? labels.addresses[labelPos] : chunkEnd;
+		Disassemble68k(section.data + (address - section.physicalAddr), limit - address, address, instruction);
+
+		//Annotate targets inside the ROM with the label they fall in
+		int targetLabel = -1;
+		if(instruction.hasTarget && instruction.target >= section.physicalAddr && instruction.target - section.physicalAddr < section.size)
+		{
+			targetLabel = FindLabel(labels, instruction.target);
+		}
+
+		if(format == FORMAT_JSON)
+		{
+			stream << "{\"type\":\"instruction\",\"address\":" << address << ",\"size\":" << instruction.size << ",\"bytes\":\"";
+			WriteInstructionBytes(section, instruction, format, stream);
+			stream << "\",\"text\":";
+			WriteJSONString(instruction.text, stream);
+
+			if(label)
+			{
+				stream << ",\"symbol\":";
+				WriteJSONString(label, stream);
+			}
+
+			if(lineIdx >= 0)
+			{
+				stream << ",\"filename\":";
+				WriteJSONString(filename, stream);
+				stream << ",\"line\":" << lineTable.lineNumbers[lineIdx];
+			}
+
+			if(instruction.hasTarget)
+			{
+				stream << ",\"target\":" << instruction.target;
+			}
+
+			if(targetLabel >= 0)
+			{
+				stream << ",\"targetSymbol\":";
+				WriteJSONString(coffFile.GetSymbolName(symbols[labels.indices[targetLabel]]), stream);
+				stream << ",\"targetOffset\":" << (instruction.target - labels.addresses[targetLabel]);
+			}
+
+			stream << "}\n";
+		}
+		else if(format == FORMAT_CSV)
+		{
+			stream << address << ",";
+			WriteInstructionBytes(section, instruction, format, stream);
+			stream << ",";
+			WriteCSVField(instruction.text, stream);
+			stream << ",";
+			WriteCSVField(label ? label : "", stream);
+			stream << ",";
+
+			if(lineIdx >= 0)
+			{
+				WriteCSVField(filename, stream);
+				stream << "," << lineTable.lineNumbers[lineIdx];
+			}
+			else
+			{
+				stream << ",";
+			}
+
+			stream << "\n";
+		}
+		else
+		{
+			stream << Hex(address, 8) << "  ";
+			WriteInstructionBytes(section, instruction, format, stream);
+
+			//Line up the text column
+			u32 bytesWidth = (instruction.size == 1) ? 2 : (instruction.size / 2) * 5 - 1;
+			for(u32 i = bytesWidth; i < DISASM_BYTES_COLUMN_WORDS * 5 + 1; i++)
+			{
+				stream << " ";
+			}
+
+			stream << instruction.text;
+
+			if(targetLabel >= 0)
+			{
+				stream << "\t; " << coffFile.GetSymbolName(symbols[labels.indices[targetLabel]]);
+
+				u32 offset = instruction.target - labels.addresses[targetLabel];
+				if(offset > 0)
+					stream << "+$" << Hex(offset);
+			}
+
+			stream << "\n";
+		}
+	}
+}
+
+bool DisassembleROM(const FileCOFF& coffFile, u32 start, u32 end, u32 numThreads, OutputFormat format, OutputStream& stream, std::string& error)
+{
+	if(coffFile.m_sectionHeaders.size() <= COFF_SECTION_ROM_DATA || !coffFile.m_sectionHeaders[COFF_SECTION_ROM_DATA].data)
+	{
+		error = "No ROM section";
+		return false;
+	}
+
+	//Clamp to the ROM section
+	const FileCOFF::SectionHeader& section = coffFile.m_sectionHeaders[COFF_SECTION_ROM_DATA];
+	u32 sectionEnd = section.physicalAddr + section.size;
+	start = std::max(start, section.physicalAddr);
+	end = std::min(end, sectionEnd);
+
+	if(start >= end)
+	{
+		error = "Address range is outside the ROM section";
+		return false;
+	}
+
+	DisasmLabels labels;
+	CollectLabels(coffFile, labels);
+
+	//Split at labels, so chunks decode exactly as one sequential pass would
+	std::vector<u32> chunkStarts(1, start);
+	while(end - chunkStarts.back() > DISASM_CHUNK_SIZE)
+	{
+		std::vector<u32>::const_iterator it = std::lower_bound(labels.addresses.begin(), labels.addresses.end(), chunkStarts.back() + DISASM_CHUNK_SIZE);
+		if(it == labels.addresses.end() || *it >= end)
+			break;
+
+		chunkStarts.push_back(*it);
+	}
+
+	u32 numChunks = (u32)chunkStarts.size();
+	chunkStarts.push_back(end);
+
+	if(format == FORMAT_TEXT)
+	{
+		stream << "-------------------------------------\n";
+		stream << "DISASSEMBLY\n";
+		stream << "-------------------------------------\n";
+		stream << "Range: 0x" << Hex(start) << " - 0x" << Hex(end) << "\n";
+	}
+	else if(format == FORMAT_CSV)
+	{
+		stream << "address,bytes,instruction,symbol,filename,line\n";
+	}
+
+	//Workers take the next chunk from a shared counter, chunks are written in address order as each is ready
+	std::vector<std::string> chunkOutputs(numChunks);
+	std::vector<bool> chunkDone(numChunks, false);
+	std::mutex chunkDoneMutex;
+	std::condition_variable chunkDoneCondition;
+
+	numThreads = std::max(1u, std::min(numThreads, numChunks));
+
+	std::atomic<u32> nextChunk(0);
+	std::vector<std::thread> workers;
+
+	for(u32 i = 0; i < numThreads; i++)
+	{
+		workers.push_back(std::thread([&]()
+		{
+			for(u32 chunkIdx = nextChunk++; chunkIdx < numChunks; chunkIdx = nextChunk++)
+			{
+				std::string chunkOutput;
+
+				{
+					OutputStream chunkStream(&chunkOutput);
+					DisassembleChunk(coffFile, labels, chunkStarts[chunkIdx], chunkStarts[chunkIdx + 1], format, chunkStream);
+				}
+
+				std::lock_guard<std::mutex> lock(chunkDoneMutex);
+				chunkOutputs[chunkIdx].swap(chunkOutput);
+				chunkDone[chunkIdx] = true;
+				chunkDoneCondition.notify_all();
+			}
+		}));
+	}
+
+	for(u32 i = 0; i < numChunks; i++)
+	{
+		std::string chunkOutput;
+
+		{
+			std::unique_lock<std::mutex> lock(chunkDoneMutex);
+			while(!chunkDone[i])
+			{
+				chunkDoneCondition.wait(lock);
+			}
+
+			chunkOutput.swap(chunkOutputs[i]);
+		}
+
+		stream << chunkOutput;
+	}
+
+	for(u32 i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+
+	return true;
+}
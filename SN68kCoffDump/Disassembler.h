@@ -0,0 +1,22 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#pragma once
+
+#include <string>
+
+#include "FileCOFF.h"
+#include "OutputStream.h"
+#include "TableWriter.h"
+
+//Disassembles ROM section addresses [start, end), with ROM symbols as labels and a file:line marker
+//wherever the covering line entry changes. Decoding restarts at every label, so data between functions
+//can't misalign the code after it. The range is split into chunks at labels, disassembled by numThreads
+//workers and written in address order, so output doesn't depend on the thread count.
+//Requires the symbol and line tables. Binary format is not supported.
+bool DisassembleROM(const FileCOFF& coffFile, u32 start, u32 end, u32 numThreads, OutputFormat format, OutputStream& stream, std::string& error);
@@ -6,177 +6,1552 @@
 //   sn68kcoffdump - A SNASM68K COFF file info dump utility
 // ============================================================
 
-#include <iostream>
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
 
 #include "FileCOFF.h"
+#include "RadixSort.h"
 #include "timeutils.h"
 
 FileCOFF::FileCOFF()
 {
 	m_stringTableRaw = NULL;
+	m_zeroCopy = false;
+	m_deferTables = false;
+	m_useIndexCache = false;
+	m_compactStrings = false;
+	memset(&m_loadStats, 0, sizeof(m_loadStats));
 }
 
 FileCOFF::~FileCOFF()
 {
+	//Views into the mapping are released with it
+	if(!m_zeroCopy)
+	{
+		for(int i = 0; i < m_sectionHeaders.size(); i++)
+		{
+			if(m_sectionHeaders[i].data)
+			{
+				delete [] m_sectionHeaders[i].data;
+			}
+		}
+
+		if(m_stringTableRaw)
+		{
+			delete [] m_stringTableRaw;
+		}
+	}
+}
+
+bool FileCOFF::Load(const std::string& filename, bool useIndexCache)
+{
+	u64 startTime = GetTimeNs();
+
+	if(!m_mappedFile.Open(filename))
+	{
+		m_error = "Could not open file " + filename;
+		return false;
+	}
+
+	m_zeroCopy = true;
+
+	Stream stream((char*)m_mappedFile.GetData(), m_mappedFile.GetSize());
+
+	//Headers and section views are always needed, and cheap
+	if(!SerialiseHeaders(stream))
+	{
+		return false;
+	}
+
+	SerialiseSectionData(stream);
+
+	if(stream.HasError())
+	{
+		m_error = "Unexpected end of file";
+		return false;
+	}
+
+	//Symbol and line tables wait until an operation asks for them
+	m_deferTables = true;
+	m_useIndexCache = useIndexCache;
+	m_filename = filename;
+
+	m_loadStats.mapNs += GetTimeNs() - startTime;
+
+	return true;
+}
+
+bool FileCOFF::LoadSymbolTable()
+{
+	if(m_deferTables)
+	{
+		if(m_useIndexCache)
+			std::call_once(m_indexedTablesDecoded, &FileCOFF::DecodeIndexedTables, this);
+		else
+			std::call_once(m_symbolTableDecoded, &FileCOFF::DecodeSymbolTable, this);
+	}
+
+	return m_error.empty();
+}
+
+bool FileCOFF::LoadLineTable()
+{
+	if(m_deferTables)
+	{
+		if(m_useIndexCache)
+			std::call_once(m_indexedTablesDecoded, &FileCOFF::DecodeIndexedTables, this);
+		else
+			std::call_once(m_lineTableDecoded, &FileCOFF::DecodeLineTable, this);
+	}
+
+	return m_error.empty();
+}
+
+bool FileCOFF::LoadRelocations()
+{
+	if(m_deferTables)
+	{
+		std::call_once(m_relocationsDecoded, &FileCOFF::DecodeRelocationTable, this);
+	}
+
+	return m_error.empty();
+}
+
+//Getters decode on demand, the tables are logically part of the loaded file
+const ArrayView<FileCOFF::Symbol>& FileCOFF::GetSymbols() const
+{
+	const_cast<FileCOFF*>(this)->LoadSymbolTable();
+	return m_symbols;
+}
+
+const ArrayView<u32>& FileCOFF::GetSortedSymbolIndices() const
+{
+	const_cast<FileCOFF*>(this)->LoadSymbolTable();
+	return m_sortedSymbolIndices;
+}
+
+const FileCOFF::LineTable& FileCOFF::GetLineTable() const
+{
+	const_cast<FileCOFF*>(this)->LoadLineTable();
+	return m_lineTable;
+}
+
+const std::vector<FileCOFF::Relocation>& FileCOFF::GetRelocations() const
+{
+	const_cast<FileCOFF*>(this)->LoadRelocations();
+	return m_relocations;
+}
+
+u32 FileCOFF::GetNumLineFilenames() const
+{
+	const_cast<FileCOFF*>(this)->LoadLineTable();
+	return (u32)m_filenameTable.size();
+}
+
+void FileCOFF::DecodeSymbolTable()
+{
+	Stream stream((char*)m_mappedFile.GetData(), m_mappedFile.GetSize());
+
+	if(SerialiseSymbols(stream) && stream.HasError())
+	{
+		m_error = "Unexpected end of file";
+	}
+}
+
+void FileCOFF::DecodeLineTable()
+{
+	Stream stream((char*)m_mappedFile.GetData(), m_mappedFile.GetSize());
+
+	SerialiseLineNumbers(stream);
+
+	if(stream.HasError())
+	{
+		m_error = "Unexpected end of file";
+	}
+}
+
+void FileCOFF::DecodeRelocationTable()
+{
+	//Symbol indices are remapped past aux records
+	if(!LoadSymbolTable())
+	{
+		return;
+	}
+
+	u64 startTime = GetTimeNs();
+
+	Stream stream((char*)m_mappedFile.GetData(), m_mappedFile.GetSize());
+
+	SerialiseRelocations(stream);
+
+	m_loadStats.relocationsNs += GetTimeNs() - startTime;
+
+	if(stream.HasError())
+	{
+		m_error = "Unexpected end of file";
+	}
+}
+
+void FileCOFF::DecodeIndexedTables()
+{
+	//Index validation checks line file indices against the filename table
+	BuildFilenameTable();
+
+	//Long symbol names are used from the COFF's string table, the index doesn't hold them
+	Stream stringTableStream((char*)m_mappedFile.GetData(), m_mappedFile.GetSize());
+	stringTableStream.Seek((s64)m_fileHeader.symbolTableOffset + ((s64)m_fileHeader.numSymbols * COFF_SYMBOL_SIZE), Stream::SEEK_START);
+
+	if(!ReadStringTable(stringTableStream))
+	{
+		return;
+	}
+
+	std::string indexFilename = IndexCache::GetFilename(m_filename);
+	u64 coffHash = IndexCache::Hash(m_mappedFile.GetData(), m_mappedFile.GetSize());
+
+	u64 startTime = GetTimeNs();
+	bool indexRead = m_indexCache.Read(indexFilename, coffHash, m_mappedFile.GetSize(), *this);
+	m_loadStats.indexCacheReadNs += GetTimeNs() - startTime;
+
+	if(indexRead)
+	{
+		BuildFunctionIndex();
+		return;
+	}
+
+	//Missing or stale, parse tables and rebuild index
+	Stream stream((char*)m_mappedFile.GetData(), m_mappedFile.GetSize());
+
+	if(!SerialiseSymbols(stream))
+	{
+		return;
+	}
+
+	SerialiseLineNumbers(stream);
+
+	if(stream.HasError())
+	{
+		m_error = "Unexpected end of file";
+		return;
+	}
+
+	startTime = GetTimeNs();
+	IndexCache::Write(indexFilename, coffHash, m_mappedFile.GetSize(), *this);
+	m_loadStats.indexCacheWriteNs += GetTimeNs() - startTime;
+}
+
+void FileCOFF::Serialise(Stream& stream)
+{
+	if(!SerialiseHeaders(stream))
+	{
+		return;
+	}
+
+	if(!SerialiseSymbols(stream))
+	{
+		return;
+	}
+
+	SerialiseSectionData(stream);
+	SerialiseRelocations(stream);
+	SerialiseLineNumbers(stream);
+
+	if(stream.HasError())
+	{
+		m_error = (stream.GetDirection() == Stream::STREAM_IN) ? "Unexpected end of file" : "Output exceeds layout size";
+	}
+}
+
+bool FileCOFF::Save(const std::string& filename, u64& size)
+{
+	size = Layout();
+	if(size == 0)
+	{
+		return false;
+	}
+
+	//Gaps between tables stay zero
+	std::vector<u8> data((size_t)size, 0);
+	Stream stream((char*)&data[0], size, Stream::STREAM_OUT);
+	Serialise(stream);
+
+	if(!m_error.empty())
+	{
+		return false;
+	}
+
+	//Written alongside then renamed, filename may be the mapped input
+	std::string tempFilename = filename + ".tmp";
+	FILE* file = fopen(tempFilename.c_str(), "wb");
+	if(!file)
+	{
+		m_error = "Could not create file " + filename;
+		return false;
+	}
+
+	bool written = (fwrite(&data[0], 1, data.size(), file) == data.size());
+
+	if(fclose(file) != 0 || !written)
+	{
+		remove(tempFilename.c_str());
+		m_error = "Could not write file " + filename;
+		return false;
+	}
+
+#if defined(_WIN32)
+	//Windows rename won't replace an existing file
+	remove(filename.c_str());
+#endif
+
+	if(rename(tempFilename.c_str(), filename.c_str()) != 0)
+	{
+		remove(tempFilename.c_str());
+		m_error = "Could not write file " + filename;
+		return false;
+	}
+
+	return true;
+}
+
+u64 FileCOFF::Layout()
+{
+	if(!LoadSymbolTable() || !LoadLineTable() || !LoadRelocations())
+	{
+		return 0;
+	}
+
+	//Layout fills in string table offsets
+	OwnTables();
+
+	u64 offset = COFF_FILE_HEADER_SIZE + m_fileHeader.exHeaderSize + ((u64)m_fileHeader.numSections * COFF_SECTION_HEADER_SIZE);
+
+	//Section data, sections without any keep a zero offset
+	for(int i = 0; i < m_fileHeader.numSections; i++)
+	{
+		SectionHeader& section = m_sectionHeaders[i];
+
+		if(section.data && section.size > 0)
+		{
+			section.sectiondataOffset = (u32)offset;
+			offset += section.size;
+		}
+		else
+		{
+			section.sectiondataOffset = 0;
+		}
+	}
+
+	//Line records per section, including a filename record per run of lines from one file
+	std::vector<u32> numLineRecords(m_fileHeader.numSections, 0);
+	std::vector<u32> lastFileIndices(m_fileHeader.numSections, (u32)-1);
+
+	for(u32 i = 0; i < m_lineTable.GetCount(); i++)
+	{
+		int sectionIdx = GetLineSectionIdx(m_lineTable.addresses[i]);
+		if(sectionIdx < 0)
+			continue;
+
+		if(m_lineTable.fileIndices[i] != lastFileIndices[sectionIdx])
+		{
+			lastFileIndices[sectionIdx] = m_lineTable.fileIndices[i];
+			numLineRecords[sectionIdx]++;
+		}
+
+		numLineRecords[sectionIdx]++;
+	}
+
+	for(int i = 0; i < m_fileHeader.numSections; i++)
+	{
+		SectionHeader& section = m_sectionHeaders[i];
+
+		//Count is a u16 in the section header
+		if(numLineRecords[i] > 0xFFFF)
+		{
+			m_error = "Too many line records: " + std::string(section.name.c_str());
+			return 0;
+		}
+
+		section.numLineNumberTableEntries = (u16)numLineRecords[i];
+		section.lineNumberTableOffset = numLineRecords[i] ? (u32)offset : 0;
+		offset += (u64)numLineRecords[i] * COFF_LINE_NUMBER_SIZE;
+	}
+
+	//Relocations, held in section order
+	for(int i = 0; i < m_fileHeader.numSections; i++)
+	{
+		SectionHeader& section = m_sectionHeaders[i];
+		u32 end = (i + 1 < m_fileHeader.numSections) ? m_sectionHeaders[i + 1].firstRelocation : (u32)m_relocations.size();
+		u32 numRelocations = end - section.firstRelocation;
+
+		section.numRelocationEntries = (u16)numRelocations;
+		section.relocationTableOffset = numRelocations ? (u32)offset : 0;
+		offset += (u64)numRelocations * COFF_RELOCATION_SIZE;
+	}
+
+	//Symbol table, each symbol followed by its aux records
+	m_fileHeader.symbolTableOffset = (u32)offset;
+	m_fileHeader.numSymbols = (u32)(m_symbols.size() + m_symbolAux.size());
+	offset += (u64)m_fileHeader.numSymbols * COFF_SYMBOL_SIZE;
+
+	LayoutStringTable();
+	offset += sizeof(u32) + m_layoutStringTable.size();
+
+	if(offset > 0xFFFFFFFF)
+	{
+		m_error = "File too large";
+		return 0;
+	}
+
+	return offset;
+}
+
+void FileCOFF::LayoutStringTable()
+{
+	m_layoutStringTable.clear();
+
+	//Open addressed hash of string offset + 1, only used to share names when compacting
+	std::vector<u32> buckets;
+	if(m_compactStrings)
+	{
+		u32 numBuckets = 16;
+		while(numBuckets < m_symbols.size() * 2)
+		{
+			numBuckets <<= 1;
+		}
+
+		buckets.assign(numBuckets, 0);
+	}
+
+	for(u32 i = 0; i < m_symbols.size(); i++)
+	{
+		Symbol& symbol = m_symbolStorage[i];
+		const char* name = GetSymbolName(symbol);
+		u32 length = (u32)strlen(name);
+
+		//Inline names can't be empty, a zero first word marks a string table offset
+		bool inlineName = (length > 0 && length <= COFF_SECTION_NAME_SIZE) && (m_compactStrings || symbol.stringTableOffset == (u32)-1);
+		symbol.stringTableOffset = inlineName ? (u32)-1 : AddLayoutString(name, buckets);
+
+		//Long source filenames of .file symbols are in the string table too
+		u32 auxCount = 0;
+		SymbolAux* aux = const_cast<SymbolAux*>(GetSymbolAux(i, auxCount));
+
+		if(symbol.storageClass == COFF_STORAGE_CLASS_FILE && aux && ReadU32LE(aux[0].record) == 0)
+		{
+			std::string filename = GetSymbolFilename(i);
+			WriteU32LE(aux[0].record + sizeof(u32), AddLayoutString(filename.c_str(), buckets));
+		}
+	}
+}
+
+u32 FileCOFF::AddLayoutString(const char* string, std::vector<u32>& buckets)
+{
+	u32 bucket = 0;
+
+	if(!buckets.empty())
+	{
+		u32 numBuckets = (u32)buckets.size();
+		bucket = HashSymbolName(string) & (numBuckets - 1);
+
+		for(; buckets[bucket] != 0; bucket = (bucket + 1) & (numBuckets - 1))
+		{
+			if(strcmp(&m_layoutStringTable[buckets[bucket] - 1], string) == 0)
+			{
+				return sizeof(u32) + buckets[bucket] - 1;
+			}
+		}
+	}
+
+	//Offsets include the size field
+	u32 offset = (u32)m_layoutStringTable.size();
+	m_layoutStringTable.insert(m_layoutStringTable.end(), string, string + strlen(string) + 1);
+
+	if(!buckets.empty())
+	{
+		buckets[bucket] = offset + 1;
+	}
+
+	return sizeof(u32) + offset;
+}
+
+int FileCOFF::GetLineSectionIdx(u32 address) const
+{
+	//First loaded section holding the address
+	for(int i = 0; i < m_fileHeader.numSections; i++)
+	{
+		const SectionHeader& section = m_sectionHeaders[i];
+
+		if((section.flags & (COFF_SECTION_FLAG_TEXT | COFF_SECTION_FLAG_DATA)) && address >= section.physicalAddr && address - section.physicalAddr < section.size)
+		{
+			return i;
+		}
+	}
+
+	//Otherwise with the code
+	if(m_fileHeader.numSections > COFF_SECTION_ROM_DATA)
+	{
+		return COFF_SECTION_ROM_DATA;
+	}
+
+	return m_fileHeader.numSections - 1;
+}
+
+bool FileCOFF::Compact()
+{
+	if(!LoadSymbolTable() || !LoadLineTable() || !LoadRelocations())
+	{
+		return false;
+	}
+
+	OwnTables();
+
+	//Relocation targets must stay
+	std::vector<bool> keep(m_symbols.size(), false);
+	for(u32 i = 0; i < m_relocations.size(); i++)
+	{
+		keep[m_relocations[i].symbolIndex] = true;
+	}
+
+	//Symbols with an address, in a section or absolute
+	for(u32 i = 0; i < m_symbols.size(); i++)
+	{
+		const Symbol& symbol = m_symbols[i];
+		bool addressClass = (symbol.storageClass == COFF_STORAGE_CLASS_EXTERNAL || symbol.storageClass == COFF_STORAGE_CLASS_STATIC || symbol.storageClass == COFF_STORAGE_CLASS_LABEL);
+
+		if(addressClass && (symbol.sectionIndex > 0 || symbol.sectionIndex == -1) && !IsSectionSymbol(symbol))
+		{
+			keep[i] = true;
+		}
+	}
+
+	//New table in address order
+	std::vector<u32> newIndices(m_symbols.size(), (u32)-1);
+	std::vector<Symbol> symbols;
+	std::vector<SymbolAux> symbolAux;
+
+	for(u32 i = 0; i < m_sortedSymbolIndices.size(); i++)
+	{
+		u32 index = m_sortedSymbolIndices[i];
+		if(!keep[index])
+			continue;
+
+		Symbol symbol = m_symbols[index];
+		symbol.auxCount = 0;
+
+		//Function sizes are read from the first aux record
+		u32 auxCount = 0;
+		const SymbolAux* aux = GetSymbolAux(index, auxCount);
+
+		if(symbol.IsFunction() && symbol.size > 0 && aux)
+		{
+			symbolAux.push_back(aux[0]);
+			symbolAux.back().symbolIndex = (u32)symbols.size();
+			symbol.auxCount = 1;
+		}
+
+		newIndices[index] = (u32)symbols.size();
+		symbols.push_back(symbol);
+	}
+
+	for(u32 i = 0; i < m_relocations.size(); i++)
+	{
+		m_relocations[i].symbolIndex = newIndices[m_relocations[i].symbolIndex];
+	}
+
+	m_symbolStorage.swap(symbols);
+	m_symbolAuxStorage.swap(symbolAux);
+	SortSymbols();
+
+	if(!m_symbolNameBuckets.empty())
+	{
+		BuildSymbolNameIndex();
+	}
+
+	m_lineTable.RemoveEmpty();
+
+	m_compactStrings = true;
+
+	return true;
+}
+
+bool FileCOFF::SerialiseHeaders(Stream& stream)
+{
+	//Serialise file header
+	stream.Serialise(m_fileHeader);
+
+	//Serialise executable header
+	if(m_fileHeader.exHeaderSize > 0)
+	{
+		stream.Serialise(m_executableHeader);
+	}
+
+	//Section headers follow the declared executable header size
+	stream.Seek(COFF_FILE_HEADER_SIZE + m_fileHeader.exHeaderSize, Stream::SEEK_START);
+
+	if(stream.GetDirection() == Stream::STREAM_IN)
+	{
+		if(stream.HasError() || !stream.IsInRange(stream.GetPosition(), (u64)m_fileHeader.numSections * COFF_SECTION_HEADER_SIZE))
+		{
+			m_error = "File truncated in headers";
+			return false;
+		}
+
+		//Allocate section headers
+		m_sectionHeaders.resize(m_fileHeader.numSections);
+	}
+
+	//Serialise section headers
+	for(int i = 0; i < m_fileHeader.numSections; i++)
+	{
+		stream.Serialise(m_sectionHeaders[i]);
+	}
+
+	if(stream.GetDirection() == Stream::STREAM_IN)
+	{
+		//Check all header declared offsets and counts before reading any tables
+		return ValidateLayout(stream);
+	}
+
+	return true;
+}
+
+bool FileCOFF::SerialiseSymbols(Stream& stream)
+{
+	//Seek to symbol table
+	stream.Seek(m_fileHeader.symbolTableOffset, Stream::SEEK_START);
+
+	if(stream.GetDirection() == Stream::STREAM_IN)
+	{
+		//Decode whole symbol table
+		u64 startTime = GetTimeNs();
+		DecodeSymbols(stream.Read((u64)m_fileHeader.numSymbols * COFF_SYMBOL_SIZE));
+		m_loadStats.symbolRecordsNs += GetTimeNs() - startTime;
+	}
+	else
+	{
+		//Serialise symbol table, each symbol followed by its aux records
+		u32 auxIndex = 0;
+
+		for(u32 i = 0; i < m_symbolStorage.size(); i++)
+		{
+			SerialiseSymbol(stream, m_symbolStorage[i]);
+
+			for(; auxIndex < m_symbolAuxStorage.size() && m_symbolAuxStorage[auxIndex].symbolIndex == i; auxIndex++)
+			{
+				stream.Serialise(m_symbolAuxStorage[auxIndex].record, COFF_SYMBOL_SIZE);
+			}
+		}
+	}
+
+	u64 namesStartTime = GetTimeNs();
+
+	if(stream.GetDirection() == Stream::STREAM_IN)
+	{
+		if(!ReadStringTable(stream))
+		{
+			return false;
+		}
+
+		//Long names stay in the string table, short names were interned with their records
+		u32 stringTableLength = m_symbolNames.GetExternalSize();
+
+		for(u32 i = 0; i < m_symbolStorage.size(); i++)
+		{
+			Symbol& symbol = m_symbolStorage[i];
+
+			if(symbol.stringTableOffset != -1)
+			{
+				u32 offset = symbol.stringTableOffset - sizeof(u32);
+				if(symbol.stringTableOffset < sizeof(u32) || offset >= stringTableLength)
+				{
+					m_error = "Symbol name offset out of bounds";
+					return false;
+				}
+
+				symbol.name = StringPool::GetExternalHandle(offset);
+			}
+		}
+
+		AttachSymbolAux();
+		m_loadStats.symbolNamesNs += GetTimeNs() - namesStartTime;
+
+		u64 sortStartTime = GetTimeNs();
+		SortSymbols();
+		m_loadStats.symbolSortNs += GetTimeNs() - sortStartTime;
+	}
+	else
+	{
+		//Size includes the size field itself, table laid out by Layout()
+		u32 stringTableSizeBytes = (u32)(sizeof(u32) + m_layoutStringTable.size());
+		stream.Serialise(stringTableSizeBytes);
+
+		if(!m_layoutStringTable.empty())
+		{
+			stream.Serialise((u8*)&m_layoutStringTable[0], (u32)m_layoutStringTable.size());
+		}
+	}
+
+	return true;
+}
+
+bool FileCOFF::ReadStringTable(Stream& stream)
+{
+	//Follows the symbol table, size includes the size field itself
+	u32 stringTableSizeBytes = 0;
+	stream.Serialise(stringTableSizeBytes);
+
+	u32 stringTableLength = (stringTableSizeBytes > sizeof(u32)) ? (stringTableSizeBytes - sizeof(u32)) : 0;
+
+	if(!stream.IsInRange(stream.GetPosition(), stringTableLength))
+	{
+		m_error = "String table out of bounds";
+		return false;
+	}
+
+	//All names must be terminated within the table
+	if(stringTableLength > 0 && stream.GetPtr()[stringTableLength - 1] != 0)
+	{
+		m_error = "String table not terminated";
+		return false;
+	}
+
+	if(m_zeroCopy)
+	{
+		//Point at string table in place
+		m_stringTableRaw = stream.Read(stringTableLength);
+	}
+	else
+	{
+		//Allocate and read string table, replacing any read before
+		delete [] m_stringTableRaw;
+
+		u8* stringTable = new u8[stringTableLength];
+		stream.Serialise(stringTable, stringTableLength);
+		m_stringTableRaw = stringTable;
+	}
+
+	m_symbolNames.SetExternal((const char*)m_stringTableRaw, stringTableLength);
+
+	return true;
+}
+
+void FileCOFF::SerialiseSymbol(Stream& stream, Symbol& symbol)
+{
+	SymbolNameStringDef symbolStringDef;
+	memset(&symbolStringDef, 0, sizeof(symbolStringDef));
+
+	if(stream.GetDirection() == Stream::STREAM_OUT)
+	{
+		if(symbol.stringTableOffset == -1)
+		{
+			//Name fits here
+			strncpy(symbolStringDef.name, m_symbolNames.Get(symbol.name), COFF_SECTION_NAME_SIZE);
+		}
+		else
+		{
+			//Zero marker, then offset
+			WriteU32LE((u8*)symbolStringDef.name + sizeof(u32), symbol.stringTableOffset);
+		}
+	}
+
+	stream.Serialise((u8*)symbolStringDef.name, COFF_SECTION_NAME_SIZE);
+
+	if(stream.GetDirection() == Stream::STREAM_IN)
+	{
+		//NULL terminate string
+		symbolStringDef.name[COFF_SECTION_NAME_SIZE] = 0;
+
+		if(symbolStringDef.freeStringSpace == 0)
+		{
+			//Name doesn't fit, get string table offset
+			symbol.name = 0;
+			symbol.stringTableOffset = symbolStringDef.stringTableOffset;
+		}
+		else
+		{
+			//Name fits here
+			symbol.name = m_symbolNames.Add(symbolStringDef.name);
+			symbol.stringTableOffset = (u32)-1;
+		}
+
+		symbol.size = 0;
+		symbol.padding = 0;
+	}
+
+	stream.Serialise(symbol.value);
+	stream.Serialise(symbol.sectionIndex);
+	stream.Serialise(symbol.symbolType);
+	stream.Serialise(symbol.storageClass);
+	stream.Serialise(symbol.auxCount);
+}
+
+void FileCOFF::SerialiseSectionData(Stream& stream)
+{
+	//Read section data
+	for(int i = 0; i < m_fileHeader.numSections; i++)
+	{
+		if(m_sectionHeaders[i].sectiondataOffset > 0 && m_sectionHeaders[i].size > 0)
+		{
+			//Seek to data start
+			stream.Seek(m_sectionHeaders[i].sectiondataOffset, Stream::SEEK_START);
+
+			if(stream.GetDirection() == Stream::STREAM_OUT)
+			{
+				//Written from wherever it was read to
+				stream.Serialise(const_cast<u8*>(m_sectionHeaders[i].data), m_sectionHeaders[i].size);
+			}
+			else if(m_zeroCopy)
+			{
+				//Point at data in place
+				m_sectionHeaders[i].data = stream.Read(m_sectionHeaders[i].size);
+			}
+			else
+			{
+				//Alloc and read data
+				u8* data = new u8[m_sectionHeaders[i].size];
+				stream.Serialise(data, m_sectionHeaders[i].size);
+				m_sectionHeaders[i].data = data;
+			}
+		}
+	}
+}
+
+void FileCOFF::SerialiseRelocations(Stream& stream)
+{
+	//Symbol table record index of each symbol, past aux records
+	std::vector<u32> tableIndices;
+
+	if(stream.GetDirection() == Stream::STREAM_IN)
+	{
+		m_relocations.clear();
+	}
+	else if(!m_relocations.empty())
+	{
+		tableIndices.resize(m_symbols.size());
+
+		for(u32 i = 0, tableIndex = 0; i < m_symbols.size(); i++)
+		{
+			tableIndices[i] = tableIndex;
+			tableIndex += 1 + m_symbols[i].auxCount;
+		}
+	}
+
+	//Serialise relocation tables
+	for(int i = 0; i < m_fileHeader.numSections; i++)
+	{
+		if(stream.GetDirection() == Stream::STREAM_IN)
+		{
+			m_sectionHeaders[i].firstRelocation = (u32)m_relocations.size();
+		}
+
+		if(m_sectionHeaders[i].numRelocationEntries > 0)
+		{
+			if(stream.GetDirection() == Stream::STREAM_IN)
+			{
+				//Seek to relocation table start
+				stream.Seek(m_sectionHeaders[i].relocationTableOffset, Stream::SEEK_START);
+
+				//Decode all entries
+				if(!DecodeRelocations(i, stream.Read((u64)m_sectionHeaders[i].numRelocationEntries * COFF_RELOCATION_SIZE)))
+				{
+					return;
+				}
+			}
+			else
+			{
+				const SectionHeader& section = m_sectionHeaders[i];
+				stream.Seek(section.relocationTableOffset, Stream::SEEK_START);
+
+				//Back to addresses and table record indices
+				for(u32 j = 0; j < section.numRelocationEntries; j++)
+				{
+					const Relocation& relocation = m_relocations[section.firstRelocation + j];
+					u32 address = relocation.offset + section.virtualAddr;
+					u32 tableIndex = tableIndices[relocation.symbolIndex];
+					u16 type = relocation.type;
+
+					stream.Serialise(address);
+					stream.Serialise(tableIndex);
+					stream.Serialise(type);
+				}
+			}
+		}
+	}
+
+	if(stream.GetDirection() == Stream::STREAM_IN)
+	{
+		//Entries refer to table records, which include aux records
+		MapRelocationSymbols();
+	}
+}
+
+void FileCOFF::SerialiseLineNumbers(Stream& stream)
+{
+	if(stream.GetDirection() == Stream::STREAM_IN)
+	{
+		//Line entries refer to files by index
+		BuildFilenameTable();
+	}
+
+	//Serialise line number sections
+	for(int i = 0; i < m_fileHeader.numSections; i++)
+	{
+		if(m_sectionHeaders[i].numLineNumberTableEntries > 0)
+		{
+			if(stream.GetDirection() == Stream::STREAM_IN)
+			{
+				//Seek to line number section start
+				stream.Seek(m_sectionHeaders[i].lineNumberTableOffset, Stream::SEEK_START);
+
+				//Decode all entries
+				u64 startTime = GetTimeNs();
+				DecodeLineNumbers(i, stream.Read((u64)m_sectionHeaders[i].numLineNumberTableEntries * COFF_LINE_NUMBER_SIZE));
+				m_loadStats.lineRecordsNs += GetTimeNs() - startTime;
+			}
+			else
+			{
+				stream.Seek(m_sectionHeaders[i].lineNumberTableOffset, Stream::SEEK_START);
+
+				//Lines of this section in address order, a filename record starts each run from one file
+				u32 fileIndex = (u32)-1;
+
+				for(u32 j = 0; j < m_lineTable.GetCount(); j++)
+				{
+					if(GetLineSectionIdx(m_lineTable.addresses[j]) != i)
+						continue;
+
+					if(m_lineTable.fileIndices[j] != fileIndex)
+					{
+						fileIndex = m_lineTable.fileIndices[j];
+
+						//Filename table is 1-based
+						LineNumberEntry filenameEntry;
+						filenameEntry.filenameIndex = fileIndex + 1;
+						filenameEntry.sectionMarker = 0;
+						stream.Serialise(filenameEntry);
+					}
+
+					LineNumberEntry lineNumberEntry;
+					lineNumberEntry.physicalAddress = m_lineTable.addresses[j];
+					lineNumberEntry.lineNumber = m_lineTable.lineNumbers[j];
+					stream.Serialise(lineNumberEntry);
+				}
+			}
+		}
+	}
+
+	if(stream.GetDirection() == Stream::STREAM_IN)
+	{
+		//Sort line table by address
+		u64 startTime = GetTimeNs();
+		m_lineTable.Sort();
+		m_loadStats.lineSortNs += GetTimeNs() - startTime;
+	}
+}
+
+bool FileCOFF::ValidateLayout(const Stream& stream)
+{
+	if(m_fileHeader.numSymbols > COFF_MAX_SYMBOLS)
+	{
+		m_error = "Too many symbols";
+		return false;
+	}
+
+	if(!stream.IsInRange(m_fileHeader.symbolTableOffset, (u64)m_fileHeader.numSymbols * COFF_SYMBOL_SIZE + sizeof(u32)))
+	{
+		m_error = "Symbol table out of bounds";
+		return false;
+	}
+
 	for(int i = 0; i < m_fileHeader.numSections; i++)
 	{
-		if(m_sectionHeaders[i].data)
+		const SectionHeader& section = m_sectionHeaders[i];
+
+		if(section.sectiondataOffset > 0 && !stream.IsInRange(section.sectiondataOffset, section.size))
+		{
+			m_error = "Section data out of bounds: " + std::string(section.name.c_str());
+			return false;
+		}
+
+		//Offsets of empty tables are meaningless, some tools leave junk in them
+		if(section.numLineNumberTableEntries > 0 && !stream.IsInRange(section.lineNumberTableOffset, (u64)section.numLineNumberTableEntries * COFF_LINE_NUMBER_SIZE))
+		{
+			m_error = "Line number table out of bounds: " + std::string(section.name.c_str());
+			return false;
+		}
+
+		if(section.numRelocationEntries > 0 && !stream.IsInRange(section.relocationTableOffset, (u64)section.numRelocationEntries * COFF_RELOCATION_SIZE))
+		{
+			m_error = "Relocation table out of bounds: " + std::string(section.name.c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void FileCOFF::BuildFilenameTable()
+{
+	u64 startTime = GetTimeNs();
+
+	m_filenameTable.clear();
+	m_filenames.Clear();
+
+	if(m_fileHeader.numSections > COFF_SECTION_FILENAMES && m_sectionHeaders[COFF_SECTION_FILENAMES].data)
+	{
+		u32 lastStringPos = 0;
+		const char* filenameData = (const char*)m_sectionHeaders[COFF_SECTION_FILENAMES].data;
+
+		for(int i = 0; i < m_sectionHeaders[COFF_SECTION_FILENAMES].size; i++)
+		{
+			if(filenameData[i] == 0)
+			{
+				m_filenameTable.push_back(m_filenames.Add(filenameData + lastStringPos, i - lastStringPos));
+				lastStringPos = i+1;
+			}
+		}
+	}
+
+	m_loadStats.filenamesNs += GetTimeNs() - startTime;
+}
+
+//Order of symbols sharing an address
+static u32 GetStorageClassRank(s8 storageClass)
+{
+	switch(storageClass)
+	{
+	case COFF_STORAGE_CLASS_EXTERNAL:
+		return 0;
+	case COFF_STORAGE_CLASS_STATIC:
+		return 1;
+	case COFF_STORAGE_CLASS_LABEL:
+		return 2;
+	default:
+		return 3;
+	}
+}
+
+void FileCOFF::SortSymbols()
+{
+	u32 count = (u32)m_symbols.size();
+
+	//Address, then rank, then table index
+	std::vector<u64> keys(count);
+	for(u32 i = 0; i < count; i++)
+	{
+		keys[i] = ((u64)m_symbols[i].value << 32) | ((u64)GetStorageClassRank(m_symbols[i].storageClass) << 28) | i;
+	}
+
+	//Keys start in index order, so only address and rank need sorting
+	RadixSortKeys(keys, 28);
+
+	m_sortedSymbolIndexStorage.resize(count);
+	m_sortedSymbolValueStorage.resize(count);
+
+	for(u32 i = 0; i < count; i++)
+	{
+		m_sortedSymbolIndexStorage[i] = (u32)keys[i] & COFF_MAX_SYMBOLS;
+		m_sortedSymbolValueStorage[i] = (u32)(keys[i] >> 32);
+	}
+
+	BindSymbolTables();
+	BuildFunctionIndex();
+}
+
+void FileCOFF::BindSymbolTables()
+{
+	m_symbols = ArrayView<Symbol>(m_symbolStorage);
+	m_sortedSymbolIndices = ArrayView<u32>(m_sortedSymbolIndexStorage);
+	m_sortedSymbolValues = ArrayView<u32>(m_sortedSymbolValueStorage);
+	m_symbolAux = ArrayView<SymbolAux>(m_symbolAuxStorage);
+}
+
+void FileCOFF::OwnTables()
+{
+	if(m_symbols.data() != m_symbolStorage.data())
+	{
+		m_symbolStorage.assign(m_symbols.begin(), m_symbols.end());
+		m_sortedSymbolIndexStorage.assign(m_sortedSymbolIndices.begin(), m_sortedSymbolIndices.end());
+		m_sortedSymbolValueStorage.assign(m_sortedSymbolValues.begin(), m_sortedSymbolValues.end());
+		m_symbolAuxStorage.assign(m_symbolAux.begin(), m_symbolAux.end());
+		BindSymbolTables();
+	}
+
+	m_lineTable.Own();
+}
+
+void FileCOFF::BuildFunctionIndex()
+{
+	m_sortedFunctionIndices.clear();
+
+	//Functions with a known size, usually few, in address then table order
+	for(u32 i = 0; i < m_symbols.size(); i++)
+	{
+		if(m_symbols[i].IsFunction() && m_symbols[i].size > 0)
 		{
-			delete [] m_sectionHeaders[i].data;
+			m_sortedFunctionIndices.push_back(i);
 		}
 	}
 
-	if(m_stringTableRaw)
-	{
-		delete [] m_stringTableRaw;
-	}
+	const ArrayView<Symbol>& symbols = m_symbols;
+	std::stable_sort(m_sortedFunctionIndices.begin(), m_sortedFunctionIndices.end(), [&symbols](u32 lhs, u32 rhs) { return symbols[lhs].value < symbols[rhs].value; });
 }
 
-void FileCOFF::Serialise(Stream& stream)
+void FileCOFF::DecodeSymbols(const u8* data)
 {
-	//Serialise file header
-	stream.Serialise(m_fileHeader);
+	u32 numRecords = m_fileHeader.numSymbols;
+	m_symbolStorage.clear();
+	m_symbolStorage.reserve(numRecords);
+	m_symbolAuxStorage.clear();
 
-	//Serialise executable header
-	if(m_fileHeader.exHeaderSize > 0)
+	m_symbolNames.Clear();
+	m_symbolNames.Reserve(numRecords, numRecords * COFF_SECTION_NAME_SIZE);
+
+	//Fixed size records, range already validated
+	for(u32 i = 0; i < numRecords; i++)
 	{
-		stream.Serialise(m_executableHeader);
+		const u8* record = data + (i * COFF_SYMBOL_SIZE);
+		Symbol symbol;
+		symbol.Decode(record);
+
+		if(symbol.stringTableOffset == -1)
+		{
+			//Short name, up to 8 characters inline
+			u32 length = 0;
+			while(length < COFF_SECTION_NAME_SIZE && record[length] != 0)
+				length++;
+
+			symbol.name = m_symbolNames.Add((const char*)record, length);
+		}
+
+		//Aux records follow their symbol, clipped to the end of the table
+		if(symbol.auxCount > numRecords - 1 - i)
+		{
+			symbol.auxCount = (u8)(numRecords - 1 - i);
+		}
+
+		for(u32 j = 0; j < symbol.auxCount; j++)
+		{
+			SymbolAux aux;
+			aux.symbolIndex = (u32)m_symbolStorage.size();
+			memcpy(aux.record, record + ((j + 1) * COFF_SYMBOL_SIZE), COFF_SYMBOL_SIZE);
+			aux.padding = 0;
+			m_symbolAuxStorage.push_back(aux);
+		}
+
+		i += symbol.auxCount;
+		m_symbolStorage.push_back(symbol);
 	}
 
-	//Allocate section headers
-	if(stream.GetDirection() == Stream::STREAM_IN)
+	BindSymbolTables();
+}
+
+bool FileCOFF::IsSectionSymbol(const Symbol& symbol) const
+{
+	//Static, untyped and named after the section it's in
+	if(symbol.storageClass != COFF_STORAGE_CLASS_STATIC || symbol.symbolType != 0 || symbol.sectionIndex <= 0 || symbol.sectionIndex > m_sectionHeaders.size())
 	{
-		m_sectionHeaders.resize(m_fileHeader.numSections);
+		return false;
 	}
 
-	//Serialise section headers
-	for(int i = 0; i < m_fileHeader.numSections; i++)
+	return strncmp(m_symbolNames.Get(symbol.name), m_sectionHeaders[symbol.sectionIndex - 1].name.c_str(), COFF_SECTION_NAME_SIZE) == 0;
+}
+
+void FileCOFF::AttachSymbolAux()
+{
+	//First aux record of each symbol carries its size
+	for(u32 i = 0; i < m_symbolAux.size(); i += m_symbols[m_symbolAux[i].symbolIndex].auxCount)
 	{
-		stream.Serialise(m_sectionHeaders[i]);
+		Symbol& symbol = m_symbolStorage[m_symbolAux[i].symbolIndex];
+		const u8* record = m_symbolAux[i].record;
+
+		if(symbol.IsFunction())
+		{
+			symbol.size = ReadU32LE(record + 4);
+		}
+		else if(IsSectionSymbol(symbol))
+		{
+			symbol.size = ReadU32LE(record);
+		}
 	}
+}
 
-	if(stream.GetDirection() == Stream::STREAM_IN)
+bool FileCOFF::MapRelocationSymbols()
+{
+	if(m_relocations.empty())
 	{
-		//Allocate symbol table
-		m_symbols.resize(m_fileHeader.numSymbols);
+		return true;
+	}
 
-		//Seek to symbol table
-		stream.Seek(m_fileHeader.symbolTableOffset, Stream::SEEK_START);
+	//Symbol index of each table record, aux records map to none
+	std::vector<u32> symbolIndices(m_fileHeader.numSymbols, (u32)-1);
+	u32 tableIndex = 0;
+
+	for(u32 i = 0; i < m_symbols.size() && tableIndex < symbolIndices.size(); i++)
+	{
+		symbolIndices[tableIndex] = i;
+		tableIndex += 1 + m_symbols[i].auxCount;
 	}
 
-	//Serialise symbol table
-	for(int i = 0; i < m_fileHeader.numSymbols; i++)
+	for(u32 i = 0; i < m_relocations.size(); i++)
 	{
-		stream.Serialise(m_symbols[i]);
+		u32 symbolIndex = symbolIndices[m_relocations[i].symbolIndex];
+		if(symbolIndex == (u32)-1)
+		{
+			m_error = "Relocation refers to a symbol aux record";
+			return false;
+		}
+
+		m_relocations[i].symbolIndex = symbolIndex;
 	}
 
-	//Serialise string table size
-	u32 stringTableSizeBytes;
-	stream.Serialise(stringTableSizeBytes);
+	return true;
+}
 
-	//Allocate string table
-	if(stream.GetDirection() == Stream::STREAM_IN)
+void FileCOFF::DecodeLineNumbers(int sectionIdx, const u8* data)
+{
+	const SectionHeader& section = m_sectionHeaders[sectionIdx];
+
+	//Lines cannot extend past the end of their section
+	u32 sectionEnd = (section.size > 0) ? (section.physicalAddr + section.size) : 0xFFFFFFFF;
+
+	//Fixed size records, range already validated
+	for(u32 i = 0; i < section.numLineNumberTableEntries; i++)
 	{
-		m_stringTableRaw = new u8[stringTableSizeBytes];
+		LineNumberEntry lineNumberEntry;
+		lineNumberEntry.Decode(data + (i * COFF_LINE_NUMBER_SIZE));
+
+		//If a line number section header
+		if(lineNumberEntry.sectionMarker <= 0)
+		{
+			//Filename table is 1-based
+			lineNumberEntry.filenameIndex -= 1;
+
+			//Add new section
+			m_lineNumberSectionHeaders.push_back(lineNumberEntry);
+		}
+		else if(m_lineNumberSectionHeaders.size() > 0)
+		{
+			//Get filename from current line number section
+			u32 filenameIndex = m_lineNumberSectionHeaders.back().filenameIndex;
+
+			//Insert into line table
+			if(filenameIndex < m_filenameTable.size())
+			{
+				m_lineTable.Add(lineNumberEntry.physicalAddress, lineNumberEntry.lineNumber, filenameIndex, sectionEnd);
+			}
+		}
 	}
+}
 
-	//Serialise string table
-	stream.Serialise(m_stringTableRaw, stringTableSizeBytes);
+bool FileCOFF::DecodeRelocations(int sectionIdx, const u8* data)
+{
+	const SectionHeader& section = m_sectionHeaders[sectionIdx];
+	u32 first = (u32)m_relocations.size();
+	m_relocations.resize(first + section.numRelocationEntries);
 
-	//Resolve symbol strings
-	for(int i = 0; i < m_fileHeader.numSymbols; i++)
+	//Fixed size records, range already validated
+	for(u32 i = 0; i < section.numRelocationEntries; i++)
 	{
-		if(m_symbols[i].stringTableOffset != -1)
+		Relocation& relocation = m_relocations[first + i];
+		relocation.Decode(data + (i * COFF_RELOCATION_SIZE));
+
+		//Stored as an address, keep as an offset into the section data
+		relocation.offset -= section.virtualAddr;
+
+		//Patched field must lie within the section, up to a long wide
+		if(relocation.offset > section.size || section.size - relocation.offset < GetRelocationSize(relocation.type))
+		{
+			m_error = "Relocation out of bounds: " + std::string(section.name.c_str());
+			return false;
+		}
+
+		if(relocation.symbolIndex >= m_fileHeader.numSymbols)
 		{
-			m_symbols[i].name = (char*)m_stringTableRaw + (m_symbols[i].stringTableOffset - sizeof(u32));
+			m_error = "Relocation symbol index out of range: " + std::string(section.name.c_str());
+			return false;
 		}
 	}
 
-	//Copy to sorted table
-	m_sortedSymbols = m_symbols;
-	std::sort(m_sortedSymbols.begin(), m_sortedSymbols.end());
+	return true;
+}
 
-	//Read section data
-	for(int i = 0; i < m_fileHeader.numSections; i++)
+bool FileCOFF::FindLine(u32 address, LineInfo& lineInfo) const
+{
+	const LineTable& lineTable = GetLineTable();
+
+	int index = lineTable.Find(address);
+	if(index < 0)
 	{
-		if(m_sectionHeaders[i].sectiondataOffset > 0 && m_sectionHeaders[i].size > 0)
-		{
-			//Alloc data
-			m_sectionHeaders[i].data = new u8[m_sectionHeaders[i].size];
+		return false;
+	}
 
-			//Seek to data start
-			stream.Seek(m_sectionHeaders[i].sectiondataOffset, Stream::SEEK_START);
+	lineInfo.address = lineTable.addresses[index];
+	lineInfo.endAddress = lineTable.endAddresses[index];
+	lineInfo.lineNumber = lineTable.lineNumbers[index];
+	lineInfo.filename = GetLineFilename(lineTable.fileIndices[index]);
 
-			//Read data
-			stream.Serialise(m_sectionHeaders[i].data, m_sectionHeaders[i].size);
-		}
+	return true;
+}
+
+const FileCOFF::Symbol* FileCOFF::FindNearestSymbol(u32 address) const
+{
+	const ArrayView<Symbol>& symbols = GetSymbols();
+
+	//Find first symbol after address, nearest is the one before it
+	const u32* it = std::upper_bound(m_sortedSymbolValues.begin(), m_sortedSymbolValues.end(), address);
+	if(it == m_sortedSymbolValues.begin())
+	{
+		return NULL;
+	}
+
+	//Of all symbols at that address, take the first, best ranked one
+	it = std::lower_bound(m_sortedSymbolValues.begin(), it, *(it - 1));
+
+	return &symbols[m_sortedSymbolIndices[it - m_sortedSymbolValues.begin()]];
+}
+
+const FileCOFF::Symbol* FileCOFF::FindFunction(u32 address) const
+{
+	const ArrayView<Symbol>& symbols = GetSymbols();
+
+	//Last function starting at or before address
+	std::vector<u32>::const_iterator it = std::upper_bound(m_sortedFunctionIndices.begin(), m_sortedFunctionIndices.end(), address,
+		[&symbols](u32 value, u32 index) { return value < symbols[index].value; });
+
+	if(it == m_sortedFunctionIndices.begin())
+	{
+		return NULL;
+	}
+
+	const Symbol& function = symbols[*(it - 1)];
+	return (address - function.value < function.size) ? &function : NULL;
+}
+
+const FileCOFF::SymbolAux* FileCOFF::GetSymbolAux(u32 symbolIndex, u32& count) const
+{
+	const_cast<FileCOFF*>(this)->LoadSymbolTable();
+
+	//Held in symbol order
+	SymbolAux key;
+	key.symbolIndex = symbolIndex;
+	std::pair<const SymbolAux*, const SymbolAux*> range = std::equal_range(m_symbolAux.begin(), m_symbolAux.end(), key,
+		[](const SymbolAux& lhs, const SymbolAux& rhs) { return lhs.symbolIndex < rhs.symbolIndex; });
+
+	count = (u32)(range.second - range.first);
+	return count ? range.first : NULL;
+}
+
+std::string FileCOFF::GetSymbolFilename(u32 symbolIndex) const
+{
+	u32 count = 0;
+	const SymbolAux* aux = GetSymbolAux(symbolIndex, count);
+
+	if(symbolIndex >= m_symbols.size() || m_symbols[symbolIndex].storageClass != COFF_STORAGE_CLASS_FILE || !aux)
+	{
+		return std::string();
 	}
 
-	//Build filename table
-	u32 lastStringPos = 0;
-	const char* filenameData = (const char*)m_sectionHeaders[COFF_SECTION_FILENAMES].data;
-	
-	for(int i = 0; i < m_sectionHeaders[COFF_SECTION_FILENAMES].size; i++)
+	if(ReadU32LE(aux[0].record) == 0)
 	{
-		if(filenameData[i] == 0)
+		//Long filename in the string table, checked like symbol names
+		u32 offset = ReadU32LE(aux[0].record + 4);
+		if(offset < sizeof(u32) || offset - sizeof(u32) >= m_symbolNames.GetExternalSize())
 		{
-			m_filenameTable.push_back((const char*)(filenameData + lastStringPos));
-			lastStringPos = i+1;
+			return std::string();
 		}
+
+		return m_symbolNames.Get(StringPool::GetExternalHandle(offset - sizeof(u32)));
 	}
 
-	//Serialise line number sections
-	for(int i = 0; i < m_fileHeader.numSections; i++)
+	//Inline, continuing across aux records
+	std::string filename;
+	for(u32 i = 0; i < count; i++)
 	{
-		if(m_sectionHeaders[i].numLineNumberTableEntries > 0)
+		for(u32 j = 0; j < COFF_SYMBOL_SIZE; j++)
 		{
-			if(stream.GetDirection() == Stream::STREAM_IN)
+			if(aux[i].record[j] == 0)
 			{
-				//Seek to line number section start
-				stream.Seek(m_sectionHeaders[i].lineNumberTableOffset, Stream::SEEK_START);
+				return filename;
+			}
 
-				
+			filename += (char)aux[i].record[j];
+		}
+	}
 
-				//Read all entries
-				for(int j = 0; j < m_sectionHeaders[i].numLineNumberTableEntries; j++)
-				{
-					//Serialise entry
-					LineNumberEntry lineNumberEntry;
-					stream.Serialise(lineNumberEntry);
+	return filename;
+}
 
-					//If a line number section header
-					if(lineNumberEntry.sectionMarker <= 0)
-					{
-						//Filename table is 1-based
-						lineNumberEntry.filenameIndex -= 1;
+bool FileCOFF::GetSectionAux(u32 symbolIndex, SectionAux& sectionAux) const
+{
+	u32 count = 0;
+	const SymbolAux* aux = GetSymbolAux(symbolIndex, count);
 
-						//Add new section
-						m_lineNumberSectionHeaders.push_back(lineNumberEntry);
-					}
-					else
-					{
-						//Set line number section
-						lineNumberEntry.lineNumberSectionIdx = m_lineNumberSectionHeaders.size() - 1;
+	if(!aux || !IsSectionSymbol(m_symbols[symbolIndex]))
+	{
+		return false;
+	}
 
-						//Get filename
-						LineNumberEntry& lineNumberSectionHeader = m_lineNumberSectionHeaders[lineNumberEntry.lineNumberSectionIdx];
-						lineNumberEntry.filename = &m_filenameTable[lineNumberSectionHeader.filenameIndex];
+	sectionAux.length = ReadU32LE(aux[0].record);
+	sectionAux.numRelocations = ReadU16LE(aux[0].record + 4);
+	sectionAux.numLines = ReadU16LE(aux[0].record + 6);
+	return true;
+}
 
-						//Insert into address map
-						m_lineNumberAddressMap[lineNumberEntry.physicalAddress] = lineNumberEntry;
-					}
-				}
-			}
-			else
-			{
-				//TODO: Stream out
-			}
+const char* FileCOFF::GetStorageClassName(s8 storageClass)
+{
+	switch(storageClass)
+	{
+	case COFF_STORAGE_CLASS_END_OF_FUNCTION: return "end of function";
+	case COFF_STORAGE_CLASS_NULL: return "null";
+	case COFF_STORAGE_CLASS_AUTOMATIC: return "automatic";
+	case COFF_STORAGE_CLASS_EXTERNAL: return "external";
+	case COFF_STORAGE_CLASS_STATIC: return "static";
+	case COFF_STORAGE_CLASS_REGISTER: return "register";
+	case COFF_STORAGE_CLASS_EXTERNAL_DEF: return "external definition";
+	case COFF_STORAGE_CLASS_LABEL: return "label";
+	case COFF_STORAGE_CLASS_UNDEFINED_LABEL: return "undefined label";
+	case COFF_STORAGE_CLASS_STRUCT_MEMBER: return "struct member";
+	case COFF_STORAGE_CLASS_ARGUMENT: return "argument";
+	case COFF_STORAGE_CLASS_STRUCT_TAG: return "struct tag";
+	case COFF_STORAGE_CLASS_UNION_MEMBER: return "union member";
+	case COFF_STORAGE_CLASS_UNION_TAG: return "union tag";
+	case COFF_STORAGE_CLASS_TYPEDEF: return "typedef";
+	case COFF_STORAGE_CLASS_UNDEFINED_STATIC: return "undefined static";
+	case COFF_STORAGE_CLASS_ENUM_TAG: return "enum tag";
+	case COFF_STORAGE_CLASS_ENUM_MEMBER: return "enum member";
+	case COFF_STORAGE_CLASS_REGISTER_PARAM: return "register parameter";
+	case COFF_STORAGE_CLASS_BIT_FIELD: return "bit field";
+	case COFF_STORAGE_CLASS_BLOCK: return "block";
+	case COFF_STORAGE_CLASS_FUNCTION: return "function";
+	case COFF_STORAGE_CLASS_END_OF_STRUCT: return "end of struct";
+	case COFF_STORAGE_CLASS_FILE: return "file";
+	case COFF_STORAGE_CLASS_LINE: return "line";
+	case COFF_STORAGE_CLASS_ALIAS: return "alias";
+	case COFF_STORAGE_CLASS_HIDDEN: return "hidden";
+	default: return "unknown";
+	}
+}
+
+std::string FileCOFF::GetSymbolTypeName(u16 symbolType)
+{
+	static const char* baseTypeNames[] =
+	{
+		"none", "argument", "char", "short", "int", "long", "float", "double",
+		"struct", "union", "enum", "enum member", "unsigned char", "unsigned short", "unsigned int", "unsigned long"
+	};
+
+	static const char* derivedTypeNames[] = { "", "pointer to ", "function returning ", "array of " };
+
+	//Outermost derivation first
+	std::string name;
+	for(int i = 0; i < COFF_SYMBOL_TYPE_MAX_DERIVED; i++)
+	{
+		name += derivedTypeNames[(symbolType >> (COFF_SYMBOL_TYPE_DERIVED_SHIFT + (i * 2))) & 3];
+	}
+
+	//Untyped, or derived from nothing
+	if((symbolType & COFF_SYMBOL_TYPE_BASE_MASK) == 0 && !name.empty())
+	{
+		return name + "void";
+	}
+
+	return name + baseTypeNames[symbolType & COFF_SYMBOL_TYPE_BASE_MASK];
+}
+
+u32 FileCOFF::HashSymbolName(const char* name)
+{
+	//FNV-1a
+	u32 hash = 0x811C9DC5;
+	for(const u8* ptr = (const u8*)name; *ptr; ptr++)
+	{
+		hash = (hash ^ *ptr) * 0x01000193;
+	}
+
+	return hash;
+}
+
+void FileCOFF::BuildSymbolNameIndex()
+{
+	if(!LoadSymbolTable())
+	{
+		return;
+	}
+
+	u64 startTime = GetTimeNs();
+
+	//Power of two bucket count, at most half full
+	u32 numBuckets = 16;
+	while(numBuckets < m_symbols.size() * 2)
+	{
+		numBuckets <<= 1;
+	}
+
+	m_symbolNameBuckets.assign(numBuckets, 0);
+
+	for(u32 i = 0; i < m_symbols.size(); i++)
+	{
+		const char* name = GetSymbolName(m_symbols[i]);
+		u32 bucket = HashSymbolName(name) & (numBuckets - 1);
+
+		//Linear probe, keep first symbol of each name
+		while(m_symbolNameBuckets[bucket] != 0)
+		{
+			if(strcmp(GetSymbolName(m_symbols[m_symbolNameBuckets[bucket] - 1]), name) == 0)
+				break;
+
+			bucket = (bucket + 1) & (numBuckets - 1);
+		}
+
+		if(m_symbolNameBuckets[bucket] == 0)
+		{
+			m_symbolNameBuckets[bucket] = i + 1;
+		}
+	}
+
+	m_loadStats.nameIndexNs += GetTimeNs() - startTime;
+}
+
+const FileCOFF::Symbol* FileCOFF::FindSymbol(const char* name) const
+{
+	if(m_symbolNameBuckets.empty())
+	{
+		return NULL;
+	}
+
+	u32 mask = (u32)m_symbolNameBuckets.size() - 1;
+	u32 bucket = HashSymbolName(name) & mask;
+
+	while(m_symbolNameBuckets[bucket] != 0)
+	{
+		const Symbol& symbol = m_symbols[m_symbolNameBuckets[bucket] - 1];
+		if(strcmp(GetSymbolName(symbol), name) == 0)
+		{
+			return &symbol;
 		}
+
+		bucket = (bucket + 1) & mask;
 	}
+
+	return NULL;
+}
+
+const char* FileCOFF::GetSectionName(s16 sectionIndex) const
+{
+	if(sectionIndex > 0 && sectionIndex <= (s16)m_sectionHeaders.size())
+		return m_sectionHeaders[sectionIndex - 1].name.c_str();
+	else if(sectionIndex == 0)
+		return "UNDEFINED";
+	else if(sectionIndex == -1)
+		return "ABSOLUTE";
+	else if(sectionIndex == -2)
+		return "DEBUG";
+
+	return "UNKNOWN";
 }
 
-void FileCOFF::Dump(std::stringstream& stream)
+void FileCOFF::Dump(OutputStream& stream)
 {
 	m_fileHeader.Dump(stream);
 
@@ -188,7 +1563,7 @@ void FileCOFF::Dump(std::stringstream& stream)
 	for(int i = 0; i < m_fileHeader.numSections; i++)
 	{
 		m_sectionHeaders[i].Dump(stream);
-		stream << std::endl;
+		stream << "\n";
 	}
 }
 
@@ -203,23 +1578,23 @@ void FileCOFF::FileHeader::Serialise(Stream& stream)
 	stream.Serialise(flags);
 }
 
-void FileCOFF::FileHeader::Dump(std::stringstream& stream)
+void FileCOFF::FileHeader::Dump(OutputStream& stream)
 {
-	SYSTEMTIME timeStamp;
-	UnixTimeToSystemTime(timeDate, timeStamp);
+	DateTime timeStamp;
+	UnixTimeToDateTime(timeDate, timeStamp);
 
-	stream << "-------------------------------------" << std::endl;
-	stream << "HEADER" << std::endl;
-	stream << "-------------------------------------" << std::endl;
-	stream << "COFF machine type: 0x" << std::hex << machineType << std::dec << std::endl;
-	stream << "Num sections: " << numSections << std::endl;
-	stream << "Timestamp: " << timeStamp.wHour << ":" << timeStamp.wMinute << ":" << timeStamp.wSecond << " " << timeStamp.wDay << "/" << timeStamp.wMonth << "/" << timeStamp.wYear << std::endl;
-	stream << "Symbol table offset: " << symbolTableOffset << std::endl;
-	stream << "Num symbols: " << numSymbols << std::endl;
-	stream << "Executable header size: " << exHeaderSize << std::endl;
-	stream << "Flags: 0x" << std::hex << flags << std::dec << std::endl;
+	stream << "-------------------------------------\n";
+	stream << "HEADER\n";
+	stream << "-------------------------------------\n";
+	stream << "COFF machine type: 0x" << Hex(machineType) << "\n";
+	stream << "Num sections: " << numSections << "\n";
+	stream << "Timestamp: " << timeStamp.hour << ":" << timeStamp.minute << ":" << timeStamp.second << " " << timeStamp.day << "/" << timeStamp.month << "/" << timeStamp.year << "\n";
+	stream << "Symbol table offset: " << symbolTableOffset << "\n";
+	stream << "Num symbols: " << numSymbols << "\n";
+	stream << "Executable header size: " << exHeaderSize << "\n";
+	stream << "Flags: 0x" << Hex(flags) << "\n";
 
-	stream << std::endl;
+	stream << "\n";
 }
 
 void FileCOFF::ExecutableHeader::Serialise(Stream& stream)
@@ -234,21 +1609,21 @@ void FileCOFF::ExecutableHeader::Serialise(Stream& stream)
 	stream.Serialise(dataAddr);
 }
 
-void FileCOFF::ExecutableHeader::Dump(std::stringstream& stream)
+void FileCOFF::ExecutableHeader::Dump(OutputStream& stream)
 {
-	stream << "-------------------------------------" << std::endl;
-	stream << "EXECUTABLE HEADER" << std::endl;
-	stream << "-------------------------------------" << std::endl;
-	stream << "Magic: 0x" << std::hex << exHeaderMagic << std::dec << std::endl;
-	stream << "Version: 0x" << std::hex << exHeaderVersion << std::dec << std::endl;
-	stream << "Text data size: " << textDataSize << std::endl;
-	stream << "Initialised data size: " << initialisedDataSize << std::endl;
-	stream << "Uninitialised data size: " << uninitialisedDataSize << std::endl;
-	stream << "Entry point address: 0x" << std::hex << entryPointAddr << std::dec << std::endl;
-	stream << "Text data address: 0x" << std::hex << textDataAddr << std::dec << std::endl;
-	stream << "Data address: 0x" << std::hex << dataAddr << std::dec << std::endl;
+	stream << "-------------------------------------\n";
+	stream << "EXECUTABLE HEADER\n";
+	stream << "-------------------------------------\n";
+	stream << "Magic: 0x" << Hex(exHeaderMagic) << "\n";
+	stream << "Version: 0x" << Hex(exHeaderVersion) << "\n";
+	stream << "Text data size: " << textDataSize << "\n";
+	stream << "Initialised data size: " << initialisedDataSize << "\n";
+	stream << "Uninitialised data size: " << uninitialisedDataSize << "\n";
+	stream << "Entry point address: 0x" << Hex(entryPointAddr) << "\n";
+	stream << "Text data address: 0x" << Hex(textDataAddr) << "\n";
+	stream << "Data address: 0x" << Hex(dataAddr) << "\n";
 
-	stream << std::endl;
+	stream << "\n";
 }
 
 void FileCOFF::SectionHeader::Serialise(Stream& stream)
@@ -265,7 +1640,7 @@ void FileCOFF::SectionHeader::Serialise(Stream& stream)
 	stream.Serialise(flags);
 }
 
-void FileCOFF::SectionHeader::Dump(std::stringstream& stream)
+void FileCOFF::SectionHeader::Dump(OutputStream& stream)
 {
 	std::string flagsString;
 
@@ -282,20 +1657,20 @@ void FileCOFF::SectionHeader::Dump(std::stringstream& stream)
 	if(flags & COFF_SECTION_FLAG_WRITE)
 		flagsString += " + WRITEABLE";
 
-	stream << "-------------------------------------" << std::endl;
-	stream << "SECTION HEADER: " << name.c_str() << std::endl;
-	stream << "-------------------------------------" << std::endl;
-	stream << "Physical address: 0x" << std::hex << physicalAddr << std::dec << std::endl;
-	stream << "Virtual address: 0x" << std::hex << virtualAddr << std::dec << std::endl;
-	stream << "Size: " << size << std::endl;
-	stream << "Section data offset: " << sectiondataOffset << std::endl;
-	stream << "Relocation table offset: " << relocationTableOffset << std::endl;
-	stream << "Line number table offset: " << lineNumberTableOffset << std::endl;
-	stream << "Num relocation table entries: " << numRelocationEntries << std::endl;
-	stream << "Num line number table entries: " << numLineNumberTableEntries << std::endl;
-	stream << "Flags: 0x" << std::hex << flags << std::dec << " (" << flagsString.c_str() << ")" << std::endl;
+	stream << "-------------------------------------\n";
+	stream << "SECTION HEADER: " << name.c_str() << "\n";
+	stream << "-------------------------------------\n";
+	stream << "Physical address: 0x" << Hex(physicalAddr) << "\n";
+	stream << "Virtual address: 0x" << Hex(virtualAddr) << "\n";
+	stream << "Size: " << size << "\n";
+	stream << "Section data offset: " << sectiondataOffset << "\n";
+	stream << "Relocation table offset: " << relocationTableOffset << "\n";
+	stream << "Line number table offset: " << lineNumberTableOffset << "\n";
+	stream << "Num relocation table entries: " << numRelocationEntries << "\n";
+	stream << "Num line number table entries: " << numLineNumberTableEntries << "\n";
+	stream << "Flags: 0x" << Hex(flags) << " (" << flagsString.c_str() << ")\n";
 
-	stream << std::endl;
+	stream << "\n";
 }
 
 void FileCOFF::LineNumberEntry::Serialise(Stream& stream)
@@ -304,29 +1679,176 @@ void FileCOFF::LineNumberEntry::Serialise(Stream& stream)
 	stream.Serialise(lineNumber);
 }
 
-void FileCOFF::Symbol::Serialise(Stream& stream)
+void FileCOFF::LineNumberEntry::Decode(const u8* record)
 {
-	SymbolNameStringDef symbolStringDef;
-	stream.Serialise((u8*)symbolStringDef.name, COFF_SECTION_NAME_SIZE);
+	physicalAddress = ReadU32LE(record);
+	lineNumber = (s16)ReadU16LE(record + 4);
+}
 
-	//NULL terminate string
-	symbolStringDef.name[COFF_SECTION_NAME_SIZE] = 0;
+void FileCOFF::Symbol::Decode(const u8* record)
+{
+	//Name fits inline unless first 4 bytes are zero, then it's a string table offset
+	name = 0;
 
-	if(symbolStringDef.freeStringSpace == 0)
+	if(ReadU32LE(record) == 0)
 	{
-		//Name doesn't fit, get string table offset
-		stringTableOffset = symbolStringDef.stringTableOffset;
+		stringTableOffset = ReadU32LE(record + 4);
 	}
 	else
 	{
-		//Name fits here
-		name = symbolStringDef.name;
 		stringTableOffset = (u32)-1;
 	}
 
-	stream.Serialise(value);
-	stream.Serialise(sectionIndex);
-	stream.Serialise(symbolType);
-	stream.Serialise(storageClass);
-	stream.Serialise(auxCount);
+	value = ReadU32LE(record + 8);
+	sectionIndex = (s16)ReadU16LE(record + 12);
+	symbolType = ReadU16LE(record + 14);
+	storageClass = (s8)record[16];
+	auxCount = record[17];
+	size = 0;
+	padding = 0;
+}
+
+void FileCOFF::Relocation::Decode(const u8* record)
+{
+	offset = ReadU32LE(record);
+	symbolIndex = ReadU32LE(record + 4);
+	type = ReadU16LE(record + 8);
+	padding = 0;
+}
+
+u32 FileCOFF::GetRelocationSize(u16 type)
+{
+	switch(type)
+	{
+	case COFF_RELOCATION_ABSOLUTE_BYTE:
+	case COFF_RELOCATION_RELATIVE_BYTE:
+		return 1;
+	case COFF_RELOCATION_ABSOLUTE_WORD:
+	case COFF_RELOCATION_RELATIVE_WORD:
+		return 2;
+	default:
+		return 4;
+	}
+}
+
+void FileCOFF::LineTable::Add(u32 address, s16 lineNumber, u32 fileIndex, u32 limitAddress)
+{
+	m_addresses.push_back(address);
+	m_endAddresses.push_back(limitAddress);
+	m_lineNumbers.push_back(lineNumber);
+	m_fileIndices.push_back(fileIndex);
+}
+
+void FileCOFF::LineTable::Sort()
+{
+	u32 count = (u32)m_addresses.size();
+
+	//Sort by address, ties kept in table order so the last entry for an address wins
+	std::vector<u64> keys(count);
+	for(u32 i = 0; i < count; i++)
+	{
+		keys[i] = ((u64)m_addresses[i] << 32) | i;
+	}
+
+	RadixSortKeys(keys, 32);
+
+	std::vector<u32> sortedAddresses(count);
+	std::vector<u32> sortedEndAddresses(count);
+	std::vector<s16> sortedLineNumbers(count);
+	std::vector<u32> sortedFileIndices(count);
+
+	for(u32 i = 0; i < count; i++)
+	{
+		u32 index = (u32)keys[i];
+		sortedAddresses[i] = m_addresses[index];
+		sortedEndAddresses[i] = m_endAddresses[index];
+		sortedLineNumbers[i] = m_lineNumbers[index];
+		sortedFileIndices[i] = m_fileIndices[index];
+	}
+
+	//Each line covers up to the next entry, or the end of its section
+	for(u32 i = 0; i + 1 < count; i++)
+	{
+		if(sortedAddresses[i + 1] < sortedEndAddresses[i])
+		{
+			sortedEndAddresses[i] = sortedAddresses[i + 1];
+		}
+	}
+
+	m_addresses.swap(sortedAddresses);
+	m_endAddresses.swap(sortedEndAddresses);
+	m_lineNumbers.swap(sortedLineNumbers);
+	m_fileIndices.swap(sortedFileIndices);
+	Bind();
+}
+
+void FileCOFF::LineTable::SetView(const u32* addressData, const u32* endAddressData, const s16* lineNumberData, const u32* fileIndexData, u32 count)
+{
+	addresses = ArrayView<u32>(addressData, count);
+	endAddresses = ArrayView<u32>(endAddressData, count);
+	lineNumbers = ArrayView<s16>(lineNumberData, count);
+	fileIndices = ArrayView<u32>(fileIndexData, count);
+}
+
+void FileCOFF::LineTable::RemoveEmpty()
+{
+	Own();
+
+	//E.g. all but the last of several lines at one address
+	u32 count = 0;
+	for(u32 i = 0; i < m_addresses.size(); i++)
+	{
+		if(m_endAddresses[i] > m_addresses[i])
+		{
+			m_addresses[count] = m_addresses[i];
+			m_endAddresses[count] = m_endAddresses[i];
+			m_lineNumbers[count] = m_lineNumbers[i];
+			m_fileIndices[count] = m_fileIndices[i];
+			count++;
+		}
+	}
+
+	m_addresses.resize(count);
+	m_endAddresses.resize(count);
+	m_lineNumbers.resize(count);
+	m_fileIndices.resize(count);
+	Bind();
+}
+
+void FileCOFF::LineTable::Own()
+{
+	if(addresses.data() != m_addresses.data())
+	{
+		m_addresses.assign(addresses.begin(), addresses.end());
+		m_endAddresses.assign(endAddresses.begin(), endAddresses.end());
+		m_lineNumbers.assign(lineNumbers.begin(), lineNumbers.end());
+		m_fileIndices.assign(fileIndices.begin(), fileIndices.end());
+		Bind();
+	}
+}
+
+void FileCOFF::LineTable::Bind()
+{
+	addresses = ArrayView<u32>(m_addresses);
+	endAddresses = ArrayView<u32>(m_endAddresses);
+	lineNumbers = ArrayView<s16>(m_lineNumbers);
+	fileIndices = ArrayView<u32>(m_fileIndices);
+}
+
+int FileCOFF::LineTable::Find(u32 address) const
+{
+	//Find first entry after address, covering entry is the one before it
+	const u32* it = std::upper_bound(addresses.begin(), addresses.end(), address);
+	if(it == addresses.begin())
+	{
+		return -1;
+	}
+
+	int index = (int)(it - addresses.begin()) - 1;
+	if(address >= endAddresses[index])
+	{
+		return -1;
+	}
+
+	return index;
 }
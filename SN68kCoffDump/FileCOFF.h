@@ -8,22 +8,82 @@
 
 #pragma once
 
-#include <sstream>
 #include <vector>
-#include <map>
+#include <mutex>
 
 #include "atoms.h"
 #include "archive.h"
+#include "ArrayView.h"
+#include "OutputStream.h"
+#include "MappedFile.h"
+#include "IndexCache.h"
+#include "StringPool.h"
 
 #define COFF_MACHINE_68000		0x150
 #define COFF_SECTION_NAME_SIZE	8
 
+//On-disk record sizes
+#define COFF_FILE_HEADER_SIZE		20
+#define COFF_SECTION_HEADER_SIZE	40
+#define COFF_SYMBOL_SIZE			18
+#define COFF_LINE_NUMBER_SIZE		6
+#define COFF_RELOCATION_SIZE		10
+
 //SNASM2 hard coded section idxs
 #define COFF_SECTION_FILENAMES	0
 #define COFF_SECTION_DBG_DATA	1
 #define COFF_SECTION_ROM_DATA	2
 #define COFF_SECTION_COUNT		3
 
+//Symbol storage classes
+#define COFF_STORAGE_CLASS_END_OF_FUNCTION	-1
+#define COFF_STORAGE_CLASS_NULL				0
+#define COFF_STORAGE_CLASS_AUTOMATIC		1
+#define COFF_STORAGE_CLASS_EXTERNAL			2
+#define COFF_STORAGE_CLASS_STATIC			3
+#define COFF_STORAGE_CLASS_REGISTER			4
+#define COFF_STORAGE_CLASS_EXTERNAL_DEF		5
+#define COFF_STORAGE_CLASS_LABEL			6
+#define COFF_STORAGE_CLASS_UNDEFINED_LABEL	7
+#define COFF_STORAGE_CLASS_STRUCT_MEMBER	8
+#define COFF_STORAGE_CLASS_ARGUMENT			9
+#define COFF_STORAGE_CLASS_STRUCT_TAG		10
+#define COFF_STORAGE_CLASS_UNION_MEMBER		11
+#define COFF_STORAGE_CLASS_UNION_TAG		12
+#define COFF_STORAGE_CLASS_TYPEDEF			13
+#define COFF_STORAGE_CLASS_UNDEFINED_STATIC	14
+#define COFF_STORAGE_CLASS_ENUM_TAG			15
+#define COFF_STORAGE_CLASS_ENUM_MEMBER		16
+#define COFF_STORAGE_CLASS_REGISTER_PARAM	17
+#define COFF_STORAGE_CLASS_BIT_FIELD		18
+#define COFF_STORAGE_CLASS_BLOCK			100
+#define COFF_STORAGE_CLASS_FUNCTION			101
+#define COFF_STORAGE_CLASS_END_OF_STRUCT	102
+#define COFF_STORAGE_CLASS_FILE				103
+#define COFF_STORAGE_CLASS_LINE				104
+#define COFF_STORAGE_CLASS_ALIAS			105
+#define COFF_STORAGE_CLASS_HIDDEN			106
+
+//Symbol types, base type in the low 4 bits then 2 bits per derivation, outermost first
+#define COFF_SYMBOL_TYPE_BASE_MASK		0x000F
+#define COFF_SYMBOL_TYPE_DERIVED_SHIFT	4
+#define COFF_SYMBOL_TYPE_MAX_DERIVED	6
+#define COFF_DERIVED_TYPE_NONE			0
+#define COFF_DERIVED_TYPE_POINTER		1
+#define COFF_DERIVED_TYPE_FUNCTION		2
+#define COFF_DERIVED_TYPE_ARRAY			3
+
+//Relocation types, the field to patch is big endian
+#define COFF_RELOCATION_ABSOLUTE_BYTE	0x0F
+#define COFF_RELOCATION_ABSOLUTE_WORD	0x10
+#define COFF_RELOCATION_ABSOLUTE_LONG	0x11
+#define COFF_RELOCATION_RELATIVE_BYTE	0x12
+#define COFF_RELOCATION_RELATIVE_WORD	0x13
+#define COFF_RELOCATION_RELATIVE_LONG	0x14
+
+//Symbol indices share a 64-bit sort key with the address and tie rank
+#define COFF_MAX_SYMBOLS	0x0FFFFFFF
+
 //Section header flags
 #define COFF_SECTION_FLAG_DUMMY	0x00000001
 #define COFF_SECTION_FLAG_GROUP	0x00000004
@@ -38,13 +98,114 @@ public:
 	FileCOFF();
 	~FileCOFF();
 
+	//Maps file and serialises headers, with section data as views into the mapping.
+	//Symbol, line and relocation tables are decoded on first use, with names interned in string pools.
+	//With the index cache, symbol and line tables come from a matching index file, which is (re)built if missing or stale.
+	bool Load(const std::string& filename, bool useIndexCache = false);
+
+	//Decode tables now rather than on first use, returns false if the file is invalid
+	bool LoadSymbolTable();
+	bool LoadLineTable();
+	bool LoadRelocations();
+
+	//Decodes all tables, lays the file out and writes it, replacing filename once complete
+	bool Save(const std::string& filename, u64& size);
+
+	//Assigns file offsets, table counts and string table offsets for writing, and returns the file size,
+	//or 0 if the tables can't be decoded or don't fit. Layout is headers, section data, line tables,
+	//relocations, then the symbol and string tables. Line records are written in address order into the
+	//loaded section holding each address, with a filename record wherever the file changes.
+	u64 Layout();
+
+	//Shrinks the decoded tables for writing. Keeps relocation targets and externals, statics and labels
+	//with an address, drops all other symbols and all aux records but function sizes, and orders the
+	//symbol table by address so loading it needs no sort. Line records covering no bytes are dropped,
+	//and identical long names share one string table entry, with names of 8 characters or fewer inline.
+	bool Compact();
+
+	//Reads from an input stream, or writes to a zeroed output stream of the size Layout() returned
 	void Serialise(Stream& stream);
-	void Dump(std::stringstream& stream);
+	void Dump(OutputStream& stream);
+
+	//Filename passed to Load, empty if serialised from a stream
+	const std::string& GetFilename() const { return m_filename; }
+
+#if !defined(_WIN32)
+	//Descriptor of the file passed to Load, -1 if serialised from a stream
+	int GetFileDescriptor() const { return m_mappedFile.GetFileDescriptor(); }
+#endif
+
+	//Reason the last Load/Serialise failed, empty if valid
+	const std::string& GetError() const { return m_error; }
+
+	struct LineInfo;
+	struct LoadStats;
+	struct Symbol;
+	struct LineTable;
+	struct Relocation;
+	struct SymbolAux;
+	struct SectionAux;
+
+	//Time spent in each load phase so far, phases are timed whether or not anyone asks
+	const LoadStats& GetLoadStats() const { return m_loadStats; }
+
+	//Address lookups, return false/NULL if not found
+	bool FindLine(u32 address, LineInfo& lineInfo) const;
+	const Symbol* FindNearestSymbol(u32 address) const;
+
+	//Function symbol whose aux record size covers address, or NULL
+	const Symbol* FindFunction(u32 address) const;
+
+	//Name lookup, requires BuildSymbolNameIndex() after loading. First symbol in table order wins.
+	void BuildSymbolNameIndex();
+	const Symbol* FindSymbol(const char* name) const;
+
+	//FNV-1a hash of a symbol name, as used by the name index
+	static u32 HashSymbolName(const char* name);
+
+	//Name of 1-based symbol section index, or special section name
+	const char* GetSectionName(s16 sectionIndex) const;
+
+	//Tables, decoded on first access. Empty if decoding failed, see GetError().
+	const ArrayView<Symbol>& GetSymbols() const;
+	const LineTable& GetLineTable() const;
+
+	//Symbol indices in address order. Symbols at the same address are ordered globals, statics,
+	//labels then others, and by table order within those.
+	const ArrayView<u32>& GetSortedSymbolIndices() const;
+
+	//Relocations of all sections in header order, see SectionHeader::firstRelocation.
+	//Relocation symbol indices are remapped to GetSymbols() indices.
+	const std::vector<Relocation>& GetRelocations() const;
+
+	//Width in bytes of the field a relocation type patches
+	static u32 GetRelocationSize(u16 type);
+
+	//Aux records of a symbol by index, NULL with count 0 if it has none
+	const SymbolAux* GetSymbolAux(u32 symbolIndex, u32& count) const;
+
+	//Source filename of a .file symbol, from its aux records, empty if not a .file symbol
+	std::string GetSymbolFilename(u32 symbolIndex) const;
+
+	//True for the static symbol naming its own section, e.g. .text
+	bool IsSectionSymbol(const Symbol& symbol) const;
+
+	//Length and counts of a section symbol, from its aux record, returns false if not a section symbol
+	bool GetSectionAux(u32 symbolIndex, SectionAux& sectionAux) const;
+
+	//Readable storage class, e.g. "external", and type, e.g. "function returning int"
+	static const char* GetStorageClassName(s8 storageClass);
+	static std::string GetSymbolTypeName(u16 symbolType);
+
+	//Names by handle or index, valid once their table is decoded
+	const char* GetSymbolName(const Symbol& symbol) const { return m_symbolNames.Get(symbol.name); }
+	const char* GetLineFilename(u32 fileIndex) const { return m_filenames.Get(m_filenameTable[fileIndex]); }
+	u32 GetNumLineFilenames() const;
 
 	struct FileHeader
 	{
 		void Serialise(Stream& stream);
-		void Dump(std::stringstream& stream);
+		void Dump(OutputStream& stream);
 
 		u16 machineType;
 		u16 numSections;
@@ -58,7 +219,7 @@ public:
 	struct ExecutableHeader
 	{
 		void Serialise(Stream& stream);
-		void Dump(std::stringstream& stream);
+		void Dump(OutputStream& stream);
 
 		u16 exHeaderMagic;
 		u16 exHeaderVersion;
@@ -75,10 +236,11 @@ public:
 		SectionHeader()
 		{
 			data = NULL;
+			firstRelocation = 0;
 		}
 
 		void Serialise(Stream& stream);
-		void Dump(std::stringstream& stream);
+		void Dump(OutputStream& stream);
 
 		std::string name;
 		u32 physicalAddr;
@@ -91,21 +253,49 @@ public:
 		u16 numLineNumberTableEntries;
 		u32 flags;
 
-		u8* data;
+		const u8* data;
+
+		//Index of this section's first entry in the relocation table, valid once decoded
+		u32 firstRelocation;
 	};
 
+	//Plain data, the name is a handle into the file's symbol name pool, see GetSymbolName().
+	//Aux records aren't symbols, they're kept apart and attached by index, see GetSymbolAux().
 	struct Symbol
 	{
-		void Serialise(Stream& stream);
-		bool operator < (const Symbol& rhs) const { return value < rhs.value; }
+		//Decodes all but the name
+		void Decode(const u8* record);
 
-		std::string name;
+		bool IsFunction() const { return ((symbolType >> COFF_SYMBOL_TYPE_DERIVED_SHIFT) & 3) == COFF_DERIVED_TYPE_FUNCTION; }
+
+		u32 name;
 		u32 stringTableOffset;
 		u32 value;
+
+		//Function or section size from its aux record, 0 if unknown
+		u32 size;
+
 		s16 sectionIndex;
 		u16 symbolType;
 		s8 storageClass;
-		s8 auxCount;
+		u8 auxCount;
+		u16 padding;
+	};
+
+	//Raw auxiliary record, kept whole so it can be written back
+	struct SymbolAux
+	{
+		u32 symbolIndex;
+		u8 record[COFF_SYMBOL_SIZE];
+		u16 padding;
+	};
+
+	//Decoded section symbol aux record
+	struct SectionAux
+	{
+		u32 length;
+		u16 numRelocations;
+		u16 numLines;
 	};
 
 	union SymbolNameStringDef
@@ -125,11 +315,10 @@ public:
 		{
 			physicalAddress = 0;
 			sectionMarker = 0;
-			lineNumberSectionIdx = 0;
-			filename = NULL;
 		}
 
 		void Serialise(Stream& stream);
+		void Decode(const u8* record);
 
 		union
 		{
@@ -142,18 +331,163 @@ public:
 			s16 sectionMarker;
 			s16 lineNumber;
 		};
+	};
+
+	//Plain data, the field to patch is at offset bytes into the section
+	struct Relocation
+	{
+		void Decode(const u8* record);
 
-		u32 lineNumberSectionIdx;
-		std::string* filename;
+		u32 offset;
+		u32 symbolIndex;
+		u16 type;
+		u16 padding;
+	};
+
+	//Result of a line table lookup
+	struct LineInfo
+	{
+		u32 address;
+		u32 endAddress;
+		s16 lineNumber;
+		const char* filename;
+	};
+
+	//Wall time of each load phase in nanoseconds, 0 if it hasn't run. Phases that run again add up.
+	struct LoadStats
+	{
+		u64 mapNs;				//Mapping, headers and section views
+		u64 symbolRecordsNs;	//Symbol and aux records, short names
+		u64 symbolNamesNs;		//Long names from the string table, sizes from aux records
+		u64 symbolSortNs;		//Address order and function index
+		u64 filenamesNs;		//Filename table from the .file section
+		u64 lineRecordsNs;		//Line records of all sections
+		u64 lineSortNs;			//Address order and end addresses
+		u64 relocationsNs;		//Relocation records, symbol indices remapped
+		u64 indexCacheReadNs;	//Symbol and line tables from the index file
+		u64 indexCacheWriteNs;	//Index file rebuild
+		u64 nameIndexNs;		//Symbol name hash
+	};
+
+	//Flat line number index, sorted by address, one array per field
+	struct LineTable
+	{
+		//Appends unsorted entries, Sort() makes them visible
+		void Add(u32 address, s16 lineNumber, u32 fileIndex, u32 limitAddress);
+		void Sort();
+
+		//Uses sorted arrays held elsewhere in place, e.g. in a mapped index
+		void SetView(const u32* addressData, const u32* endAddressData, const s16* lineNumberData, const u32* fileIndexData, u32 count);
+
+		//Drops entries covering no bytes, they're never found
+		void RemoveEmpty();
+
+		//Copies viewed arrays into the storage, so they can be changed
+		void Own();
+
+		//Returns index of entry covering address, or -1
+		int Find(u32 address) const;
+		u32 GetCount() const { return (u32)addresses.size(); }
+
+		ArrayView<u32> addresses;
+		ArrayView<u32> endAddresses;
+		ArrayView<s16> lineNumbers;
+		ArrayView<u32> fileIndices;
+
+	private:
+		//Views the storage
+		void Bind();
+
+		std::vector<u32> m_addresses;
+		std::vector<u32> m_endAddresses;
+		std::vector<s16> m_lineNumbers;
+		std::vector<u32> m_fileIndices;
 	};
 
 	FileHeader m_fileHeader;
 	ExecutableHeader m_executableHeader;
 	std::vector<SectionHeader> m_sectionHeaders;
+
+	//Filled by Serialise, or on first access after Load, use the getters above. Symbol tables view
+	//the storage below when decoded, or the arrays of a mapped index cache.
 	std::vector<LineNumberEntry> m_lineNumberSectionHeaders;
-	std::map<u32, LineNumberEntry> m_lineNumberAddressMap;
-	std::vector<Symbol> m_symbols;
-	std::vector<Symbol> m_sortedSymbols;
-	std::vector<std::string> m_filenameTable;
-	u8* m_stringTableRaw;
+	LineTable m_lineTable;
+	ArrayView<Symbol> m_symbols;
+	ArrayView<u32> m_sortedSymbolIndices;
+	ArrayView<u32> m_sortedSymbolValues;
+	std::vector<Relocation> m_relocations;
+	ArrayView<SymbolAux> m_symbolAux;
+	std::vector<u32> m_sortedFunctionIndices;
+	std::vector<u32> m_filenameTable;
+	StringPool m_symbolNames;
+	StringPool m_filenames;
+	const u8* m_stringTableRaw;
+
+private:
+	//Serialise phases, in file order
+	bool SerialiseHeaders(Stream& stream);
+	bool SerialiseSymbols(Stream& stream);
+	void SerialiseSymbol(Stream& stream, Symbol& symbol);
+	void SerialiseSectionData(Stream& stream);
+	void SerialiseRelocations(Stream& stream);
+	void SerialiseLineNumbers(Stream& stream);
+
+	bool ValidateLayout(const Stream& stream);
+	bool ReadStringTable(Stream& stream);
+	void DecodeSymbols(const u8* data);
+	void DecodeLineNumbers(int sectionIdx, const u8* data);
+	bool DecodeRelocations(int sectionIdx, const u8* data);
+	void BuildFilenameTable();
+	void AttachSymbolAux();
+	void SortSymbols();
+	void BuildFunctionIndex();
+	bool MapRelocationSymbols();
+
+	//Points the symbol table views at the storage, after it's filled or changed
+	void BindSymbolTables();
+
+	//Copies tables used in place from an index into the storage, before changing them
+	void OwnTables();
+
+	//Layout helpers for writing
+	void LayoutStringTable();
+	u32 AddLayoutString(const char* string, std::vector<u32>& buckets);
+	int GetLineSectionIdx(u32 address) const;
+
+	//Deferred table decoding from the mapping, each runs once
+	void DecodeSymbolTable();
+	void DecodeLineTable();
+	void DecodeRelocationTable();
+	void DecodeIndexedTables();
+
+	//Non-copyable, section data may point into the mapping
+	FileCOFF(const FileCOFF&);
+	FileCOFF& operator = (const FileCOFF&);
+
+
+	//Decoded symbol tables, empty when used from an index
+	std::vector<Symbol> m_symbolStorage;
+	std::vector<u32> m_sortedSymbolIndexStorage;
+	std::vector<u32> m_sortedSymbolValueStorage;
+	std::vector<SymbolAux> m_symbolAuxStorage;
+
+	//Open addressed hash of symbol index + 1, 0 is empty
+	std::vector<u32> m_symbolNameBuckets;
+
+	//String table written by Serialise, built by Layout()
+	std::vector<char> m_layoutStringTable;
+	bool m_compactStrings;
+
+	std::string m_filename;
+	MappedFile m_mappedFile;
+	IndexCache m_indexCache;
+	bool m_zeroCopy;
+	bool m_deferTables;
+	bool m_useIndexCache;
+	std::once_flag m_symbolTableDecoded;
+	std::once_flag m_lineTableDecoded;
+	std::once_flag m_relocationsDecoded;
+	std::once_flag m_indexedTablesDecoded;
+	LoadStats m_loadStats;
+	std::string m_error;
 };
\ No newline at end of file
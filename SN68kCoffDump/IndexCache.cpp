@@ -0,0 +1,283 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "IndexCache.h"
+#include "FileCOFF.h"
+
+//Symbol and aux records are stored as they are in memory
+static_assert(sizeof(FileCOFF::Symbol) == 24, "Index cache symbol record layout changed, bump INDEX_CACHE_VERSION");
+static_assert(sizeof(FileCOFF::SymbolAux) == 24, "Index cache aux record layout changed, bump INDEX_CACHE_VERSION");
+
+static u64 AlignOffset(u64 offset)
+{
+	return (offset + 7) & ~(u64)7;
+}
+
+static void WritePadding(std::ofstream& file, u64& offset)
+{
+	static const char zeroes[8] = { 0 };
+	u64 aligned = AlignOffset(offset);
+	file.write(zeroes, (std::streamsize)(aligned - offset));
+	offset = aligned;
+}
+
+template <typename T> static void WriteArray(std::ofstream& file, u64& offset, const T* data, u64 count)
+{
+	if(count > 0)
+	{
+		file.write((const char*)data, (std::streamsize)(count * sizeof(T)));
+	}
+
+	offset += count * sizeof(T);
+	WritePadding(file, offset);
+}
+
+u64 IndexCache::Hash(const u8* data, u64 size)
+{
+	//64-bit multiply/rotate hash, a word at a time
+	const u64 prime = 0x100000001B3ULL;
+	u64 hash = 0xCBF29CE484222325ULL ^ size;
+
+	u64 numWords = size / sizeof(u64);
+	for(u64 i = 0; i < numWords; i++)
+	{
+		u64 word;
+		memcpy(&word, data + (i * sizeof(u64)), sizeof(u64));
+		hash = (hash ^ word) * prime;
+		hash ^= hash >> 29;
+	}
+
+	for(u64 i = numWords * sizeof(u64); i < size; i++)
+	{
+		hash = (hash ^ data[i]) * prime;
+	}
+
+	return hash;
+}
+
+std::string IndexCache::GetFilename(const std::string& coffFilename)
+{
+	return coffFilename + ".idx";
+}
+
+bool IndexCache::Read(const std::string& filename, u64 coffHash, u64 coffSize, FileCOFF& coffFile)
+{
+	if(!m_mappedFile.Open(filename))
+	{
+		return false;
+	}
+
+	const u8* data = m_mappedFile.GetData();
+	u64 size = m_mappedFile.GetSize();
+
+	if(size < sizeof(Header))
+	{
+		m_mappedFile.Close();
+		return false;
+	}
+
+	Header header;
+	memcpy(&header, data, sizeof(Header));
+
+	//Stale or foreign index
+	if(header.magic != INDEX_CACHE_MAGIC || header.version != INDEX_CACHE_VERSION || header.endian != INDEX_CACHE_ENDIAN
+		|| header.coffHash != coffHash || header.coffSize != coffSize || header.numSymbols > coffFile.m_fileHeader.numSymbols
+		|| header.numSymbolAux > coffFile.m_fileHeader.numSymbols)
+	{
+		m_mappedFile.Close();
+		return false;
+	}
+
+	//Validate all array ranges
+	struct Range { u64 offset; u64 length; };
+	Range ranges[] =
+	{
+		{ header.symbolsOffset, (u64)header.numSymbols * sizeof(FileCOFF::Symbol) },
+		{ header.sortedSymbolIndicesOffset, (u64)header.numSymbols * sizeof(u32) },
+		{ header.sortedSymbolValuesOffset, (u64)header.numSymbols * sizeof(u32) },
+		{ header.symbolAuxOffset, (u64)header.numSymbolAux * sizeof(FileCOFF::SymbolAux) },
+		{ header.lineAddressesOffset, (u64)header.numLines * sizeof(u32) },
+		{ header.lineEndAddressesOffset, (u64)header.numLines * sizeof(u32) },
+		{ header.lineNumbersOffset, (u64)header.numLines * sizeof(s16) },
+		{ header.lineFileIndicesOffset, (u64)header.numLines * sizeof(u32) },
+		{ header.namesOffset, header.namesSize },
+	};
+
+	for(int i = 0; i < sizeof(ranges) / sizeof(Range); i++)
+	{
+		if(ranges[i].offset > size || ranges[i].length > (size - ranges[i].offset) || (ranges[i].offset & 7))
+		{
+			m_mappedFile.Close();
+			return false;
+		}
+	}
+
+	//Pool starts with the empty string at handle 0, and every name is terminated
+	const char* names = (const char*)data + header.namesOffset;
+	if(header.namesSize == 0 || names[0] != 0 || names[header.namesSize - 1] != 0)
+	{
+		m_mappedFile.Close();
+		return false;
+	}
+
+	//Check handles against the blocks they're for, long names are in the COFF's string table, already attached
+	StringPool namePool;
+	namePool.SetView(names, header.namesSize);
+	namePool.SetExternal(coffFile.m_symbolNames.GetExternalData(), coffFile.m_symbolNames.GetExternalSize());
+
+	const FileCOFF::Symbol* symbols = (const FileCOFF::Symbol*)(data + header.symbolsOffset);
+	const u32* sortedIndices = (const u32*)(data + header.sortedSymbolIndicesOffset);
+	const u32* sortedValues = (const u32*)(data + header.sortedSymbolValuesOffset);
+	const FileCOFF::SymbolAux* symbolAux = (const FileCOFF::SymbolAux*)(data + header.symbolAuxOffset);
+	const u32* lineFileIndices = (const u32*)(data + header.lineFileIndicesOffset);
+
+	for(u32 i = 0; i < header.numSymbols; i++)
+	{
+		if(!namePool.IsValid(symbols[i].name))
+		{
+			m_mappedFile.Close();
+			return false;
+		}
+	}
+
+	//Aux records are looked up by symbol, so must be in symbol order
+	for(u32 i = 0; i < header.numSymbolAux; i++)
+	{
+		if(symbolAux[i].symbolIndex >= header.numSymbols || (i > 0 && symbolAux[i].symbolIndex < symbolAux[i - 1].symbolIndex))
+		{
+			m_mappedFile.Close();
+			return false;
+		}
+	}
+
+	//Sorted order must index the table, and its values be in order for binary searches
+	for(u32 i = 0; i < header.numSymbols; i++)
+	{
+		if(sortedIndices[i] >= header.numSymbols || (i > 0 && sortedValues[i] < sortedValues[i - 1]))
+		{
+			m_mappedFile.Close();
+			return false;
+		}
+	}
+
+	for(u32 i = 0; i < header.numLines; i++)
+	{
+		if(lineFileIndices[i] >= coffFile.m_filenameTable.size())
+		{
+			m_mappedFile.Close();
+			return false;
+		}
+	}
+
+	//Tables and short names are used in place, the mapping lives as long as the file
+	coffFile.m_symbols = ArrayView<FileCOFF::Symbol>(symbols, header.numSymbols);
+	coffFile.m_sortedSymbolIndices = ArrayView<u32>(sortedIndices, header.numSymbols);
+	coffFile.m_sortedSymbolValues = ArrayView<u32>(sortedValues, header.numSymbols);
+	coffFile.m_symbolAux = ArrayView<FileCOFF::SymbolAux>(symbolAux, header.numSymbolAux);
+	coffFile.m_symbolNames.SetView(names, header.namesSize);
+
+	const u32* lineAddresses = (const u32*)(data + header.lineAddressesOffset);
+	const u32* lineEndAddresses = (const u32*)(data + header.lineEndAddressesOffset);
+	const s16* lineNumbers = (const s16*)(data + header.lineNumbersOffset);
+	coffFile.m_lineTable.SetView(lineAddresses, lineEndAddresses, lineNumbers, lineFileIndices, header.numLines);
+
+	return true;
+}
+
+bool IndexCache::Write(const std::string& filename, u64 coffHash, u64 coffSize, const FileCOFF& coffFile)
+{
+	//Symbol records and the interned short names are saved as they are, long names stay in the COFF
+	const ArrayView<FileCOFF::Symbol>& symbols = coffFile.m_symbols;
+	const ArrayView<u32>& sortedIndices = coffFile.m_sortedSymbolIndices;
+	const ArrayView<u32>& sortedValues = coffFile.m_sortedSymbolValues;
+	const ArrayView<FileCOFF::SymbolAux>& symbolAux = coffFile.m_symbolAux;
+	const StringPool& names = coffFile.m_symbolNames;
+
+	const FileCOFF::LineTable& lineTable = coffFile.m_lineTable;
+	u32 numLines = lineTable.GetCount();
+
+	//Lay out arrays
+	Header header;
+	memset(&header, 0, sizeof(Header));
+	header.magic = INDEX_CACHE_MAGIC;
+	header.version = INDEX_CACHE_VERSION;
+	header.endian = INDEX_CACHE_ENDIAN;
+	header.numSymbols = (u32)symbols.size();
+	header.coffHash = coffHash;
+	header.coffSize = coffSize;
+	header.numLines = numLines;
+	header.namesSize = names.GetSize();
+
+	u64 offset = AlignOffset(sizeof(Header));
+	header.symbolsOffset = offset;
+	offset = AlignOffset(offset + symbols.size() * sizeof(FileCOFF::Symbol));
+	header.sortedSymbolIndicesOffset = offset;
+	offset = AlignOffset(offset + sortedIndices.size() * sizeof(u32));
+	header.sortedSymbolValuesOffset = offset;
+	offset = AlignOffset(offset + sortedValues.size() * sizeof(u32));
+	header.symbolAuxOffset = offset;
+	header.numSymbolAux = (u32)symbolAux.size();
+	offset = AlignOffset(offset + symbolAux.size() * sizeof(FileCOFF::SymbolAux));
+	header.lineAddressesOffset = offset;
+	offset = AlignOffset(offset + (u64)numLines * sizeof(u32));
+	header.lineEndAddressesOffset = offset;
+	offset = AlignOffset(offset + (u64)numLines * sizeof(u32));
+	header.lineNumbersOffset = offset;
+	offset = AlignOffset(offset + (u64)numLines * sizeof(s16));
+	header.lineFileIndicesOffset = offset;
+	offset = AlignOffset(offset + (u64)numLines * sizeof(u32));
+	header.namesOffset = offset;
+
+	//Unique temp name, other processes may be building the same index
+	std::random_device random;
+	std::string tempFilename = filename + ".tmp" + std::to_string((u64)random());
+	std::ofstream file(tempFilename, std::ios::out | std::ios::binary | std::ios::trunc);
+	if(!file.is_open())
+	{
+		return false;
+	}
+
+	offset = 0;
+	WriteArray(file, offset, &header, 1);
+	WriteArray(file, offset, symbols.data(), symbols.size());
+	WriteArray(file, offset, sortedIndices.data(), sortedIndices.size());
+	WriteArray(file, offset, sortedValues.data(), sortedValues.size());
+	WriteArray(file, offset, symbolAux.data(), symbolAux.size());
+	WriteArray(file, offset, lineTable.addresses.data(), numLines);
+	WriteArray(file, offset, lineTable.endAddresses.data(), numLines);
+	WriteArray(file, offset, lineTable.lineNumbers.data(), numLines);
+	WriteArray(file, offset, lineTable.fileIndices.data(), numLines);
+	WriteArray(file, offset, names.GetData(), names.GetSize());
+
+	file.close();
+
+	if(file.fail())
+	{
+		remove(tempFilename.c_str());
+		return false;
+	}
+
+#if defined(_WIN32)
+	//Windows rename won't replace an existing file
+	remove(filename.c_str());
+#endif
+
+	if(rename(tempFilename.c_str(), filename.c_str()) != 0)
+	{
+		remove(tempFilename.c_str());
+		return false;
+	}
+
+	return true;
+}
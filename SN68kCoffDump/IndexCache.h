@@ -0,0 +1,65 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#pragma once
+
+#include <string>
+
+#include "atoms.h"
+#include "MappedFile.h"
+
+class FileCOFF;
+
+#define INDEX_CACHE_MAGIC		0x58494E53	//'SNIX'
+#define INDEX_CACHE_VERSION		5
+#define INDEX_CACHE_ENDIAN		0x01020304
+
+//Persistent symbol/line index, saved next to the COFF and keyed by a hash of its contents.
+//Stored in host byte order, arrays are 8 byte aligned so they're used straight from the mapping.
+class IndexCache
+{
+public:
+	static u64 Hash(const u8* data, u64 size);
+	static std::string GetFilename(const std::string& coffFilename);
+
+	//Points the symbol and line tables at the index if it matches the hash, nothing is copied. Symbols and their
+	//aux records are stored as FileCOFF::Symbol and FileCOFF::SymbolAux records with their address order, and short
+	//names as the symbol name pool's arena. Long names are left in the COFF's string table, which must be attached
+	//to the file's pool first. Reading still makes one pass over each array, checking every index and name handle
+	//is in range, so it's linear in the table sizes but without decoding, sorting or allocating.
+	bool Read(const std::string& filename, u64 coffHash, u64 coffSize, FileCOFF& coffFile);
+
+	//Writes to a temp file then renames, so concurrent readers never see a partial index
+	static bool Write(const std::string& filename, u64 coffHash, u64 coffSize, const FileCOFF& coffFile);
+
+	struct Header
+	{
+		u32 magic;
+		u32 version;
+		u32 endian;
+		u32 numSymbols;
+		u64 coffHash;
+		u64 coffSize;
+		u32 numLines;
+		u32 namesSize;
+		u64 symbolsOffset;
+		u64 sortedSymbolIndicesOffset;
+		u64 sortedSymbolValuesOffset;
+		u64 lineAddressesOffset;
+		u64 lineEndAddressesOffset;
+		u64 lineNumbersOffset;
+		u64 lineFileIndicesOffset;
+		u64 namesOffset;
+		u32 numSymbolAux;
+		u32 padding;
+		u64 symbolAuxOffset;
+	};
+
+private:
+	MappedFile m_mappedFile;
+};
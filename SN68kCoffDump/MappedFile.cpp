@@ -0,0 +1,133 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+	m_data = NULL;
+	m_size = 0;
+
+#if defined(_WIN32)
+	m_fileHandle = INVALID_HANDLE_VALUE;
+	m_mappingHandle = NULL;
+#else
+	m_fileDescriptor = -1;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& filename)
+{
+	Close();
+
+#if defined(_WIN32)
+	m_fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(m_fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if(!GetFileSizeEx(m_fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_mappingHandle = CreateFileMappingA(m_fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(!m_mappingHandle)
+	{
+		Close();
+		return false;
+	}
+
+	m_data = (const u8*)MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if(!m_data)
+	{
+		Close();
+		return false;
+	}
+
+	m_size = (u64)fileSize.QuadPart;
+#else
+	m_fileDescriptor = open(filename.c_str(), O_RDONLY);
+	if(m_fileDescriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStat;
+	if(fstat(m_fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+
+	void* mapping = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+	if(mapping == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+
+	m_data = (const u8*)mapping;
+	m_size = (u64)fileStat.st_size;
+#endif
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+#if defined(_WIN32)
+	if(m_data)
+	{
+		UnmapViewOfFile(m_data);
+	}
+
+	if(m_mappingHandle)
+	{
+		CloseHandle(m_mappingHandle);
+		m_mappingHandle = NULL;
+	}
+
+	if(m_fileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_fileHandle);
+		m_fileHandle = INVALID_HANDLE_VALUE;
+	}
+#else
+	if(m_data)
+	{
+		munmap((void*)m_data, (size_t)m_size);
+	}
+
+	if(m_fileDescriptor >= 0)
+	{
+		close(m_fileDescriptor);
+		m_fileDescriptor = -1;
+	}
+#endif
+
+	m_data = NULL;
+	m_size = 0;
+}
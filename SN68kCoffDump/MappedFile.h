@@ -0,0 +1,48 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#pragma once
+
+#include <string>
+
+#include "atoms.h"
+
+//Read-only memory mapped view of a whole file
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const std::string& filename);
+	void Close();
+
+	bool IsOpen() const { return m_data != NULL; }
+	const u8* GetData() const { return m_data; }
+	u64 GetSize() const { return m_size; }
+
+#if !defined(_WIN32)
+	//Descriptor the view was mapped from, -1 if not open
+	int GetFileDescriptor() const { return m_fileDescriptor; }
+#endif
+
+private:
+	//Non-copyable
+	MappedFile(const MappedFile&);
+	MappedFile& operator = (const MappedFile&);
+
+	const u8* m_data;
+	u64 m_size;
+
+#if defined(_WIN32)
+	void* m_fileHandle;
+	void* m_mappingHandle;
+#else
+	int m_fileDescriptor;
+#endif
+};
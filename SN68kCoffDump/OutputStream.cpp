@@ -0,0 +1,123 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#include <cstring>
+
+#include "OutputStream.h"
+
+OutputStream::OutputStream(FILE* file, u32 bufferSize)
+{
+	m_file = file;
+	m_string = NULL;
+	m_buffer = new char[bufferSize];
+	m_bufferSize = bufferSize;
+	m_bufferUsed = 0;
+	m_size = 0;
+}
+
+OutputStream::OutputStream(std::string* string)
+{
+	m_file = NULL;
+	m_string = string;
+	m_buffer = NULL;
+	m_bufferSize = 0;
+	m_bufferUsed = 0;
+	m_size = 0;
+}
+
+OutputStream::~OutputStream()
+{
+	Flush();
+
+	if(m_buffer)
+	{
+		delete [] m_buffer;
+	}
+}
+
+void OutputStream::Write(const char* data, size_t length)
+{
+	m_size += length;
+
+	if(m_string)
+	{
+		m_string->append(data, length);
+		return;
+	}
+
+	if(m_bufferUsed + length > m_bufferSize)
+	{
+		Flush();
+
+		//Too big to buffer, write through
+		if(length > m_bufferSize)
+		{
+			fwrite(data, 1, length, m_file);
+			return;
+		}
+	}
+
+	memcpy(m_buffer + m_bufferUsed, data, length);
+	m_bufferUsed += (u32)length;
+}
+
+void OutputStream::Flush()
+{
+	if(m_file && m_bufferUsed > 0)
+	{
+		fwrite(m_buffer, 1, m_bufferUsed, m_file);
+		m_bufferUsed = 0;
+	}
+}
+
+void OutputStream::WriteSigned(s64 value)
+{
+	if(value < 0)
+	{
+		Write("-", 1);
+		WriteUnsigned((u64)0 - (u64)value);
+	}
+	else
+	{
+		WriteUnsigned((u64)value);
+	}
+}
+
+void OutputStream::WriteUnsigned(u64 value)
+{
+	//Digits written backwards from end of buffer
+	char digits[20];
+	int pos = sizeof(digits);
+
+	do
+	{
+		digits[--pos] = (char)('0' + (value % 10));
+		value /= 10;
+	}
+	while(value);
+
+	Write(digits + pos, sizeof(digits) - pos);
+}
+
+void OutputStream::WriteHex(u64 value, int width)
+{
+	static const char hexDigits[] = "0123456789abcdef";
+
+	char digits[16];
+	int pos = sizeof(digits);
+	int minPos = (width > 0 && width <= (int)sizeof(digits)) ? ((int)sizeof(digits) - width) : (int)sizeof(digits) - 1;
+
+	do
+	{
+		digits[--pos] = hexDigits[value & 0xF];
+		value >>= 4;
+	}
+	while(value || pos > minPos);
+
+	Write(digits + pos, sizeof(digits) - pos);
+}
@@ -0,0 +1,67 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "atoms.h"
+
+//Hex formatting tag, lower case without prefix, optionally zero padded to width
+struct Hex
+{
+	explicit Hex(u64 value, int width = 0) : value(value), width(width) {}
+
+	u64 value;
+	int width;
+};
+
+//Buffered text writer. Writes to a FILE in large blocks, never flushes per line,
+//or appends straight to a string. Numbers are formatted without locale or iostream state.
+class OutputStream
+{
+public:
+	explicit OutputStream(FILE* file, u32 bufferSize = 256 * 1024);
+	explicit OutputStream(std::string* string);
+	~OutputStream();
+
+	void Write(const char* data, size_t length);
+	void Flush();
+
+	//Bytes written since construction
+	u64 GetSize() const { return m_size; }
+
+	OutputStream& operator << (const char* string) { Write(string, strlen(string)); return *this; }
+	OutputStream& operator << (const std::string& string) { Write(string.data(), string.size()); return *this; }
+	OutputStream& operator << (char character) { Write(&character, 1); return *this; }
+	OutputStream& operator << (int value) { WriteSigned(value); return *this; }
+	OutputStream& operator << (long value) { WriteSigned(value); return *this; }
+	OutputStream& operator << (long long value) { WriteSigned(value); return *this; }
+	OutputStream& operator << (unsigned int value) { WriteUnsigned(value); return *this; }
+	OutputStream& operator << (unsigned long value) { WriteUnsigned(value); return *this; }
+	OutputStream& operator << (unsigned long long value) { WriteUnsigned(value); return *this; }
+	OutputStream& operator << (const Hex& hex) { WriteHex(hex.value, hex.width); return *this; }
+
+private:
+	//Non-copyable
+	OutputStream(const OutputStream&);
+	OutputStream& operator = (const OutputStream&);
+
+	void WriteSigned(s64 value);
+	void WriteUnsigned(u64 value);
+	void WriteHex(u64 value, int width);
+
+	FILE* m_file;
+	std::string* m_string;
+	char* m_buffer;
+	u32 m_bufferSize;
+	u32 m_bufferUsed;
+	u64 m_size;
+};
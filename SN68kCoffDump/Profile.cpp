@@ -0,0 +1,547 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#include <cstdio>
+#include <algorithm>
+#include <thread>
+
+#include "Profile.h"
+#include "Query.h"
+#include "MappedFile.h"
+
+//Smallest share of the sample file worth a thread of its own
+#define PROFILE_MIN_THREAD_BYTES	(1024 * 1024)
+
+//Bytes looked at to tell text samples from raw ones
+#define PROFILE_TEXT_CHECK_SIZE		4096
+
+//Open addressed hit counts by address, one per thread so counting needs no locks
+class AddressCounter
+{
+public:
+	AddressCounter()
+	{
+		m_count = 0;
+		m_shift = 32 - 12;
+		m_slots.resize(1 << 12);
+	}
+
+	void Add(u32 address)
+	{
+		u32 mask = (u32)m_slots.size() - 1;
+
+		for(u32 slot = Hash(address); ; slot = (slot + 1) & mask)
+		{
+			Slot& entry = m_slots[slot];
+
+			if(entry.hits == 0)
+			{
+				entry.address = address;
+				entry.hits = 1;
+
+				//Keep at most half full
+				if(++m_count * 2 > m_slots.size())
+					Grow();
+
+				return;
+			}
+
+			if(entry.address == address)
+			{
+				entry.hits++;
+				return;
+			}
+		}
+	}
+
+	void AppendTo(std::vector<ProfileSample>& samples) const
+	{
+		for(u32 i = 0; i < m_slots.size(); i++)
+		{
+			if(m_slots[i].hits > 0)
+			{
+				ProfileSample sample;
+				sample.address = m_slots[i].address;
+				sample.hits = m_slots[i].hits;
+				samples.push_back(sample);
+			}
+		}
+	}
+
+private:
+	struct Slot
+	{
+		Slot() : address(0), hits(0) {}
+
+		u32 address;
+		u64 hits;
+	};
+
+	u32 Hash(u32 address) const
+	{
+		//Fibonacci hashing, PCs are word aligned and clustered
+		return (address * 0x9E3779B1) >> m_shift;
+	}
+
+	void Grow()
+	{
+		std::vector<Slot> slots(m_slots.size() * 2);
+		slots.swap(m_slots);
+		m_shift--;
+
+		u32 mask = (u32)m_slots.size() - 1;
+
+		for(u32 i = 0; i < slots.size(); i++)
+		{
+			if(slots[i].hits > 0)
+			{
+				u32 slot = Hash(slots[i].address);
+				while(m_slots[slot].hits > 0)
+					slot = (slot + 1) & mask;
+
+				m_slots[slot] = slots[i];
+			}
+		}
+	}
+
+	std::vector<Slot> m_slots;
+	u32 m_count;
+	u32 m_shift;
+};
+
+static bool IsSpace(u8 c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool IsTextSamples(const u8* data, u64 size)
+{
+	//Raw PCs have zero high bytes, text is hex digits, prefixes and whitespace only
+	u64 checkSize = (size < PROFILE_TEXT_CHECK_SIZE) ? size : PROFILE_TEXT_CHECK_SIZE;
+
+	for(u64 i = 0; i < checkSize; i++)
+	{
+		u8 c = data[i];
+		bool hexDigit = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+
+		if(!hexDigit && !IsSpace(c) && c != 'x' && c != 'X' && c != '$')
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void CountRawSamples(const u8* data, u64 first, u64 end, AddressCounter& counter)
+{
+	for(u64 i = first; i < end; i++)
+	{
+		counter.Add(ReadU32BE(data + (i * sizeof(u32))));
+	}
+}
+
+//Whitespace separated hex, with or without 0x or $ prefix. Each token is counted by the chunk it starts in.
+//Counts the chunk's tokens, stopping at the first that isn't a hex address with its offset in firstInvalid
+static u64 CountTextSamples(const u8* data, u64 start, u64 end, u64 size, AddressCounter& counter, u64& firstInvalid)
+{
+	const u8* ptr = data + start;
+	const u8* chunkEnd = data + end;
+	const u8* fileEnd = data + size;
+	u64 numSamples = 0;
+
+	//Skip the tail of a token started by the previous chunk
+	while(ptr > data && ptr < chunkEnd && !IsSpace(ptr[-1]))
+		ptr++;
+
+	while(true)
+	{
+		while(ptr < chunkEnd && IsSpace(*ptr))
+			ptr++;
+
+		if(ptr >= chunkEnd)
+			break;
+
+		const u8* token = ptr;
+		while(ptr < fileEnd && !IsSpace(*ptr))
+			ptr++;
+
+		u32 address = 0;
+		if(!ParseHexAddress((const char*)token, (const char*)ptr, address))
+		{
+			//The file is rejected, no need to count the rest
+			firstInvalid = (u64)(token - data);
+			break;
+		}
+
+		counter.Add(address);
+		numSamples++;
+	}
+
+	return numSamples;
+}
+
+bool ReadProfileSamples(const std::string& filename, u32 numThreads, ProfileHistogram& histogram, std::string& error)
+{
+	MappedFile mappedFile;
+	std::vector<u8> stdinData;
+	const u8* data = NULL;
+	u64 size = 0;
+
+	if(filename == "-")
+	{
+		//Read all of stdin
+		u8 buffer[64 * 1024];
+		size_t bytesRead;
+		while((bytesRead = fread(buffer, 1, sizeof(buffer), stdin)) > 0)
+		{
+			stdinData.insert(stdinData.end(), buffer, buffer + bytesRead);
+		}
+
+		data = stdinData.empty() ? NULL : &stdinData[0];
+		size = stdinData.size();
+	}
+	else if(mappedFile.Open(filename))
+	{
+		data = mappedFile.GetData();
+		size = mappedFile.GetSize();
+	}
+	else
+	{
+		//Mapping fails on empty files too, which just hold no samples
+		FILE* file = fopen(filename.c_str(), "rb");
+		bool empty = file && fgetc(file) == EOF;
+
+		if(file)
+			fclose(file);
+
+		if(!empty)
+		{
+			error = "Could not open sample file " + filename;
+			return false;
+		}
+	}
+
+	histogram.samples.clear();
+	histogram.numSamples = 0;
+
+	if(size == 0)
+	{
+		return true;
+	}
+
+	bool text = IsTextSamples(data, size);
+
+	if(!text && (size % sizeof(u32)) != 0)
+	{
+		error = "Sample file size is not a multiple of 4 bytes";
+		return false;
+	}
+
+	//Split into roughly equal chunks, raw chunks on sample boundaries
+	u64 numUnits = text ? size : (size / sizeof(u32));
+	u64 maxThreads = (size / PROFILE_MIN_THREAD_BYTES) + 1;
+	if(numThreads > maxThreads)
+		numThreads = (u32)maxThreads;
+	if(numThreads == 0)
+		numThreads = 1;
+
+	std::vector<AddressCounter> counters(numThreads);
+	std::vector<u64> numSamples(numThreads, 0);
+	std::vector<u64> firstInvalid(numThreads, (u64)-1);
+	std::vector<std::thread> workers;
+
+	for(u32 i = 0; i < numThreads; i++)
+	{
+		workers.push_back(std::thread([&, i]()
+		{
+			u64 first = (numUnits * i) / numThreads;
+			u64 end = (numUnits * (i + 1)) / numThreads;
+
+			if(text)
+			{
+				numSamples[i] = CountTextSamples(data, first, end, size, counters[i], firstInvalid[i]);
+			}
+			else
+			{
+				CountRawSamples(data, first, end, counters[i]);
+				numSamples[i] = end - first;
+			}
+		}));
+	}
+
+	for(u32 i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+
+	//Chunks are in file order, so the first invalid token is the first chunk's that has one
+	for(u32 i = 0; i < numThreads; i++)
+	{
+		if(firstInvalid[i] != (u64)-1)
+		{
+			u64 offset = firstInvalid[i];
+			u64 tokenEnd = offset;
+			while(tokenEnd < size && !IsSpace(data[tokenEnd]))
+				tokenEnd++;
+
+			u64 lineNumber = 1 + std::count(data, data + offset, '\n');
+
+			std::string lineString;
+
+			{
+				OutputStream lineStream(&lineString);
+				lineStream << lineNumber;
+			}
+
+			error = "Invalid sample address '" + std::string((const char*)data + offset, (size_t)(tokenEnd - offset)) + "' on line " + lineString + " of " + filename;
+			return false;
+		}
+	}
+
+	//Merge per-thread counts
+	std::vector<ProfileSample> samples;
+	for(u32 i = 0; i < numThreads; i++)
+	{
+		counters[i].AppendTo(samples);
+		histogram.numSamples += numSamples[i];
+	}
+
+	std::sort(samples.begin(), samples.end(), [](const ProfileSample& lhs, const ProfileSample& rhs) { return lhs.address < rhs.address; });
+
+	for(u32 i = 0; i < samples.size(); i++)
+	{
+		if(!histogram.samples.empty() && histogram.samples.back().address == samples[i].address)
+			histogram.samples.back().hits += samples[i].hits;
+		else
+			histogram.samples.push_back(samples[i]);
+	}
+
+	return true;
+}
+
+//Sums hits of equal rows, then orders by hits, most first, and by index and line within those
+static void AggregateEntries(std::vector<ProfileEntry>& entries)
+{
+	std::sort(entries.begin(), entries.end(), [](const ProfileEntry& lhs, const ProfileEntry& rhs)
+	{
+		return (lhs.index != rhs.index) ? (lhs.index < rhs.index) : (lhs.lineNumber < rhs.lineNumber);
+	});
+
+	u32 count = 0;
+	for(u32 i = 0; i < entries.size(); i++)
+	{
+		if(count > 0 && entries[count - 1].index == entries[i].index && entries[count - 1].lineNumber == entries[i].lineNumber)
+			entries[count - 1].hits += entries[i].hits;
+		else
+			entries[count++] = entries[i];
+	}
+
+	entries.resize(count);
+
+	std::stable_sort(entries.begin(), entries.end(), [](const ProfileEntry& lhs, const ProfileEntry& rhs) { return lhs.hits > rhs.hits; });
+}
+
+static bool IsInSymbolSection(const FileCOFF& coffFile, const FileCOFF::Symbol& symbol, u32 address)
+{
+	//1-based, absolute and debug symbols have no section
+	if(symbol.sectionIndex < 1 || symbol.sectionIndex > (int)coffFile.m_sectionHeaders.size())
+	{
+		return false;
+	}
+
+	const FileCOFF::SectionHeader& section = coffFile.m_sectionHeaders[symbol.sectionIndex - 1];
+	return address >= section.physicalAddr && address - section.physicalAddr < section.size;
+}
+
+void BuildProfileReport(const FileCOFF& coffFile, const ProfileHistogram& histogram, u32 numThreads, ProfileReport& report)
+{
+	const ArrayView<FileCOFF::Symbol>& symbols = coffFile.GetSymbols();
+	const FileCOFF::LineTable& lineTable = coffFile.GetLineTable();
+	const std::vector<ProfileSample>& samples = histogram.samples;
+	u32 numAddresses = (u32)samples.size();
+
+	//Resolve each distinct address once, in parallel, into its own slot
+	std::vector<u32> symbolIndices(numAddresses);
+	std::vector<int> lineIndices(numAddresses);
+
+	if(numThreads > numAddresses / 1024 + 1)
+		numThreads = numAddresses / 1024 + 1;
+
+	std::vector<std::thread> workers;
+
+	for(u32 i = 0; i < numThreads; i++)
+	{
+		workers.push_back(std::thread([&, i]()
+		{
+			u32 first = (u32)(((u64)numAddresses * i) / numThreads);
+			u32 end = (u32)(((u64)numAddresses * (i + 1)) / numThreads);
+
+			for(u32 j = first; j < end; j++)
+			{
+				u32 address = samples[j].address;
+				lineIndices[j] = lineTable.Find(address);
+
+				//Function containing the address if sizes are known, else the nearest symbol before it, as long as
+				//the address is known code. Samples past the end of the ROM or in RAM stay unknown.
+				const FileCOFF::Symbol* symbol = coffFile.FindFunction(address);
+				if(!symbol)
+				{
+					symbol = coffFile.FindNearestSymbol(address);
+
+					if(symbol && lineIndices[j] < 0 && !IsInSymbolSection(coffFile, *symbol, address))
+						symbol = NULL;
+				}
+
+				symbolIndices[j] = symbol ? (u32)(symbol - &symbols[0]) : (u32)-1;
+			}
+		}));
+	}
+
+	for(u32 i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+
+	report.numSamples = histogram.numSamples;
+	report.numAddresses = numAddresses;
+	report.symbols.resize(numAddresses);
+	report.files.resize(numAddresses);
+	report.lines.resize(numAddresses);
+
+	for(u32 i = 0; i < numAddresses; i++)
+	{
+		int lineIndex = lineIndices[i];
+		u32 fileIndex = (lineIndex >= 0) ? lineTable.fileIndices[lineIndex] : (u32)-1;
+		s32 lineNumber = (lineIndex >= 0) ? lineTable.lineNumbers[lineIndex] : -1;
+
+		ProfileEntry symbolEntry = { symbolIndices[i], -1, samples[i].hits };
+		ProfileEntry fileEntry = { fileIndex, -1, samples[i].hits };
+		ProfileEntry lineEntry = { fileIndex, lineNumber, samples[i].hits };
+
+		report.symbols[i] = symbolEntry;
+		report.files[i] = fileEntry;
+		report.lines[i] = lineEntry;
+	}
+
+	AggregateEntries(report.symbols);
+	AggregateEntries(report.files);
+	AggregateEntries(report.lines);
+}
+
+enum ProfileTable
+{
+	PROFILE_TABLE_FUNCTIONS,
+	PROFILE_TABLE_FILES,
+	PROFILE_TABLE_LINES
+};
+
+static void WriteProfileTable(const FileCOFF& coffFile, const ProfileReport& report, ProfileTable table, u32 maxRows, OutputFormat format, OutputStream& stream)
+{
+	static const char* tableNames[] = { "function", "file", "line" };
+	static const char* tableTitles[] = { "Function", "File", "Line" };
+	static const char* jsonTypes[] = { "profileFunction", "profileFile", "profileLine" };
+
+	const std::vector<ProfileEntry>& entries = (table == PROFILE_TABLE_FUNCTIONS) ? report.symbols : ((table == PROFILE_TABLE_FILES) ? report.files : report.lines);
+	u32 numRows = (maxRows > 0 && maxRows < entries.size()) ? maxRows : (u32)entries.size();
+
+	if(format == FORMAT_TEXT)
+	{
+		stream << "Hits\tPercent\t" << tableTitles[table] << "\n";
+	}
+
+	for(u32 i = 0; i < numRows; i++)
+	{
+		const ProfileEntry& entry = entries[i];
+		bool resolved = (entry.index != (u32)-1);
+		const char* name = "??";
+
+		if(resolved)
+		{
+			name = (table == PROFILE_TABLE_FUNCTIONS) ? coffFile.GetSymbolName(coffFile.GetSymbols()[entry.index]) : coffFile.GetLineFilename(entry.index);
+		}
+
+		if(format == FORMAT_JSON)
+		{
+			stream << "{\"type\":\"" << jsonTypes[table] << "\",\"" << ((table == PROFILE_TABLE_FUNCTIONS) ? "name" : "filename") << "\":";
+
+			if(resolved)
+				WriteJSONString(name, stream);
+			else
+				stream << "null";
+
+			if(table == PROFILE_TABLE_LINES)
+			{
+				if(resolved)
+					stream << ",\"line\":" << entry.lineNumber;
+				else
+					stream << ",\"line\":null";
+			}
+
+			stream << ",\"hits\":" << entry.hits << ",\"percent\":";
+			WritePercent(entry.hits, report.numSamples, stream);
+			stream << "}\n";
+		}
+		else if(format == FORMAT_CSV)
+		{
+			stream << tableNames[table] << ",";
+
+			if(resolved)
+				WriteCSVField(name, stream);
+
+			stream << ",";
+
+			if(table == PROFILE_TABLE_LINES && resolved)
+				stream << entry.lineNumber;
+
+			stream << "," << entry.hits << ",";
+			WritePercent(entry.hits, report.numSamples, stream);
+			stream << "\n";
+		}
+		else
+		{
+			stream << entry.hits << "\t";
+			WritePercent(entry.hits, report.numSamples, stream);
+			stream << "%\t" << name;
+
+			if(table == PROFILE_TABLE_LINES && resolved)
+				stream << ":" << entry.lineNumber;
+
+			stream << "\n";
+		}
+	}
+
+	if(format == FORMAT_TEXT)
+	{
+		stream << "\n";
+	}
+}
+
+void WriteProfileReport(const FileCOFF& coffFile, const ProfileReport& report, u32 maxRows, OutputFormat format, OutputStream& stream)
+{
+	if(format == FORMAT_TEXT)
+	{
+		stream << "-------------------------------------\n";
+		stream << "PROFILE\n";
+		stream << "-------------------------------------\n";
+		stream << "Samples: " << report.numSamples << "\n";
+		stream << "Distinct addresses: " << report.numAddresses << "\n\n";
+	}
+	else if(format == FORMAT_JSON)
+	{
+		stream << "{\"type\":\"profile\",\"samples\":" << report.numSamples << ",\"addresses\":" << report.numAddresses << "}\n";
+	}
+	else if(format == FORMAT_CSV)
+	{
+		stream << "table,name,line,hits,percent\n";
+	}
+
+	WriteProfileTable(coffFile, report, PROFILE_TABLE_FUNCTIONS, maxRows, format, stream);
+	WriteProfileTable(coffFile, report, PROFILE_TABLE_FILES, maxRows, format, stream);
+	WriteProfileTable(coffFile, report, PROFILE_TABLE_LINES, maxRows, format, stream);
+}
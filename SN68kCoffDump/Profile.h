@@ -0,0 +1,63 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "FileCOFF.h"
+#include "OutputStream.h"
+#include "TableWriter.h"
+
+//Hits at one sampled address
+struct ProfileSample
+{
+	u32 address;
+	u64 hits;
+};
+
+//Distinct sampled addresses in address order, with hit counts
+struct ProfileHistogram
+{
+	ProfileHistogram()
+	{
+		numSamples = 0;
+	}
+
+	std::vector<ProfileSample> samples;
+	u64 numSamples;
+};
+
+//Reads a sample file of raw big endian u32 PCs, or whitespace separated hex PCs as text (told apart by content),
+//- for stdin. The file is split across numThreads threads, each counting into its own table, merged at the end.
+bool ReadProfileSamples(const std::string& filename, u32 numThreads, ProfileHistogram& histogram, std::string& error);
+
+//One report row, index is a symbol or file index, or -1 if the address didn't resolve
+struct ProfileEntry
+{
+	u32 index;
+	s32 lineNumber;
+	u64 hits;
+};
+
+//Hits by function (or nearest symbol without function sizes), source file and line, most hit first
+struct ProfileReport
+{
+	u64 numSamples;
+	u32 numAddresses;
+	std::vector<ProfileEntry> symbols;
+	std::vector<ProfileEntry> files;
+	std::vector<ProfileEntry> lines;
+};
+
+//Resolves each distinct address once, split across numThreads threads
+void BuildProfileReport(const FileCOFF& coffFile, const ProfileHistogram& histogram, u32 numThreads, ProfileReport& report);
+
+//Hot spot tables, up to maxRows rows each, 0 for all. Binary format is not supported.
+void WriteProfileReport(const FileCOFF& coffFile, const ProfileReport& report, u32 maxRows, OutputFormat format, OutputStream& stream);
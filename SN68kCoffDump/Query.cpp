@@ -0,0 +1,202 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#include "Query.h"
+
+void WriteAddressQuery(const FileCOFF& coffFile, u32 address, OutputStream& stream, OutputFormat format)
+{
+	FileCOFF::LineInfo line;
+	bool lineFound = coffFile.FindLine(address, line);
+	const FileCOFF::Symbol* symbol = coffFile.FindNearestSymbol(address);
+
+	if(format == FORMAT_JSON)
+	{
+		stream << "{\"type\":\"addr2line\",\"address\":" << address << ",\"filename\":";
+
+		if(lineFound)
+		{
+			WriteJSONString(line.filename, stream);
+			stream << ",\"line\":" << line.lineNumber;
+		}
+		else
+		{
+			stream << "null,\"line\":null";
+		}
+
+		stream << ",\"symbol\":";
+
+		if(symbol)
+		{
+			WriteJSONString(coffFile.GetSymbolName(*symbol), stream);
+			stream << ",\"offset\":" << (address - symbol->value);
+		}
+		else
+		{
+			stream << "null,\"offset\":null";
+		}
+
+		//Containing function, only known with function sizes
+		const FileCOFF::Symbol* function = coffFile.FindFunction(address);
+
+		stream << ",\"function\":";
+
+		if(function)
+		{
+			WriteJSONString(coffFile.GetSymbolName(*function), stream);
+			stream << ",\"functionOffset\":" << (address - function->value) << "}";
+		}
+		else
+		{
+			stream << "null,\"functionOffset\":null}";
+		}
+	}
+	else if(format == FORMAT_CSV)
+	{
+		stream << address << ",";
+
+		if(lineFound)
+		{
+			WriteCSVField(line.filename, stream);
+			stream << "," << line.lineNumber;
+		}
+		else
+		{
+			stream << ",";
+		}
+
+		stream << ",";
+
+		if(symbol)
+		{
+			WriteCSVField(coffFile.GetSymbolName(*symbol), stream);
+			stream << "," << (address - symbol->value);
+		}
+		else
+		{
+			stream << ",";
+		}
+	}
+	else
+	{
+		stream << "0x" << Hex(address) << "\t";
+
+		if(lineFound)
+			stream << line.filename << ":" << line.lineNumber;
+		else
+			stream << "??:0";
+
+		stream << "\t";
+
+		if(symbol)
+			stream << coffFile.GetSymbolName(*symbol) << "+0x" << Hex(address - symbol->value);
+		else
+			stream << "??";
+	}
+}
+
+void WriteAddressQueryCSVHeader(OutputStream& stream)
+{
+	stream << "address,filename,line,symbol,offset\n";
+}
+
+void WriteSymbolQuery(const FileCOFF& coffFile, const char* name, OutputStream& stream, OutputFormat format)
+{
+	const FileCOFF::Symbol* symbol = coffFile.FindSymbol(name);
+
+	if(format == FORMAT_JSON)
+	{
+		stream << "{\"type\":\"sym2addr\",\"name\":";
+		WriteJSONString(name, stream);
+
+		if(symbol)
+		{
+			stream << ",\"value\":" << symbol->value << ",\"section\":" << symbol->sectionIndex << ",\"sectionName\":";
+			WriteJSONString(coffFile.GetSectionName(symbol->sectionIndex), stream);
+			stream << "}";
+		}
+		else
+		{
+			stream << ",\"value\":null,\"section\":null,\"sectionName\":null}";
+		}
+	}
+	else if(format == FORMAT_CSV)
+	{
+		WriteCSVField(name, stream);
+
+		if(symbol)
+		{
+			stream << "," << symbol->value << "," << symbol->sectionIndex << ",";
+			WriteCSVField(coffFile.GetSectionName(symbol->sectionIndex), stream);
+		}
+		else
+		{
+			stream << ",,,";
+		}
+	}
+	else
+	{
+		stream << name << "\t";
+
+		if(symbol)
+			stream << "0x" << Hex(symbol->value) << "\t" << coffFile.GetSectionName(symbol->sectionIndex);
+		else
+			stream << "??\t??";
+	}
+}
+
+void WriteSymbolQueryCSVHeader(OutputStream& stream)
+{
+	stream << "name,value,section,sectionName\n";
+}
+
+void WriteROMRangeQuery(const FileCOFF& coffFile, OutputStream& stream)
+{
+	if(coffFile.m_sectionHeaders.size() > COFF_SECTION_ROM_DATA)
+	{
+		const FileCOFF::SectionHeader& romSection = coffFile.m_sectionHeaders[COFF_SECTION_ROM_DATA];
+		stream << "0x" << Hex(romSection.physicalAddr) << "\t0x" << Hex(romSection.physicalAddr + romSection.size);
+	}
+	else
+	{
+		stream << "??\t??";
+	}
+}
+
+bool ParseHexAddress(const char* start, const char* end, u32& address)
+{
+	if(start < end && *start == '$')
+		start++;
+	else if(end - start > 2 && start[0] == '0' && (start[1] == 'x' || start[1] == 'X'))
+		start += 2;
+
+	if(start >= end || end - start > 8)
+	{
+		return false;
+	}
+
+	address = 0;
+
+	for(const char* ptr = start; ptr < end; ptr++)
+	{
+		char c = *ptr;
+		u32 digit = 0;
+
+		if(c >= '0' && c <= '9')
+			digit = c - '0';
+		else if(c >= 'a' && c <= 'f')
+			digit = c - 'a' + 10;
+		else if(c >= 'A' && c <= 'F')
+			digit = c - 'A' + 10;
+		else
+			return false;
+
+		address = (address << 4) | digit;
+	}
+
+	return true;
+}
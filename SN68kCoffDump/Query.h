@@ -0,0 +1,31 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#pragma once
+
+#include "FileCOFF.h"
+#include "OutputStream.h"
+#include "TableWriter.h"
+
+//Single line query results, shared by the batch modes and the server. Each writes one line, without terminator.
+//Binary format is not supported for queries, CSV header rows are written by the caller.
+
+//Address, file:line, nearest symbol+offset, and containing function+offset in JSON
+void WriteAddressQuery(const FileCOFF& coffFile, u32 address, OutputStream& stream, OutputFormat format = FORMAT_TEXT);
+void WriteAddressQueryCSVHeader(OutputStream& stream);
+
+//Name, address, section
+void WriteSymbolQuery(const FileCOFF& coffFile, const char* name, OutputStream& stream, OutputFormat format = FORMAT_TEXT);
+void WriteSymbolQueryCSVHeader(OutputStream& stream);
+
+//ROM section start and end physical addresses
+void WriteROMRangeQuery(const FileCOFF& coffFile, OutputStream& stream);
+
+//Whole hex address token [start, end), with optional 0x or $ prefix and up to 8 digits.
+//Returns false for anything else, rather than guessing at an address.
+bool ParseHexAddress(const char* start, const char* end, u32& address);
@@ -0,0 +1,227 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "ROMExtract.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
+#endif
+
+#define ROM_PAD_BLOCK_SIZE	(64 * 1024)
+
+u32 GetPaddedROMSize(u32 size)
+{
+	u32 paddedSize = 1;
+	while(paddedSize < size && paddedSize < 0x80000000)
+	{
+		paddedSize <<= 1;
+	}
+
+	return (paddedSize < size) ? size : paddedSize;
+}
+
+//Sum of big endian words from the end of the header to the end of the padded ROM
+static u16 CalculateChecksum(const u8* data, u32 dataSize, u32 romSize)
+{
+	u32 sum = 0;
+	u32 offset = MEGADRIVE_HEADER_END;
+
+	for(; offset + 1 < dataSize; offset += 2)
+	{
+		sum += (data[offset] << 8) | data[offset + 1];
+	}
+
+	if(offset < dataSize)
+	{
+		//Odd size, last byte pairs with the first pad byte
+		sum += (data[offset] << 8) | ((romSize > dataSize) ? MEGADRIVE_PAD_BYTE : 0);
+		offset += 2;
+	}
+
+	if(romSize > offset)
+	{
+		sum += ((romSize - offset) / 2) * ((MEGADRIVE_PAD_BYTE << 8) | MEGADRIVE_PAD_BYTE);
+	}
+
+	return (u16)sum;
+}
+
+#if defined(_WIN32)
+
+static bool WriteROMFile(const std::string& romFilename, const FileCOFF&, u64, const u8* data, u32 dataSize, u32 romSize, const u16* checksum)
+{
+	FILE* file = fopen(romFilename.c_str(), "wb");
+	if(!file)
+	{
+		return false;
+	}
+
+	bool written = (dataSize == 0) || (fwrite(data, 1, dataSize, file) == dataSize);
+
+	u32 paddingSize = romSize - dataSize;
+	std::vector<u8> padding((paddingSize < ROM_PAD_BLOCK_SIZE) ? paddingSize : ROM_PAD_BLOCK_SIZE, MEGADRIVE_PAD_BYTE);
+
+	for(u32 remaining = paddingSize; written && remaining > 0;)
+	{
+		u32 blockSize = (remaining < padding.size()) ? remaining : (u32)padding.size();
+		written = (fwrite(&padding[0], 1, blockSize, file) == blockSize);
+		remaining -= blockSize;
+	}
+
+	if(written && checksum)
+	{
+		u8 bytes[2] = { (u8)(*checksum >> 8), (u8)*checksum };
+		written = (fseek(file, MEGADRIVE_CHECKSUM_OFFSET, SEEK_SET) == 0) && (fwrite(bytes, 1, sizeof(bytes), file) == sizeof(bytes));
+	}
+
+	return (fclose(file) == 0) && written;
+}
+
+#else
+
+static bool WriteAll(int file, const u8* data, u64 size)
+{
+	while(size > 0)
+	{
+		ssize_t written = write(file, data, size);
+		if(written <= 0)
+		{
+			return false;
+		}
+
+		data += written;
+		size -= written;
+	}
+
+	return true;
+}
+
+//Kernel side copy from the COFF, falling back to writing from the mapped view
+static bool CopyRange(int inFile, u64 inOffset, int outFile, const u8* data, u64 size)
+{
+	u64 copied = 0;
+
+	if(inFile >= 0)
+	{
+#if defined(HAVE_COPY_FILE_RANGE)
+		loff_t copyOffset = inOffset;
+		while(copied < size)
+		{
+			ssize_t result = copy_file_range(inFile, &copyOffset, outFile, NULL, size - copied, 0);
+			if(result <= 0)
+				break;
+
+			copied += result;
+		}
+#endif
+
+#if defined(__linux__)
+		//Older kernels can't copy_file_range across filesystems
+		off_t sendOffset = inOffset + copied;
+		while(copied < size)
+		{
+			ssize_t result = sendfile(outFile, inFile, &sendOffset, size - copied);
+			if(result <= 0)
+				break;
+
+			copied += result;
+		}
+#endif
+	}
+
+	return WriteAll(outFile, data + copied, size - copied);
+}
+
+static bool WriteROMFile(const std::string& romFilename, const FileCOFF& coffFile, u64 dataOffset, const u8* data, u32 dataSize, u32 romSize, const u16* checksum)
+{
+	int outFile = open(romFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(outFile < 0)
+	{
+		return false;
+	}
+
+	//Copied from the descriptor that was mapped, not reopened by name, so it's the file that was checksummed
+	bool written = CopyRange(coffFile.GetFileDescriptor(), dataOffset, outFile, data, dataSize);
+
+	u32 paddingSize = romSize - dataSize;
+	std::vector<u8> padding((paddingSize < ROM_PAD_BLOCK_SIZE) ? paddingSize : ROM_PAD_BLOCK_SIZE, MEGADRIVE_PAD_BYTE);
+
+	for(u32 remaining = paddingSize; written && remaining > 0;)
+	{
+		u32 blockSize = (remaining < padding.size()) ? remaining : (u32)padding.size();
+		written = WriteAll(outFile, &padding[0], blockSize);
+		remaining -= blockSize;
+	}
+
+	if(written && checksum)
+	{
+		u8 bytes[2] = { (u8)(*checksum >> 8), (u8)*checksum };
+		written = (pwrite(outFile, bytes, sizeof(bytes), MEGADRIVE_CHECKSUM_OFFSET) == sizeof(bytes));
+	}
+
+	return (close(outFile) == 0) && written;
+}
+
+#endif
+
+bool ExtractROM(const FileCOFF& coffFile, const std::string& romFilename, const ROMExtractOptions& options, ROMExtractResult& result, std::string& error)
+{
+	if(coffFile.m_sectionHeaders.size() <= COFF_SECTION_ROM_DATA)
+	{
+		error = "No ROM section";
+		return false;
+	}
+
+	const FileCOFF::SectionHeader& romSection = coffFile.m_sectionHeaders[COFF_SECTION_ROM_DATA];
+	u32 dataSize = romSection.data ? romSection.size : 0;
+
+	result.size = options.padToPowerOfTwo ? GetPaddedROMSize(dataSize) : dataSize;
+	result.checksum = 0;
+
+	if(options.fixChecksum)
+	{
+		if(result.size < MEGADRIVE_HEADER_END)
+		{
+			error = "ROM too small for a Mega Drive header";
+			return false;
+		}
+
+		result.checksum = CalculateChecksum(romSection.data, dataSize, result.size);
+	}
+
+	//Written alongside then renamed, romFilename may be the mapped input
+	std::string tempFilename = romFilename + ".tmp";
+	if(!WriteROMFile(tempFilename, coffFile, romSection.sectiondataOffset, romSection.data, dataSize, result.size, options.fixChecksum ? &result.checksum : NULL))
+	{
+		remove(tempFilename.c_str());
+		error = "Could not write file " + romFilename;
+		return false;
+	}
+
+#if defined(_WIN32)
+	//Windows rename won't replace an existing file
+	remove(romFilename.c_str());
+#endif
+
+	if(rename(tempFilename.c_str(), romFilename.c_str()) != 0)
+	{
+		remove(tempFilename.c_str());
+		error = "Could not write file " + romFilename;
+		return false;
+	}
+
+	return true;
+}
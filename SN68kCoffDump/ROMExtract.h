@@ -0,0 +1,48 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#pragma once
+
+#include <string>
+
+#include "FileCOFF.h"
+
+//Mega Drive cartridge header
+#define MEGADRIVE_CHECKSUM_OFFSET	0x18E
+#define MEGADRIVE_HEADER_END		0x200
+#define MEGADRIVE_PAD_BYTE			0xFF
+
+struct ROMExtractOptions
+{
+	ROMExtractOptions()
+	{
+		padToPowerOfTwo = false;
+		fixChecksum = false;
+	}
+
+	//Pad with 0xFF up to the next power of two size
+	bool padToPowerOfTwo;
+
+	//Recompute header checksum over the (padded) ROM
+	bool fixChecksum;
+};
+
+struct ROMExtractResult
+{
+	u32 size;
+	u16 checksum;
+};
+
+//Size -rompad pads a ROM of size bytes to, the next power of two
+u32 GetPaddedROMSize(u32 size);
+
+//Writes the ROM section to romFilename. The section is copied from the COFF file by the kernel
+//where supported (copy_file_range, then sendfile), otherwise written straight from the mapped view.
+//The checksum is summed from the mapped view and patched into the output after the copy. The ROM is
+//written alongside and renamed into place, so romFilename may be the input COFF.
+bool ExtractROM(const FileCOFF& coffFile, const std::string& romFilename, const ROMExtractOptions& options, ROMExtractResult& result, std::string& error);
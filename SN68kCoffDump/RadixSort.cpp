@@ -0,0 +1,62 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#include <algorithm>
+
+#include "RadixSort.h"
+
+void RadixSortKeys(std::vector<u64>& keys, u32 firstBit)
+{
+	const u32 numDigits = (64 - firstBit + 7) / 8;
+	u32 count = (u32)keys.size();
+
+	//Already in order, e.g. a compacted file's symbols and lines, costs one pass
+	if(count < 2 || std::is_sorted(keys.begin(), keys.end()))
+	{
+		return;
+	}
+
+	//All digit histograms in one pass
+	std::vector<u32> histograms(numDigits * 256, 0);
+	for(u32 i = 0; i < count; i++)
+	{
+		for(u32 digit = 0; digit < numDigits; digit++)
+		{
+			histograms[(digit * 256) + ((keys[i] >> (firstBit + (digit * 8))) & 0xFF)]++;
+		}
+	}
+
+	std::vector<u64> scratch(count);
+
+	for(u32 digit = 0; digit < numDigits; digit++)
+	{
+		u32 shift = firstBit + (digit * 8);
+		u32* histogram = &histograms[digit * 256];
+
+		if(histogram[(keys[0] >> shift) & 0xFF] == count)
+		{
+			continue;
+		}
+
+		//Histogram to bucket start offsets
+		u32 offset = 0;
+		for(u32 bucket = 0; bucket < 256; bucket++)
+		{
+			u32 bucketSize = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketSize;
+		}
+
+		for(u32 i = 0; i < count; i++)
+		{
+			scratch[histogram[(keys[i] >> shift) & 0xFF]++] = keys[i];
+		}
+
+		keys.swap(scratch);
+	}
+}
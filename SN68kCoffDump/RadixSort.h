@@ -0,0 +1,18 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#pragma once
+
+#include <vector>
+
+#include "atoms.h"
+
+//Stable LSD radix sort on key bits from firstBit up, a byte at a time. Keys equal in those bits keep
+//their order. Bytes that are the same for every key are skipped, like the top byte of 68000 addresses,
+//and keys already in order return after one check.
+void RadixSortKeys(std::vector<u64>& keys, u32 firstBit);
@@ -0,0 +1,155 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#include <cstdio>
+
+#include "Rebase.h"
+#include "OutputStream.h"
+
+static std::string GetRelocationError(const char* reason, const FileCOFF::SectionHeader& section, const FileCOFF::Relocation& relocation)
+{
+	std::string error;
+
+	{
+		OutputStream stream(&error);
+		stream << reason << " at 0x" << Hex(section.virtualAddr + relocation.offset);
+	}
+
+	return error;
+}
+
+bool RebaseSection(const FileCOFF& coffFile, int sectionIdx, u32 newAddress, std::vector<u8>& data, RebaseResult& result, std::string& error)
+{
+	if(sectionIdx < 0 || sectionIdx >= coffFile.m_sectionHeaders.size())
+	{
+		error = "No such section";
+		return false;
+	}
+
+	//Relocations refer to their targets by symbol
+	const ArrayView<FileCOFF::Symbol>& symbols = coffFile.GetSymbols();
+	const std::vector<FileCOFF::Relocation>& relocations = coffFile.GetRelocations();
+
+	if(!coffFile.GetError().empty())
+	{
+		error = coffFile.GetError();
+		return false;
+	}
+
+	const FileCOFF::SectionHeader& section = coffFile.m_sectionHeaders[sectionIdx];
+	s16 symbolSectionIndex = (s16)(sectionIdx + 1);
+	u32 delta = newAddress - section.virtualAddr;
+
+	if(section.data)
+		data.assign(section.data, section.data + section.size);
+	else
+		data.clear();
+
+	result.size = (u32)data.size();
+	result.numRelocations = section.numRelocationEntries;
+
+	if(section.numRelocationEntries > 0 && data.empty())
+	{
+		error = "Section has relocations but no data";
+		return false;
+	}
+
+	const FileCOFF::Relocation* relocation = relocations.data() + section.firstRelocation;
+	const FileCOFF::Relocation* end = relocation + section.numRelocationEntries;
+
+	for(; relocation != end; relocation++)
+	{
+		if(relocation->type < COFF_RELOCATION_ABSOLUTE_BYTE || relocation->type > COFF_RELOCATION_RELATIVE_LONG)
+		{
+			error = GetRelocationError("Unsupported relocation type", section, *relocation);
+			return false;
+		}
+
+		//Absolute references follow their target, PC relative ones follow the code they're in
+		bool targetMoves = (symbols[relocation->symbolIndex].sectionIndex == symbolSectionIndex);
+		bool absolute = (relocation->type <= COFF_RELOCATION_ABSOLUTE_LONG);
+
+		if(absolute != targetMoves)
+		{
+			continue;
+		}
+
+		u32 adjust = absolute ? delta : (0 - delta);
+		u8* field = &data[relocation->offset];
+
+		//Big endian fields, bytes and words must still fit once moved
+		switch(relocation->type)
+		{
+		case COFF_RELOCATION_ABSOLUTE_BYTE:
+		case COFF_RELOCATION_RELATIVE_BYTE:
+		{
+			s64 value = (s64)(s8)field[0] + (s32)adjust;
+			if(value < -0x80 || value > (absolute ? 0xFF : 0x7F))
+			{
+				error = GetRelocationError("Relocated byte out of range", section, *relocation);
+				return false;
+			}
+
+			field[0] = (u8)value;
+			break;
+		}
+		case COFF_RELOCATION_ABSOLUTE_WORD:
+		case COFF_RELOCATION_RELATIVE_WORD:
+		{
+			s64 value = (s64)(s16)((field[0] << 8) | field[1]) + (s32)adjust;
+			if(value < -0x8000 || value > (absolute ? 0xFFFF : 0x7FFF))
+			{
+				error = GetRelocationError("Relocated word out of range", section, *relocation);
+				return false;
+			}
+
+			field[0] = (u8)(value >> 8);
+			field[1] = (u8)value;
+			break;
+		}
+		default:
+		{
+			u32 value = ((u32)field[0] << 24) | (field[1] << 16) | (field[2] << 8) | field[3];
+			value += adjust;
+			field[0] = (u8)(value >> 24);
+			field[1] = (u8)(value >> 16);
+			field[2] = (u8)(value >> 8);
+			field[3] = (u8)value;
+			break;
+		}
+		}
+	}
+
+	return true;
+}
+
+bool WriteRebasedSection(const FileCOFF& coffFile, int sectionIdx, u32 newAddress, const std::string& filename, RebaseResult& result, std::string& error)
+{
+	std::vector<u8> data;
+	if(!RebaseSection(coffFile, sectionIdx, newAddress, data, result, error))
+	{
+		return false;
+	}
+
+	FILE* file = fopen(filename.c_str(), "wb");
+	if(!file)
+	{
+		error = "Could not write file " + filename;
+		return false;
+	}
+
+	bool written = data.empty() || (fwrite(&data[0], 1, data.size(), file) == data.size());
+
+	if((fclose(file) != 0) || !written)
+	{
+		error = "Could not write file " + filename;
+		return false;
+	}
+
+	return true;
+}
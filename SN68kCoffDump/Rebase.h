@@ -0,0 +1,28 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "FileCOFF.h"
+
+struct RebaseResult
+{
+	u32 size;
+	u32 numRelocations;
+};
+
+//Copies a section's data and applies its relocations for the section moving to newAddress, in one pass
+//over the relocation table. Absolute references into the section move with it, PC relative references
+//out of it move the other way, and all others are left alone. Symbol values are not changed.
+bool RebaseSection(const FileCOFF& coffFile, int sectionIdx, u32 newAddress, std::vector<u8>& data, RebaseResult& result, std::string& error);
+
+//Rebases a section and writes its data to filename
+bool WriteRebasedSection(const FileCOFF& coffFile, int sectionIdx, u32 newAddress, const std::string& filename, RebaseResult& result, std::string& error);
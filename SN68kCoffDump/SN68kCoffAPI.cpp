@@ -0,0 +1,170 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#include <cstring>
+#include <new>
+
+#include "SN68kCoffAPI.h"
+#include "FileCOFF.h"
+
+struct SN68kCoffFile
+{
+	FileCOFF coffFile;
+};
+
+static void SetError(char* error, uint32_t errorSize, const char* message)
+{
+	if(error && errorSize > 0)
+	{
+		strncpy(error, message, errorSize - 1);
+		error[errorSize - 1] = 0;
+	}
+}
+
+static void GetSymbolInfo(const FileCOFF& coffFile, const FileCOFF::Symbol& symbol, SN68kCoffSymbol* info)
+{
+	info->name = coffFile.GetSymbolName(symbol);
+	info->section = coffFile.GetSectionName(symbol.sectionIndex);
+	info->address = symbol.value;
+	info->size = symbol.size;
+	info->sectionIndex = symbol.sectionIndex;
+	info->storageClass = symbol.storageClass;
+	info->isFunction = symbol.IsFunction() ? 1 : 0;
+}
+
+uint32_t SN68kCoffGetVersion(void)
+{
+	return SN68KCOFF_API_VERSION;
+}
+
+SN68kCoffFile* SN68kCoffOpen(const char* filename, uint32_t flags, char* error, uint32_t errorSize)
+{
+	SetError(error, errorSize, "");
+
+	if(!filename)
+	{
+		SetError(error, errorSize, "No filename");
+		return NULL;
+	}
+
+	SN68kCoffFile* file = new(std::nothrow) SN68kCoffFile();
+	if(!file)
+	{
+		SetError(error, errorSize, "Out of memory");
+		return NULL;
+	}
+
+	FileCOFF& coffFile = file->coffFile;
+	bool loaded = coffFile.Load(filename, (flags & SN68KCOFF_OPEN_INDEX_CACHE) != 0);
+
+	if(loaded && coffFile.m_fileHeader.machineType != COFF_MACHINE_68000)
+	{
+		SetError(error, errorSize, "Unknown COFF machine/processor type, not a SNASM68K COFF");
+	}
+	else if(loaded && coffFile.LoadSymbolTable() && coffFile.LoadLineTable())
+	{
+		//Decode everything now, queries only read
+		coffFile.BuildSymbolNameIndex();
+		return file;
+	}
+	else
+	{
+		SetError(error, errorSize, coffFile.GetError().c_str());
+	}
+
+	delete file;
+	return NULL;
+}
+
+void SN68kCoffClose(SN68kCoffFile* file)
+{
+	delete file;
+}
+
+uint32_t SN68kCoffQueryAddress(const SN68kCoffFile* file, uint32_t address, uint32_t lookups, SN68kCoffAddressInfo* info)
+{
+	memset(info, 0, sizeof(SN68kCoffAddressInfo));
+
+	const FileCOFF& coffFile = file->coffFile;
+	uint32_t found = 0;
+
+	FileCOFF::LineInfo line;
+	if((lookups & SN68KCOFF_QUERY_LINE) && coffFile.FindLine(address, line))
+	{
+		info->filename = line.filename;
+		info->lineNumber = line.lineNumber;
+		info->lineAddress = line.address;
+		info->lineEndAddress = line.endAddress;
+		found |= SN68KCOFF_QUERY_LINE;
+	}
+
+	const FileCOFF::Symbol* symbol = (lookups & SN68KCOFF_QUERY_SYMBOL) ? coffFile.FindNearestSymbol(address) : NULL;
+	if(symbol)
+	{
+		info->symbol = coffFile.GetSymbolName(*symbol);
+		info->symbolAddress = symbol->value;
+		found |= SN68KCOFF_QUERY_SYMBOL;
+	}
+
+	const FileCOFF::Symbol* function = (lookups & SN68KCOFF_QUERY_FUNCTION) ? coffFile.FindFunction(address) : NULL;
+	if(function)
+	{
+		info->function = coffFile.GetSymbolName(*function);
+		info->functionAddress = function->value;
+		info->functionSize = function->size;
+		found |= SN68KCOFF_QUERY_FUNCTION;
+	}
+
+	return found;
+}
+
+int SN68kCoffQueryName(const SN68kCoffFile* file, const char* name, SN68kCoffSymbol* symbol)
+{
+	const FileCOFF::Symbol* found = name ? file->coffFile.FindSymbol(name) : NULL;
+	if(!found)
+	{
+		return 0;
+	}
+
+	GetSymbolInfo(file->coffFile, *found, symbol);
+	return 1;
+}
+
+uint32_t SN68kCoffGetNumSymbols(const SN68kCoffFile* file)
+{
+	return (uint32_t)file->coffFile.GetSortedSymbolIndices().size();
+}
+
+int SN68kCoffGetSymbol(const SN68kCoffFile* file, uint32_t index, SN68kCoffSymbol* symbol)
+{
+	const FileCOFF& coffFile = file->coffFile;
+	const ArrayView<u32>& sortedIndices = coffFile.GetSortedSymbolIndices();
+
+	if(index >= sortedIndices.size())
+	{
+		return 0;
+	}
+
+	GetSymbolInfo(coffFile, coffFile.GetSymbols()[sortedIndices[index]], symbol);
+	return 1;
+}
+
+int SN68kCoffGetROMRange(const SN68kCoffFile* file, uint32_t* start, uint32_t* end)
+{
+	const FileCOFF& coffFile = file->coffFile;
+
+	if(coffFile.m_sectionHeaders.size() <= COFF_SECTION_ROM_DATA)
+	{
+		return 0;
+	}
+
+	const FileCOFF::SectionHeader& romSection = coffFile.m_sectionHeaders[COFF_SECTION_ROM_DATA];
+	*start = romSection.physicalAddr;
+	*end = romSection.physicalAddr + romSection.size;
+	return 1;
+}
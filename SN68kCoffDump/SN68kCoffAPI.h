@@ -0,0 +1,97 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#pragma once
+
+//C interface for symbolising in-process, e.g. from an emulator or profiler.
+//
+//A file is fully decoded by SN68kCoffOpen, after which every query is read-only: any number of threads
+//may query one handle at once, without locking. Queries don't allocate, strings returned point into the
+//handle and stay valid until SN68kCoffClose. The handle must not be closed while queries are running.
+
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(SN68KCOFF_SHARED_BUILD)
+	#define SN68KCOFF_API __declspec(dllexport)
+#elif defined(_WIN32) && defined(SN68KCOFF_SHARED)
+	#define SN68KCOFF_API __declspec(dllimport)
+#elif defined(SN68KCOFF_SHARED_BUILD)
+	#define SN68KCOFF_API __attribute__((visibility("default")))
+#else
+	#define SN68KCOFF_API
+#endif
+
+//Changes whenever a declaration here changes incompatibly
+#define SN68KCOFF_API_VERSION	1
+
+//SN68kCoffOpen flags
+#define SN68KCOFF_OPEN_INDEX_CACHE	0x00000001	//Loads tables from filename.cof.idx, rebuilding it if stale
+
+//SN68kCoffQueryAddress lookups, requested and returned as found
+#define SN68KCOFF_QUERY_LINE		0x00000001	//Source line covering the address
+#define SN68KCOFF_QUERY_SYMBOL		0x00000002	//Nearest symbol at or before the address
+#define SN68KCOFF_QUERY_FUNCTION	0x00000004	//Function whose size covers the address
+#define SN68KCOFF_QUERY_ALL			0x00000007
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct SN68kCoffFile SN68kCoffFile;
+
+typedef struct SN68kCoffSymbol
+{
+	const char* name;
+	const char* section;		//Section name, or UNDEFINED, ABSOLUTE, DEBUG
+	uint32_t address;
+	uint32_t size;				//Function size, 0 if unknown
+	int16_t sectionIndex;		//1-based, 0 undefined, -1 absolute, -2 debug
+	int8_t storageClass;		//COFF storage class, e.g. 2 external, 3 static, 6 label
+	uint8_t isFunction;
+} SN68kCoffSymbol;
+
+//Members of lookups not found are NULL/0
+typedef struct SN68kCoffAddressInfo
+{
+	const char* filename;
+	int32_t lineNumber;
+	uint32_t lineAddress;		//Range of the line's code
+	uint32_t lineEndAddress;
+
+	const char* symbol;
+	uint32_t symbolAddress;
+
+	const char* function;
+	uint32_t functionAddress;
+	uint32_t functionSize;
+} SN68kCoffAddressInfo;
+
+//Returns SN68KCOFF_API_VERSION of the library, for checking against the header at runtime
+SN68KCOFF_API uint32_t SN68kCoffGetVersion(void);
+
+//Maps and decodes a SNASM68K COFF file, returns NULL on failure with the reason in error, if given
+SN68KCOFF_API SN68kCoffFile* SN68kCoffOpen(const char* filename, uint32_t flags, char* error, uint32_t errorSize);
+
+SN68KCOFF_API void SN68kCoffClose(SN68kCoffFile* file);
+
+//Runs the SN68KCOFF_QUERY_ lookups requested, returns those found
+SN68KCOFF_API uint32_t SN68kCoffQueryAddress(const SN68kCoffFile* file, uint32_t address, uint32_t lookups, SN68kCoffAddressInfo* info);
+
+//Symbol by exact name, first in table order. Returns 0 if not found.
+SN68KCOFF_API int SN68kCoffQueryName(const SN68kCoffFile* file, const char* name, SN68kCoffSymbol* symbol);
+
+//Symbols by position in address order, for iterating. SN68kCoffGetSymbol returns 0 if index is out of range.
+SN68KCOFF_API uint32_t SN68kCoffGetNumSymbols(const SN68kCoffFile* file);
+SN68KCOFF_API int SN68kCoffGetSymbol(const SN68kCoffFile* file, uint32_t index, SN68kCoffSymbol* symbol);
+
+//ROM section physical address range [start, end), returns 0 if the file has none
+SN68KCOFF_API int SN68kCoffGetROMRange(const SN68kCoffFile* file, uint32_t* start, uint32_t* end);
+
+#ifdef __cplusplus
+}
+#endif
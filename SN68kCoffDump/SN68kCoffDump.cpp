@@ -9,221 +9,1180 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <cstdio>
 #include <string>
 #include <algorithm>
+#include <vector>
+#include <cctype>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstdlib>
+#include <new>
 
 #include "stdafx.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <glob.h>
+#endif
 #include "FileCOFF.h"
+#include "Query.h"
+#include "OutputStream.h"
+#include "TableWriter.h"
+#include "SymbolServer.h"
+#include "ROMExtract.h"
+#include "Diff.h"
+#include "Disassembler.h"
+#include "Profile.h"
+#include "Rebase.h"
+#include "SizeMap.h"
+#include "Stats.h"
+
+//Heap allocations are counted per thread for -stats. Every form is replaced, so all pair with malloc/free.
+//Counting is off unless -stats is given, set before any worker thread starts.
+static bool s_countAllocations = false;
 
-void PrintUsage(std::stringstream& stream)
+void* operator new(size_t size, const std::nothrow_t&) noexcept
 {
-	stream << "Usage:" << std::endl;
-	stream << "\tsn68kcoffdump filename.cof [options]" << std::endl;
-	stream << "Options:" << std::endl;
-	stream << "\t-summary\t\tPrints COFF summary" << std::endl;
-	stream << "\t-symbols\t\tPrints symbol table" << std::endl;
-	stream << "\t-extractrom [filename]\tExtracts ROM file" << std::endl;
-	stream << "\t-addr2line [hex address]\tPrints file/line and symbol from physical address" << std::endl;
+	if(s_countAllocations)
+		CountAllocation(size);
+
+	return malloc(size ? size : 1);
 }
 
-int _tmain(int argc, _TCHAR* argv[])
+void* operator new(size_t size)
 {
-	std::stringstream textStream;
+	void* ptr = operator new(size, std::nothrow);
+	if(!ptr)
+		throw std::bad_alloc();
 
-	textStream << "-------------------------------------" << std::endl;
-	textStream << "SNASM2 68000 COFF File Info Dump Tool" << std::endl;
-	textStream << "-------------------------------------" << std::endl;
-	textStream << "Release 0.1a, 23/Jan/2016" << std::endl;
-	textStream << "Matt Phillips, Big Evil Corporation" << std::endl;
-	textStream << "http://www.bigevilcorporation.co.uk" << std::endl;
-	textStream << "-------------------------------------" << std::endl << std::endl;
+	return ptr;
+}
 
-	//Args
-	std::string filename;
-	bool argDumpSummary = false;
-	bool argDumpSymbols = false;
-	bool argExtractROM = false;
-	std::string argROMFilename;
-	bool argAddressToLine = false;
-	u32  argAddress = 0;
-	bool argError = false;
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+	free(ptr);
+}
+
+void PrintBanner(OutputStream& textStream)
+{
+	textStream << "-------------------------------------\n";
+	textStream << "SNASM2 68000 COFF File Info Dump Tool\n";
+	textStream << "-------------------------------------\n";
+	textStream << "Release 0.1a, 23/Jan/2016\n";
+	textStream << "Matt Phillips, Big Evil Corporation\n";
+	textStream << "http://www.bigevilcorporation.co.uk\n";
+	textStream << "-------------------------------------\n\n";
+}
+
+void PrintUsage(OutputStream& stream)
+{
+	stream << "Usage:\n";
+	stream << "\tsn68kcoffdump filename.cof [filename2.cof ...] [options]\n";
+	stream << "\tInput filenames may contain * and ? wildcards\n";
+	stream << "Options:\n";
+	stream << "\t-summary\t\tPrints COFF summary\n";
+	stream << "\t-symbols\t\tPrints symbol table\n";
+	stream << "\t-lines\t\t\tPrints line number table\n";
+	stream << "\t-extractrom [filename]\tExtracts ROM file (with multiple inputs, a directory)\n";
+	stream << "\t-rompad\t\t\tPads extracted ROM with 0xFF to the next power of two size\n";
+	stream << "\t-romchecksum\t\tRecomputes the Mega Drive header checksum of the extracted ROM\n";
+	stream << "\t-rebase [hex address] [filename]\tApplies relocations to move the ROM section to address, and writes it out\n";
+	stream << "\t-writecoff [filename]\tWrites the parsed COFF file back out (with multiple inputs, a directory)\n";
+	stream << "\t-compact\t\tWith -writecoff, keeps only address symbols and function sizes, shares names, and presorts tables\n";
+	stream << "\t-sizemap\t\tPrints section occupancy, free space, and the largest symbols, files and gaps\n";
+	stream << "\t-sizemaptop [count]\tRows per size map table, defaults to 20, 0 for all\n";
+	stream << "\t-diff [filename]\tCompares symbols and ROM bytes against an older build's COFF file\n";
+	stream << "\t-disasm [hex start] [hex end]\tDisassembles the ROM section, or addresses start up to end, with labels and file:line markers\n";
+	stream << "\t-addr2line [hex address]\tPrints file/line and symbol from physical address\n";
+	stream << "\t-addr2linebatch [filename]\tPrints file/line and symbol for each hex address in file (- for stdin)\n";
+	stream << "\t-profile [filename]\tHit counts by function, file and line from hex or raw big endian PC samples (- for stdin)\n";
+	stream << "\t-profiletop [count]\tRows per profile table, defaults to 20, 0 for all\n";
+	stream << "\t-sym2addr [name]\t\tPrints address and section of symbol\n";
+	stream << "\t-sym2addrbatch [filename]\tPrints address and section for each symbol name in file (- for stdin)\n";
+	stream << "\t-server [socket path]\tServes addr2line/sym2addr/romrange queries over a Unix domain socket\n";
+	stream << "\t-serverfile [filename]\tAdds another COFF file to serve, may be repeated\n";
+	stream << "\t-filelist [filename]\tAdds input filenames listed in file (- for stdin)\n";
+	stream << "\t-outdir [directory]\tWrites each input's output to directory/name.txt instead of concatenating\n";
+	stream << "\t-threads [count]\tNumber of files processed in parallel, defaults to core count\n";
+	stream << "\t-format [format]\tOutput format: text (default), json (lines), csv, or binary (-summary/-symbols/-lines only)\n";
+	stream << "\t-indexcache\t\tLoads symbols and lines from filename.cof.idx, rebuilding it if stale\n";
+	stream << "\t-stats\t\t\tReports load phase times, record counts, allocations, peak memory and query latencies\n";
+}
+
+bool ReadInputText(const std::string& filename, std::string& text)
+{
+	if(filename == "-")
+	{
+		//Read all of stdin
+		std::stringstream inStream;
+		inStream << std::cin.rdbuf();
+		text = inStream.str();
+	}
+	else
+	{
+		std::ifstream file(filename, std::ios::in | std::ios::binary);
+		if(!file.is_open())
+		{
+			return false;
+		}
+
+		std::stringstream inStream;
+		inStream << file.rdbuf();
+		text = inStream.str();
+	}
+
+	return true;
+}
 
-	//Need at least 3 args (exe + input filename + operation)
-	if(argc > 2)
+bool ReadAddressList(const std::string& filename, std::vector<u32>& addresses, std::string& error)
+{
+	std::string text;
+	if(!ReadInputText(filename, text))
 	{
-		//Input filename
-		filename = argv[1];
+		error = "Could not open address file " + filename;
+		return false;
+	}
+
+	//Tokenise whitespace separated hex addresses, with or without 0x prefix
+	const char* ptr = text.c_str();
+	const char* end = ptr + text.size();
+	u32 lineNumber = 1;
+
+	while(ptr < end)
+	{
+		while(ptr < end && isspace((u8)*ptr))
+		{
+			if(*ptr == '\n')
+				lineNumber++;
+
+			ptr++;
+		}
+
+		if(ptr == end)
+			break;
+
+		const char* start = ptr;
+		while(ptr < end && !isspace((u8)*ptr))
+			ptr++;
 
-		//Tokenise remaining arguments
-		for(int i = 2; i < argc; i++)
+		//A typo mustn't turn into a plausible address
+		u32 address = 0;
+		if(!ParseHexAddress(start, ptr, address))
 		{
-			if(_stricmp(argv[i], "-summary") == 0)
-				argDumpSummary = true;
-			else if(_stricmp(argv[i], "-symbols") == 0)
-				argDumpSymbols = true;
-			else if(_stricmp(argv[i], "-extractrom") == 0)
+			std::string lineString;
+
 			{
-				//Need filename arg
-				if(i < (argc - 1))
-				{
-					i++;
-					argExtractROM = true;
-					argROMFilename = argv[i];
-				}
+				OutputStream lineStream(&lineString);
+				lineStream << lineNumber;
 			}
-			else if(_stricmp(argv[i], "-addr2line") == 0)
+
+			error = "Invalid address '" + std::string(start, ptr) + "' on line " + lineString + " of " + filename;
+			return false;
+		}
+
+		addresses.push_back(address);
+	}
+
+	return true;
+}
+
+bool ReadNameList(const std::string& filename, std::vector<std::string>& names)
+{
+	std::string text;
+	if(!ReadInputText(filename, text))
+	{
+		return false;
+	}
+
+	//Tokenise whitespace separated names
+	const char* ptr = text.c_str();
+	const char* end = ptr + text.size();
+
+	while(ptr < end)
+	{
+		while(ptr < end && isspace((u8)*ptr))
+			ptr++;
+
+		const char* start = ptr;
+		while(ptr < end && !isspace((u8)*ptr))
+			ptr++;
+
+		if(ptr > start)
+			names.push_back(std::string(start, ptr));
+	}
+
+	return true;
+}
+
+//Query latencies, lookup and formatting, go to latency if given
+void ResolveNameBatch(const FileCOFF& coffFile, const std::vector<std::string>& names, OutputFormat format, OutputStream& stream, LatencyHistogram* latency = NULL)
+{
+	if(format == FORMAT_CSV)
+		WriteSymbolQueryCSVHeader(stream);
+
+	//One line per name
+	for(int i = 0; i < names.size(); i++)
+	{
+		u64 startTime = latency ? GetTimeNs() : 0;
+		WriteSymbolQuery(coffFile, names[i].c_str(), stream, format);
+
+		if(latency)
+			latency->Add(GetTimeNs() - startTime);
+
+		stream << "\n";
+	}
+}
+
+void ResolveAddressBatch(const FileCOFF& coffFile, const std::vector<u32>& addresses, OutputFormat format, OutputStream& stream, LatencyHistogram* latency = NULL)
+{
+	if(format == FORMAT_CSV)
+		WriteAddressQueryCSVHeader(stream);
+
+	//One line per address
+	for(int i = 0; i < addresses.size(); i++)
+	{
+		u64 startTime = latency ? GetTimeNs() : 0;
+		WriteAddressQuery(coffFile, addresses[i], stream, format);
+
+		if(latency)
+			latency->Add(GetTimeNs() - startTime);
+
+		stream << "\n";
+	}
+}
+
+struct Arguments
+{
+	Arguments()
+	{
+		dumpSummary = false;
+		dumpSymbols = false;
+		dumpLines = false;
+		extractROM = false;
+		rebase = false;
+		rebaseAddress = 0;
+		writeCOFF = false;
+		compact = false;
+		sizeMap = false;
+		sizeMapTop = 20;
+		diff = false;
+		diffBase = NULL;
+		disassemble = false;
+		disassembleStart = 0;
+		disassembleEnd = 0xFFFFFFFF;
+		addressToLine = false;
+		address = 0;
+		addressToLineBatch = false;
+		symbolToAddress = false;
+		symbolToAddressBatch = false;
+		profile = false;
+		profileTop = 20;
+		server = false;
+		indexCache = false;
+		stats = false;
+		numThreads = 0;
+		format = FORMAT_TEXT;
+	}
+
+	bool dumpSummary;
+	bool dumpSymbols;
+	bool dumpLines;
+	bool extractROM;
+	std::string romFilename;
+	ROMExtractOptions romOptions;
+	bool rebase;
+	u32 rebaseAddress;
+	std::string rebaseFilename;
+	bool writeCOFF;
+	std::string coffFilename;
+	bool compact;
+	bool sizeMap;
+	u32 sizeMapTop;
+	bool diff;
+	std::string diffFilename;
+	bool disassemble;
+	u32 disassembleStart;
+	u32 disassembleEnd;
+	bool addressToLine;
+	u32 address;
+	bool addressToLineBatch;
+	std::string addressFilename;
+	bool symbolToAddress;
+	std::string symbolName;
+	bool symbolToAddressBatch;
+	std::string symbolFilename;
+	bool profile;
+	std::string profileFilename;
+	u32 profileTop;
+	bool server;
+	std::string socketPath;
+	std::vector<std::string> serverFilenames;
+	bool indexCache;
+	bool stats;
+	std::string outputDirectory;
+	int numThreads;
+	OutputFormat format;
+
+	//Batch query inputs, read once and shared by all files
+	std::vector<u32> addresses;
+	std::vector<std::string> names;
+	ProfileHistogram profileHistogram;
+	const FileCOFF* diffBase;
+};
+
+std::string GetBaseName(const std::string& filename)
+{
+	size_t start = filename.find_last_of("/\\");
+	start = (start == std::string::npos) ? 0 : start + 1;
+
+	size_t end = filename.find_last_of('.');
+	if(end == std::string::npos || end < start)
+		end = filename.size();
+
+	return filename.substr(start, end - start);
+}
+
+void ExpandInputPattern(const std::string& pattern, std::vector<std::string>& filenames)
+{
+	if(pattern.find_first_of("*?") == std::string::npos)
+	{
+		filenames.push_back(pattern);
+		return;
+	}
+
+#if defined(_WIN32)
+	//FindFirstFile returns names only, keep the directory part
+	size_t directoryEnd = pattern.find_last_of("/\\");
+	std::string directory = (directoryEnd == std::string::npos) ? "" : pattern.substr(0, directoryEnd + 1);
+	std::vector<std::string> matches;
+
+	WIN32_FIND_DATAA findData;
+	HANDLE findHandle = FindFirstFileA(pattern.c_str(), &findData);
+	if(findHandle != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			if(!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+				matches.push_back(directory + findData.cFileName);
+		}
+		while(FindNextFileA(findHandle, &findData));
+
+		FindClose(findHandle);
+	}
+
+	std::sort(matches.begin(), matches.end());
+	filenames.insert(filenames.end(), matches.begin(), matches.end());
+#else
+	glob_t globResult;
+	if(glob(pattern.c_str(), 0, NULL, &globResult) == 0)
+	{
+		//Already sorted
+		for(size_t i = 0; i < globResult.gl_pathc; i++)
+			filenames.push_back(globResult.gl_pathv[i]);
+	}
+
+	globfree(&globResult);
+#endif
+}
+
+//Any operation ProcessFile runs on each input, everything but -server
+bool HasFileOperation(const Arguments& args)
+{
+	return args.dumpSummary || args.dumpSymbols || args.dumpLines || args.addressToLine || args.addressToLineBatch || args.symbolToAddress || args.symbolToAddressBatch
+		|| args.profile || args.extractROM || args.rebase || args.sizeMap || args.diff || args.disassemble || args.writeCOFF || args.stats;
+}
+
+void ProcessFile(const std::string& filename, const Arguments& args, bool multipleFiles, OutputStream& textStream)
+{
+	//Baselines for -stats, allocations are this thread's
+	ProcessStats stats;
+	u64 startTime = GetTimeNs();
+	AllocationStats startAllocations = GetAllocationStats();
+
+	//Map and serialise COFF file
+	FileCOFF coffFile;
+	if(!coffFile.Load(filename, args.indexCache))
+	{
+		textStream << "Error: " << coffFile.GetError().c_str() << "\n";
+		return;
+	}
+
+	//Sanity checks
+	if(coffFile.m_fileHeader.machineType != COFF_MACHINE_68000)
+	{
+		//Unsupported machine/processor type
+		textStream << "Unknown COFF machine/processor type, not a SNASM68K COFF\n";
+		return;
+	}
+	
+	if(coffFile.m_sectionHeaders.size() != COFF_SECTION_COUNT)
+	{
+		//SNASM2 COFF has a fixed number of sections
+		textStream << "Unsupported section count, not a SNASM68K COFF\n";
+		return;
+	}
+
+	//Decode only the tables the requested operations use
+	bool needSymbols = args.stats || args.dumpSymbols || args.addressToLine || args.addressToLineBatch || args.symbolToAddress || args.symbolToAddressBatch || args.profile || args.sizeMap || args.diff || args.disassemble;
+	bool needLines = args.stats || args.dumpLines || args.addressToLine || args.addressToLineBatch || args.profile || args.sizeMap || args.diff || args.disassemble;
+
+	if((needSymbols && !coffFile.LoadSymbolTable()) || (needLines && !coffFile.LoadLineTable()))
+	{
+		textStream << "Error: " << coffFile.GetError().c_str() << "\n";
+		return;
+	}
+
+	if(args.dumpSummary)
+	{
+		//Dump file info
+		if(args.format == FORMAT_TEXT)
+			coffFile.Dump(textStream);
+		else
+			WriteSectionTable(coffFile, args.format, textStream);
+	}
+
+	if(args.dumpSymbols)
+	{
+		//Dump symbols
+		WriteSymbolTable(coffFile, args.format, textStream);
+	}
+
+	if(args.dumpLines)
+	{
+		//Dump line table
+		WriteLineTable(coffFile, args.format, textStream);
+	}
+
+	if(args.extractROM)
+	{
+		//With multiple inputs the ROM filename is a directory, one ROM per input
+		std::string romFilename = multipleFiles ? (args.romFilename + "/" + GetBaseName(filename) + ".bin") : args.romFilename;
+
+		//Extract ROM
+		ROMExtractResult romResult;
+		std::string romError;
+		if(ExtractROM(coffFile, romFilename, args.romOptions, romResult, romError))
+		{
+			textStream << "ROM extracted\n";
+			textStream << "Filename: " << romFilename.c_str() << "\n";
+			textStream << "Size: " << romResult.size << " bytes\n";
+
+			if(args.romOptions.fixChecksum)
 			{
-				//Need address arg
-				if(i < (argc-1))
-				{
-					i++;
-					argAddressToLine = true;
-					argAddress = strtol(argv[i], NULL, 16);
-				}
+				textStream << "Checksum: 0x" << Hex(romResult.checksum, 4) << "\n";
+			}
+		}
+		else
+		{
+			textStream << "Error: " << romError.c_str() << "\n";
+		}
+	}
+
+	if(args.rebase)
+	{
+		//With multiple inputs the output filename is a directory, like the ROM
+		std::string rebaseFilename = multipleFiles ? (args.rebaseFilename + "/" + GetBaseName(filename) + ".bin") : args.rebaseFilename;
+
+		//Relocate ROM section
+		RebaseResult rebaseResult;
+		std::string rebaseError;
+		if(WriteRebasedSection(coffFile, COFF_SECTION_ROM_DATA, args.rebaseAddress, rebaseFilename, rebaseResult, rebaseError))
+		{
+			textStream << "ROM rebased\n";
+			textStream << "Filename: " << rebaseFilename.c_str() << "\n";
+			textStream << "Address: 0x" << Hex(args.rebaseAddress) << "\n";
+			textStream << "Size: " << rebaseResult.size << " bytes\n";
+			textStream << "Relocations: " << rebaseResult.numRelocations << "\n";
+		}
+		else
+		{
+			textStream << "Error: " << rebaseError.c_str() << "\n";
+		}
+	}
+
+	if(args.sizeMap)
+	{
+		//ROM budget
+		SizeMap sizeMap;
+		BuildSizeMap(coffFile, sizeMap);
+		WriteSizeMap(coffFile, sizeMap, args.sizeMapTop, args.format, textStream);
+	}
+
+	if(args.diff)
+	{
+		//Against the shared base build
+		COFFDiff diff;
+		DiffCOFF(*args.diffBase, coffFile, diff);
+		WriteCOFFDiff(*args.diffBase, coffFile, diff, args.format, textStream);
+	}
+
+	if(args.disassemble)
+	{
+		//Chunks of the ROM across cores, written in address order
+		u32 numThreads = (args.numThreads > 0) ? args.numThreads : std::thread::hardware_concurrency();
+		std::string disassembleError;
+		if(!DisassembleROM(coffFile, args.disassembleStart, args.disassembleEnd, numThreads, args.format, textStream, disassembleError))
+		{
+			textStream << "Error: " << disassembleError.c_str() << "\n";
+		}
+	}
+
+	LatencyHistogram* addressLatency = args.stats ? &stats.addressQueries : NULL;
+	LatencyHistogram* nameLatency = args.stats ? &stats.nameQueries : NULL;
+
+	if(args.addressToLine && args.format != FORMAT_TEXT)
+	{
+		ResolveAddressBatch(coffFile, std::vector<u32>(1, args.address), args.format, textStream, addressLatency);
+	}
+	else if(args.addressToLine)
+	{
+		u64 queryStartTime = GetTimeNs();
+
+		//Find line
+		FileCOFF::LineInfo line;
+		if(!coffFile.FindLine(args.address, line))
+		{
+			//Line/symbol not found
+			textStream << "Symbol at address 0x" << Hex(args.address) << " not found\n";
+		}
+		else
+		{
+			//Line found, get nearest symbol
+			const FileCOFF::Symbol* symbol = coffFile.FindNearestSymbol(args.address);
+
+			textStream << "Address 0x" << Hex(args.address) << "\n";
+			textStream << "Filename: " << line.filename << "\n";
+			textStream << "Line: " << line.lineNumber << "\n";
+			textStream << "Line address range: 0x" << Hex(line.address) << " - 0x" << Hex(line.endAddress) << "\n";
+
+			if(symbol)
+			{
+				textStream << "Nearest symbol name: " << coffFile.GetSymbolName(*symbol) << "\n";
+				textStream << "Nearest symbol address: " << Hex(symbol->value) << "\n";
 			}
 			else
 			{
-				argError = true;
+				textStream << "Nearest symbol: Not found\n";
+			}
+
+			//Only with function sizes from aux records
+			const FileCOFF::Symbol* function = coffFile.FindFunction(args.address);
+			if(function)
+			{
+				textStream << "Function name: " << coffFile.GetSymbolName(*function) << "\n";
+				textStream << "Function address range: 0x" << Hex(function->value) << " - 0x" << Hex(function->value + function->size) << "\n";
 			}
 		}
 
-		if(argError || (!argDumpSummary && !argDumpSymbols && !argAddressToLine && !argExtractROM))
+		if(addressLatency)
+			addressLatency->Add(GetTimeNs() - queryStartTime);
+	}
+
+	if(args.addressToLineBatch)
+	{
+		//Resolve all addresses against this parsed file
+		ResolveAddressBatch(coffFile, args.addresses, args.format, textStream, addressLatency);
+	}
+
+	if(args.profile)
+	{
+		//Attribute the shared samples to this file's functions and lines
+		u32 numThreads = (args.numThreads > 0) ? args.numThreads : std::thread::hardware_concurrency();
+		ProfileReport report;
+		BuildProfileReport(coffFile, args.profileHistogram, numThreads, report);
+		WriteProfileReport(coffFile, report, args.profileTop, args.format, textStream);
+	}
+
+	if(args.symbolToAddress || args.symbolToAddressBatch)
+	{
+		//Hash all symbol names once for this load
+		coffFile.BuildSymbolNameIndex();
+	}
+
+	if(args.symbolToAddress && args.format != FORMAT_TEXT)
+	{
+		ResolveNameBatch(coffFile, std::vector<std::string>(1, args.symbolName), args.format, textStream, nameLatency);
+	}
+	else if(args.symbolToAddress)
+	{
+		u64 queryStartTime = GetTimeNs();
+
+		const FileCOFF::Symbol* symbol = coffFile.FindSymbol(args.symbolName.c_str());
+		if(!symbol)
+		{
+			textStream << "Symbol " << args.symbolName.c_str() << " not found\n";
+		}
+		else
 		{
-			//No operation specified, or arg error, print usage
-			PrintUsage(textStream);
+			textStream << "Symbol: " << coffFile.GetSymbolName(*symbol) << "\n";
+			textStream << "Address: 0x" << Hex(symbol->value) << "\n";
+			textStream << "Section: " << coffFile.GetSectionName(symbol->sectionIndex) << " (" << symbol->sectionIndex << ")\n";
 		}
+
+		if(nameLatency)
+			nameLatency->Add(GetTimeNs() - queryStartTime);
 	}
-	else
+
+	if(args.symbolToAddressBatch)
 	{
-		//No filename arg, print usage
-		PrintUsage(textStream);
+		//Resolve all names against this parsed file
+		ResolveNameBatch(coffFile, args.names, args.format, textStream, nameLatency);
+	}
+
+	if(args.stats)
+	{
+		//Before writing, which changes the tables when compacting
+		AllocationStats allocations = GetAllocationStats();
+		stats.allocations.numAllocations = allocations.numAllocations - startAllocations.numAllocations;
+		stats.allocations.bytesAllocated = allocations.bytesAllocated - startAllocations.bytesAllocated;
+		stats.wallNs = GetTimeNs() - startTime;
+
+		WriteStats(coffFile, stats, args.format, textStream);
+	}
+
+	if(args.writeCOFF)
+	{
+		//Last, compacting changes the tables the operations above read
+		std::string coffFilename = multipleFiles ? (args.coffFilename + "/" + GetBaseName(filename) + ".cof") : args.coffFilename;
+
+		u64 coffSize = 0;
+		if((!args.compact || coffFile.Compact()) && coffFile.Save(coffFilename, coffSize))
+		{
+			textStream << "COFF written\n";
+			textStream << "Filename: " << coffFilename.c_str() << "\n";
+			textStream << "Size: " << coffSize << " bytes\n";
+			textStream << "Symbols: " << coffFile.GetSymbols().size() << "\n";
+			textStream << "Lines: " << coffFile.GetLineTable().GetCount() << "\n";
+		}
+		else
+		{
+			textStream << "Error: " << coffFile.GetError().c_str() << "\n";
+		}
+	}
+}
+
+void RunServer(const std::vector<std::string>& filenames, const Arguments& args, OutputStream& textStream)
+{
+	SymbolServer server;
+
+	//Load all files, kept resident for the server's lifetime
+	std::vector<FileCOFF*> serverFiles;
+	bool serverFilesLoaded = true;
+
+	for(int i = 0; i < filenames.size() && serverFilesLoaded; i++)
+	{
+		FileCOFF* serverFile = new FileCOFF();
+		serverFiles.push_back(serverFile);
+
+		//Same sanity checks as ProcessFile, then decode everything up front, queries from all clients share the tables
+		if(!serverFile->Load(filenames[i], args.indexCache))
+		{
+			textStream << "Error: " << filenames[i].c_str() << ": " << serverFile->GetError().c_str() << "\n";
+			serverFilesLoaded = false;
+		}
+		else if(serverFile->m_fileHeader.machineType != COFF_MACHINE_68000 || serverFile->m_sectionHeaders.size() != COFF_SECTION_COUNT)
+		{
+			textStream << "Error: " << filenames[i].c_str() << " is not a SNASM68K COFF\n";
+			serverFilesLoaded = false;
+		}
+		else if(!serverFile->LoadSymbolTable() || !serverFile->LoadLineTable())
+		{
+			textStream << "Error: " << filenames[i].c_str() << ": " << serverFile->GetError().c_str() << "\n";
+			serverFilesLoaded = false;
+		}
+		else
+		{
+			serverFile->BuildSymbolNameIndex();
+			server.AddFile(filenames[i], serverFile);
+		}
 	}
 
-	if(filename.size() > 0 && !argError)
+	if(serverFilesLoaded)
 	{
-		//Open file (at end)
-		std::ifstream file(filename, std::ios::in | std::ios::binary | std::ios::ate);
-		if(file.is_open())
+		textStream << "Serving " << filenames.size() << " file(s) on " << args.socketPath.c_str() << "\n";
+
+		//Flush banner now, server blocks
+		textStream.Flush();
+		fflush(stdout);
+
+		int numThreads = (int)std::thread::hardware_concurrency();
+		if(server.Run(args.socketPath, numThreads))
 		{
-			//Get filesize
-			std::streampos fileSize = file.tellg();
+			textStream << "Server stopped\n";
+		}
+		else
+		{
+			textStream << "Error: " << server.GetError().c_str() << "\n";
+		}
+	}
 
-			//Alloc buffer
-			char* data = new char[fileSize];
+	for(int i = 0; i < serverFiles.size(); i++)
+	{
+		delete serverFiles[i];
+	}
+}
 
-			//Seek to start
-			file.seekg(0, std::ios::beg);
-			
-			//Read file
-			file.read(data, fileSize);
+int _tmain(int argc, _TCHAR* argv[])
+{
+#if defined(_WIN32)
+	//Binary output must not have line endings translated
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
 
-			//Close file
-			file.close();
+	OutputStream textStream(stdout);
 
-			//Serialise COFF file
-			FileCOFF coffFile;
-			Stream stream((char*)&data[0]);
-			stream.Serialise(coffFile);
+	//Args
+	std::vector<std::string> filenames;
+	Arguments args;
+	bool argError = false;
 
-			//Free buffer
-			delete data;
+	//Input filenames/patterns, up to first option
+	int argIdx = 1;
+	for(; argIdx < argc && argv[argIdx][0] != '-'; argIdx++)
+	{
+		ExpandInputPattern(argv[argIdx], filenames);
+	}
 
-			//Sanity checks
-			if(coffFile.m_fileHeader.machineType != COFF_MACHINE_68000)
+	//Tokenise remaining arguments
+	for(int i = argIdx; i < argc; i++)
+	{
+		if(_stricmp(argv[i], "-summary") == 0)
+			args.dumpSummary = true;
+		else if(_stricmp(argv[i], "-symbols") == 0)
+			args.dumpSymbols = true;
+		else if(_stricmp(argv[i], "-lines") == 0)
+			args.dumpLines = true;
+		else if(_stricmp(argv[i], "-format") == 0)
+		{
+			//Need format arg
+			if(i < (argc-1))
 			{
-				//Unsupported machine/processor type
-				textStream << "Unknown COFF machine/processor type, not a SNASM68K COFF";
+				i++;
+				if(!ParseOutputFormat(argv[i], args.format))
+					argError = true;
 			}
-			else if(coffFile.m_sectionHeaders.size() != COFF_SECTION_COUNT)
+		}
+		else if(_stricmp(argv[i], "-extractrom") == 0)
+		{
+			//Need filename arg
+			if(i < (argc - 1))
 			{
-				//SNASM2 COFF has a fixed number of sections
-				textStream << "Unsupported section count, not a SNASM68K COFF";
+				i++;
+				args.extractROM = true;
+				args.romFilename = argv[i];
 			}
-			else
+		}
+		else if(_stricmp(argv[i], "-rompad") == 0)
+			args.romOptions.padToPowerOfTwo = true;
+		else if(_stricmp(argv[i], "-romchecksum") == 0)
+			args.romOptions.fixChecksum = true;
+		else if(_stricmp(argv[i], "-rebase") == 0)
+		{
+			//Need address and filename args
+			if(i < (argc-2))
 			{
-				if(argDumpSummary)
-				{
-					//Dump file info
-					coffFile.Dump(textStream);
-				}
+				i++;
+				args.rebase = true;
 
-				if(argDumpSymbols)
-				{
-					//Dump symbols
-					textStream << "-------------------------------------" << std::endl;
-					textStream << "SYMBOLS" << std::endl;
-					textStream << "-------------------------------------" << std::endl;
+				if(!ParseHexAddress(argv[i], argv[i] + strlen(argv[i]), args.rebaseAddress))
+					argError = true;
 
-					for(int i = 0; i < coffFile.m_sortedSymbols.size(); i++)
-					{
-						textStream << "0x" << std::hex << coffFile.m_sortedSymbols[i].value << std::dec << "\t" << coffFile.m_sortedSymbols[i].name.c_str() << std::endl;
-					}
-				}
+				args.rebaseFilename = argv[++i];
+			}
+		}
+		else if(_stricmp(argv[i], "-writecoff") == 0)
+		{
+			//Need filename arg
+			if(i < (argc-1))
+			{
+				i++;
+				args.writeCOFF = true;
+				args.coffFilename = argv[i];
+			}
+		}
+		else if(_stricmp(argv[i], "-compact") == 0)
+			args.compact = true;
+		else if(_stricmp(argv[i], "-sizemap") == 0)
+			args.sizeMap = true;
+		else if(_stricmp(argv[i], "-sizemaptop") == 0)
+		{
+			//Need count arg
+			if(i < (argc-1))
+			{
+				i++;
+				args.sizeMapTop = strtoul(argv[i], NULL, 10);
+			}
+		}
+		else if(_stricmp(argv[i], "-diff") == 0)
+		{
+			//Need filename arg
+			if(i < (argc-1))
+			{
+				i++;
+				args.diff = true;
+				args.diffFilename = argv[i];
+			}
+		}
+		else if(_stricmp(argv[i], "-disasm") == 0)
+		{
+			args.disassemble = true;
+
+			//Optional address range args
+			if(i < (argc-2) && argv[i+1][0] != '-' && argv[i+2][0] != '-')
+			{
+				const char* start = argv[++i];
+				const char* end = argv[++i];
+
+				if(!ParseHexAddress(start, start + strlen(start), args.disassembleStart) || !ParseHexAddress(end, end + strlen(end), args.disassembleEnd))
+					argError = true;
+				else if(args.disassembleStart > args.disassembleEnd)
+					argError = true;
+			}
+		}
+		else if(_stricmp(argv[i], "-addr2line") == 0)
+		{
+			//Need address arg
+			if(i < (argc-1))
+			{
+				i++;
+				args.addressToLine = true;
 
-				if(argExtractROM)
+				if(!ParseHexAddress(argv[i], argv[i] + strlen(argv[i]), args.address))
+					argError = true;
+			}
+		}
+		else if(_stricmp(argv[i], "-addr2linebatch") == 0)
+		{
+			//Need filename arg
+			if(i < (argc-1))
+			{
+				i++;
+				args.addressToLineBatch = true;
+				args.addressFilename = argv[i];
+			}
+		}
+		else if(_stricmp(argv[i], "-sym2addr") == 0)
+		{
+			//Need name arg
+			if(i < (argc-1))
+			{
+				i++;
+				args.symbolToAddress = true;
+				args.symbolName = argv[i];
+			}
+		}
+		else if(_stricmp(argv[i], "-sym2addrbatch") == 0)
+		{
+			//Need filename arg
+			if(i < (argc-1))
+			{
+				i++;
+				args.symbolToAddressBatch = true;
+				args.symbolFilename = argv[i];
+			}
+		}
+		else if(_stricmp(argv[i], "-profile") == 0)
+		{
+			//Need filename arg
+			if(i < (argc-1))
+			{
+				i++;
+				args.profile = true;
+				args.profileFilename = argv[i];
+			}
+		}
+		else if(_stricmp(argv[i], "-profiletop") == 0)
+		{
+			//Need count arg
+			if(i < (argc-1))
+			{
+				i++;
+				args.profileTop = strtoul(argv[i], NULL, 10);
+			}
+		}
+		else if(_stricmp(argv[i], "-server") == 0)
+		{
+			//Need socket path arg
+			if(i < (argc-1))
+			{
+				i++;
+				args.server = true;
+				args.socketPath = argv[i];
+			}
+		}
+		else if(_stricmp(argv[i], "-serverfile") == 0)
+		{
+			//Need filename arg
+			if(i < (argc-1))
+			{
+				i++;
+				args.serverFilenames.push_back(argv[i]);
+			}
+		}
+		else if(_stricmp(argv[i], "-filelist") == 0)
+		{
+			//Need filename arg
+			if(i < (argc-1))
+			{
+				i++;
+				std::vector<std::string> listedFilenames;
+				if(ReadNameList(argv[i], listedFilenames))
 				{
-					//Extract ROM
-					std::ofstream outFile(argROMFilename, std::ios::out | std::ios::binary);
-					if(outFile.is_open())
-					{
-						u8* romData = coffFile.m_sectionHeaders[COFF_SECTION_ROM_DATA].data;
-						u32 romSize = coffFile.m_sectionHeaders[COFF_SECTION_ROM_DATA].size;
-						
-						outFile.write((const char*)romData, romSize);
-						outFile.close();
-
-						textStream << "ROM extracted" << std::endl;
-						textStream << "Filename: " << argROMFilename.c_str() << std::endl;
-						textStream << "Size: " << romSize << " bytes" << std::endl;
-					}
-					else
-					{
-						textStream << "Error: Could not create file " << argROMFilename.c_str() << std::endl;
-					}
+					for(int j = 0; j < listedFilenames.size(); j++)
+						ExpandInputPattern(listedFilenames[j], filenames);
 				}
+				else
+				{
+					textStream << "Error: Could not open file list " << argv[i] << "\n";
+					argError = true;
+				}
+			}
+		}
+		else if(_stricmp(argv[i], "-outdir") == 0)
+		{
+			//Need directory arg
+			if(i < (argc-1))
+			{
+				i++;
+				args.outputDirectory = argv[i];
+			}
+		}
+		else if(_stricmp(argv[i], "-threads") == 0)
+		{
+			//Need count arg
+			if(i < (argc-1))
+			{
+				i++;
+				args.numThreads = atoi(argv[i]);
+			}
+		}
+		else if(_stricmp(argv[i], "-indexcache") == 0)
+			args.indexCache = true;
+		else if(_stricmp(argv[i], "-stats") == 0)
+		{
+			args.stats = true;
+			s_countAllocations = true;
+		}
+		else
+		{
+			argError = true;
+		}
+	}
+
+	//Compaction only applies to the written file
+	if(args.compact && !args.writeCOFF)
+	{
+		argError = true;
+	}
+
+	//Binary output is for table dumps only
+	if(args.format == FORMAT_BINARY && (args.addressToLine || args.addressToLineBatch || args.symbolToAddress || args.symbolToAddressBatch || args.profile || args.sizeMap || args.diff || args.disassemble || args.server || args.stats))
+	{
+		argError = true;
+	}
+
+	if(filenames.empty() || argError || (!HasFileOperation(args) && !args.server))
+	{
+		//No input, no operation specified, or arg error, print usage
+		PrintBanner(textStream);
+		PrintUsage(textStream);
+		argError = true;
+	}
+	else if(args.format == FORMAT_TEXT)
+	{
+		PrintBanner(textStream);
+	}
 
-				if(argAddressToLine)
+	//Read batch inputs once, shared by all files
+	std::string addressError;
+	if(!argError && args.addressToLineBatch && !ReadAddressList(args.addressFilename, args.addresses, addressError))
+	{
+		textStream << "Error: " << addressError.c_str() << "\n";
+		argError = true;
+	}
+
+	if(!argError && args.symbolToAddressBatch && !ReadNameList(args.symbolFilename, args.names))
+	{
+		textStream << "Error: Could not open symbol file " << args.symbolFilename.c_str() << "\n";
+		argError = true;
+	}
+
+	//Base build for -diff, decoded up front so workers only read it
+	FileCOFF diffFile;
+	if(!argError && args.diff)
+	{
+		if(!diffFile.Load(args.diffFilename, args.indexCache) || !diffFile.LoadSymbolTable() || !diffFile.LoadLineTable())
+		{
+			textStream << "Error: " << args.diffFilename.c_str() << ": " << diffFile.GetError().c_str() << "\n";
+			argError = true;
+		}
+		else if(diffFile.m_fileHeader.machineType != COFF_MACHINE_68000 || diffFile.m_sectionHeaders.size() != COFF_SECTION_COUNT)
+		{
+			textStream << "Error: " << args.diffFilename.c_str() << " is not a SNASM68K COFF\n";
+			argError = true;
+		}
+
+		args.diffBase = &diffFile;
+	}
+
+	if(!argError && args.profile)
+	{
+		u32 numThreads = (args.numThreads > 0) ? args.numThreads : std::thread::hardware_concurrency();
+		std::string profileError;
+		if(!ReadProfileSamples(args.profileFilename, numThreads, args.profileHistogram, profileError))
+		{
+			textStream << "Error: " << profileError.c_str() << "\n";
+			argError = true;
+		}
+	}
+
+	//The server loads its own resident copies, nothing to do per file if it's the only operation
+	bool processFiles = !argError && HasFileOperation(args);
+
+	if(processFiles && filenames.size() == 1 && args.outputDirectory.empty())
+	{
+		//Single file, stream straight out
+		ProcessFile(filenames[0], args, false, textStream);
+	}
+	else if(processFiles)
+	{
+		bool multipleFiles = filenames.size() > 1;
+
+		//Per-file output when concatenating, or status line when writing to output directory
+		std::vector<std::string> fileOutputs(filenames.size());
+		std::vector<bool> fileDone(filenames.size(), false);
+		std::mutex fileDoneMutex;
+		std::condition_variable fileDoneCondition;
+
+		//Process files in parallel, workers take the next file from a shared counter
+		int numThreads = (args.numThreads > 0) ? args.numThreads : (int)std::thread::hardware_concurrency();
+		numThreads = std::max(1, std::min(numThreads, (int)filenames.size()));
+
+		std::atomic<int> nextFile(0);
+		std::vector<std::thread> workers;
+
+		for(int i = 0; i < numThreads; i++)
+		{
+			workers.push_back(std::thread([&]()
+			{
+				for(int fileIdx = nextFile++; fileIdx < (int)filenames.size(); fileIdx = nextFile++)
 				{
-					//Find line
-					std::map<u32, FileCOFF::LineNumberEntry>::iterator it = coffFile.m_lineNumberAddressMap.find(argAddress);
-					if(it == coffFile.m_lineNumberAddressMap.end())
-					{
-						//Line/symbol not found
-						textStream << "Symbol at address 0x" << std::hex << argAddress << std::dec << " not found" << std::endl;
-					}
-					else
-					{
-						//Line found, get nearest symbol
-						std::string nearestSymbol = "Not found";
-						FileCOFF::Symbol findSymbol;
-						findSymbol.value = argAddress;
-						auto symbolIt = std::lower_bound(coffFile.m_sortedSymbols.begin(), coffFile.m_sortedSymbols.end(), findSymbol);
+					std::string fileOutput;
 
-						textStream << "Address 0x" << std::hex << argAddress << std::dec << std::endl;
-						textStream << "Filename: " << it->second.filename->c_str() << std::endl;
-						textStream << "Line: " << it->second.lineNumber << std::endl;
+					if(!args.outputDirectory.empty())
+					{
+						//Stream to own destination
+						std::string outFilename = args.outputDirectory + "/" + GetBaseName(filenames[fileIdx]) + ".txt";
+						FILE* outFile = fopen(outFilename.c_str(), "wb");
+						OutputStream statusStream(&fileOutput);
 
-						if(symbolIt != coffFile.m_sortedSymbols.end())
+						if(outFile)
 						{
-							//Get last symbol
-							symbolIt--;
+							{
+								OutputStream outStream(outFile);
+								ProcessFile(filenames[fileIdx], args, multipleFiles, outStream);
+							}
 
-							textStream << "Nearest symbol name: " << symbolIt->name.c_str() << std::endl;
-							textStream << "Nearest symbol address: " << std::hex << symbolIt->value << std::dec << std::endl;
+							fclose(outFile);
+							statusStream << filenames[fileIdx] << " -> " << outFilename << "\n";
 						}
 						else
 						{
-							textStream << "Nearest symbol: Not found" << std::endl;
+							statusStream << "Error: Could not create file " << outFilename << "\n";
 						}
 					}
+					else
+					{
+						OutputStream outStream(&fileOutput);
+						ProcessFile(filenames[fileIdx], args, multipleFiles, outStream);
+					}
+
+					std::lock_guard<std::mutex> lock(fileDoneMutex);
+					fileOutputs[fileIdx].swap(fileOutput);
+					fileDone[fileIdx] = true;
+					fileDoneCondition.notify_all();
 				}
+			}));
+		}
+
+		//Output in input order as soon as each file is ready
+		for(int i = 0; i < filenames.size(); i++)
+		{
+			std::string fileOutput;
+
+			{
+				std::unique_lock<std::mutex> lock(fileDoneMutex);
+				while(!fileDone[i])
+				{
+					fileDoneCondition.wait(lock);
+				}
+
+				fileOutput.swap(fileOutputs[i]);
+			}
+
+			if(multipleFiles && args.outputDirectory.empty() && args.format == FORMAT_TEXT)
+			{
+				textStream << "-------------------------------------\n";
+				textStream << "FILE: " << filenames[i] << "\n";
+				textStream << "-------------------------------------\n";
 			}
+
+			textStream << fileOutput;
+		}
+
+		for(int i = 0; i < workers.size(); i++)
+		{
+			workers[i].join();
+		}
+	}
+
+	if(!argError)
+	{
+		if(args.server)
+		{
+			//Serve all inputs, plus any extra server files
+			std::vector<std::string> serverFilenames = filenames;
+			serverFilenames.insert(serverFilenames.end(), args.serverFilenames.begin(), args.serverFilenames.end());
+			RunServer(serverFilenames, args, textStream);
 		}
 	}
 
-	//Dump to TTY
-	std::cout << textStream.str() << std::endl;
+	if(args.format == FORMAT_TEXT)
+	{
+		textStream << "\n";
+	}
 
 	return 0;
 }
-
@@ -0,0 +1,367 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#include <algorithm>
+
+#include "SizeMap.h"
+#include "ROMExtract.h"
+
+//Span being measured in one section, closed when the next symbol in the section starts
+struct OpenSpan
+{
+	OpenSpan()
+	{
+		open = false;
+		symbolIndex = 0;
+		address = 0;
+		cursor = 0;
+	}
+
+	bool open;
+	u32 symbolIndex;
+	u32 address;
+
+	//End of the bytes accounted for so far
+	u32 cursor;
+};
+
+static void AddGap(SizeMap& sizeMap, u32 sectionIdx, u32 address, u32 endAddress)
+{
+	if(endAddress > address)
+	{
+		SizeMapSpan gap = { sectionIdx, address, endAddress - address };
+		sizeMap.gaps.push_back(gap);
+	}
+}
+
+static void CloseSpan(const FileCOFF& coffFile, SizeMap& sizeMap, SizeMapSection& section, OpenSpan& openSpan, u32 nextAddress)
+{
+	const FileCOFF::Symbol& symbol = coffFile.GetSymbols()[openSpan.symbolIndex];
+
+	AddGap(sizeMap, section.sectionIdx, openSpan.cursor, openSpan.address);
+
+	//Up to the next symbol, or just the function if its size is known
+	u32 size = nextAddress - openSpan.address;
+	if(symbol.size > 0 && symbol.size < size)
+		size = symbol.size;
+
+	SizeMapSpan span = { openSpan.symbolIndex, openSpan.address, size };
+	sizeMap.symbols.push_back(span);
+
+	section.usedSize += size;
+	section.numSymbols++;
+	openSpan.cursor = openSpan.address + size;
+	openSpan.open = false;
+}
+
+void BuildSizeMap(const FileCOFF& coffFile, SizeMap& sizeMap)
+{
+	const std::vector<FileCOFF::SectionHeader>& sectionHeaders = coffFile.m_sectionHeaders;
+	const ArrayView<FileCOFF::Symbol>& symbols = coffFile.GetSymbols();
+	const ArrayView<u32>& sortedIndices = coffFile.GetSortedSymbolIndices();
+	const FileCOFF::LineTable& lineTable = coffFile.GetLineTable();
+
+	sizeMap = SizeMap();
+
+	//Loaded sections, by 1-based symbol section index. The filenames section isn't loaded.
+	std::vector<int> sectionSlots(sectionHeaders.size() + 1, -1);
+
+	for(u32 i = 0; i < sectionHeaders.size(); i++)
+	{
+		if(i != COFF_SECTION_FILENAMES && sectionHeaders[i].size > 0)
+		{
+			//Clamped to the end of the address space
+			u32 address = sectionHeaders[i].physicalAddr;
+			u32 size = std::min(sectionHeaders[i].size, 0xFFFFFFFF - address);
+
+			SizeMapSection section = { i, address, size, 0, 0 };
+			sectionSlots[i + 1] = (int)sizeMap.sections.size();
+			sizeMap.sections.push_back(section);
+			sizeMap.totalSize += section.size;
+		}
+	}
+
+	std::vector<OpenSpan> openSpans(sizeMap.sections.size());
+	for(u32 i = 0; i < sizeMap.sections.size(); i++)
+	{
+		openSpans[i].cursor = sizeMap.sections[i].address;
+	}
+
+	//Address order, best ranked symbol first at each address
+	for(u32 i = 0; i < sortedIndices.size(); i++)
+	{
+		u32 symbolIndex = sortedIndices[i];
+		const FileCOFF::Symbol& symbol = symbols[symbolIndex];
+
+		if(symbol.sectionIndex <= 0 || symbol.sectionIndex >= (s16)sectionSlots.size() || sectionSlots[symbol.sectionIndex] < 0)
+			continue;
+
+		int slot = sectionSlots[symbol.sectionIndex];
+		SizeMapSection& section = sizeMap.sections[slot];
+		OpenSpan& openSpan = openSpans[slot];
+
+		//Section symbols span the whole section, and anything outside the section has no bytes in it
+		if(coffFile.IsSectionSymbol(symbol) || symbol.value < section.address || (symbol.value - section.address) >= section.size)
+			continue;
+
+		if(openSpan.open)
+		{
+			//Alias of the span's owner, or a label inside a function of known size
+			u32 ownerSize = symbols[openSpan.symbolIndex].size;
+			if(symbol.value == openSpan.address || (symbol.value - openSpan.address) < ownerSize)
+				continue;
+
+			CloseSpan(coffFile, sizeMap, section, openSpan, symbol.value);
+		}
+
+		openSpan.open = true;
+		openSpan.symbolIndex = symbolIndex;
+		openSpan.address = symbol.value;
+	}
+
+	for(u32 i = 0; i < sizeMap.sections.size(); i++)
+	{
+		SizeMapSection& section = sizeMap.sections[i];
+		u32 endAddress = section.address + section.size;
+
+		if(openSpans[i].open)
+			CloseSpan(coffFile, sizeMap, section, openSpans[i], endAddress);
+
+		AddGap(sizeMap, section.sectionIdx, openSpans[i].cursor, endAddress);
+	}
+
+	//Charge each span to the file of its first line. Spans and lines are both in address order
+	//(spans per section), so one cursor walks the line table, restarting only if a section goes backwards.
+	u32 numFiles = coffFile.GetNumLineFilenames();
+	std::vector<u64> fileSizes(numFiles, 0);
+	u64 unknownFileSize = 0;
+	u32 line = 0;
+	u32 previousAddress = 0;
+
+	for(u32 i = 0; i < sizeMap.symbols.size(); i++)
+	{
+		const SizeMapSpan& span = sizeMap.symbols[i];
+
+		if(span.address < previousAddress)
+			line = (u32)(std::upper_bound(lineTable.addresses.begin(), lineTable.addresses.end(), span.address) - lineTable.addresses.begin());
+
+		while(line < lineTable.GetCount() && lineTable.addresses[line] <= span.address)
+			line++;
+
+		previousAddress = span.address;
+
+		if(line > 0 && span.address < lineTable.endAddresses[line - 1] && lineTable.fileIndices[line - 1] < numFiles)
+			fileSizes[lineTable.fileIndices[line - 1]] += span.size;
+		else
+			unknownFileSize += span.size;
+	}
+
+	for(u32 i = 0; i < numFiles; i++)
+	{
+		if(fileSizes[i] > 0)
+		{
+			SizeMapSpan file = { i, 0, (u32)fileSizes[i] };
+			sizeMap.files.push_back(file);
+		}
+	}
+
+	if(unknownFileSize > 0)
+	{
+		SizeMapSpan file = { (u32)-1, 0, (u32)unknownFileSize };
+		sizeMap.files.push_back(file);
+	}
+
+	if(sectionHeaders.size() > COFF_SECTION_ROM_DATA)
+	{
+		sizeMap.romSize = sectionHeaders[COFF_SECTION_ROM_DATA].size;
+		sizeMap.paddedROMSize = GetPaddedROMSize(sizeMap.romSize);
+	}
+}
+
+//Indices of the largest spans, biggest first, then by address and index
+static void SelectLargest(const std::vector<SizeMapSpan>& spans, u32 maxRows, std::vector<u32>& order)
+{
+	order.resize(spans.size());
+	for(u32 i = 0; i < spans.size(); i++)
+	{
+		order[i] = i;
+	}
+
+	u32 numRows = (maxRows > 0 && maxRows < spans.size()) ? maxRows : (u32)spans.size();
+
+	std::partial_sort(order.begin(), order.begin() + numRows, order.end(), [&spans](u32 lhs, u32 rhs)
+	{
+		const SizeMapSpan& left = spans[lhs];
+		const SizeMapSpan& right = spans[rhs];
+
+		if(left.size != right.size)
+			return left.size > right.size;
+		if(left.address != right.address)
+			return left.address < right.address;
+
+		return left.index < right.index;
+	});
+
+	order.resize(numRows);
+}
+
+enum SizeMapTable
+{
+	SIZEMAP_TABLE_SYMBOLS,
+	SIZEMAP_TABLE_FILES,
+	SIZEMAP_TABLE_GAPS
+};
+
+static void WriteSpanTable(const FileCOFF& coffFile, const SizeMap& sizeMap, SizeMapTable table, u32 maxRows, OutputFormat format, OutputStream& stream)
+{
+	static const char* tableNames[] = { "symbol", "file", "gap" };
+	static const char* textHeaders[] = { "Size\tPercent\tAddress\tSymbol\n", "Size\tPercent\tFile\n", "Size\tPercent\tAddress\tGap in section\n" };
+	static const char* jsonTypes[] = { "sizemapSymbol", "sizemapFile", "sizemapGap" };
+	static const char* jsonNames[] = { "name", "filename", "section" };
+
+	const std::vector<SizeMapSpan>& spans = (table == SIZEMAP_TABLE_SYMBOLS) ? sizeMap.symbols : ((table == SIZEMAP_TABLE_FILES) ? sizeMap.files : sizeMap.gaps);
+	bool hasAddress = (table != SIZEMAP_TABLE_FILES);
+
+	std::vector<u32> order;
+	SelectLargest(spans, maxRows, order);
+
+	if(format == FORMAT_TEXT)
+	{
+		stream << textHeaders[table];
+	}
+
+	for(u32 i = 0; i < order.size(); i++)
+	{
+		const SizeMapSpan& span = spans[order[i]];
+		bool named = (span.index != (u32)-1);
+		const char* name = "??";
+
+		if(table == SIZEMAP_TABLE_SYMBOLS)
+			name = coffFile.GetSymbolName(coffFile.GetSymbols()[span.index]);
+		else if(table == SIZEMAP_TABLE_FILES && named)
+			name = coffFile.GetLineFilename(span.index);
+		else if(table == SIZEMAP_TABLE_GAPS)
+			name = coffFile.m_sectionHeaders[span.index].name.c_str();
+
+		if(format == FORMAT_JSON)
+		{
+			stream << "{\"type\":\"" << jsonTypes[table] << "\",\"" << jsonNames[table] << "\":";
+
+			if(named)
+				WriteJSONString(name, stream);
+			else
+				stream << "null";
+
+			if(hasAddress)
+				stream << ",\"address\":" << span.address;
+
+			stream << ",\"size\":" << span.size << ",\"percent\":";
+			WritePercent(span.size, sizeMap.totalSize, stream);
+			stream << "}\n";
+		}
+		else if(format == FORMAT_CSV)
+		{
+			stream << tableNames[table] << ",";
+
+			if(named)
+				WriteCSVField(name, stream);
+
+			stream << ",";
+
+			if(hasAddress)
+				stream << span.address;
+
+			stream << "," << span.size << ",,";
+			WritePercent(span.size, sizeMap.totalSize, stream);
+			stream << "\n";
+		}
+		else
+		{
+			stream << span.size << "\t";
+			WritePercent(span.size, sizeMap.totalSize, stream);
+			stream << "%\t";
+
+			if(hasAddress)
+				stream << "0x" << Hex(span.address) << "\t";
+
+			stream << name << "\n";
+		}
+	}
+
+	if(format == FORMAT_TEXT)
+	{
+		stream << "\n";
+	}
+}
+
+void WriteSizeMap(const FileCOFF& coffFile, const SizeMap& sizeMap, u32 maxRows, OutputFormat format, OutputStream& stream)
+{
+	if(format == FORMAT_TEXT)
+	{
+		stream << "-------------------------------------\n";
+		stream << "SIZE MAP\n";
+		stream << "-------------------------------------\n";
+		stream << "Section\tAddress\tSize\tUsed\tFree\tUsed percent\n";
+	}
+	else if(format == FORMAT_CSV)
+	{
+		stream << "table,name,address,size,used,percent\n";
+	}
+
+	for(u32 i = 0; i < sizeMap.sections.size(); i++)
+	{
+		const SizeMapSection& section = sizeMap.sections[i];
+		const char* name = coffFile.m_sectionHeaders[section.sectionIdx].name.c_str();
+
+		if(format == FORMAT_JSON)
+		{
+			stream << "{\"type\":\"sizemapSection\",\"name\":";
+			WriteJSONString(name, stream);
+			stream << ",\"address\":" << section.address << ",\"size\":" << section.size << ",\"used\":" << section.usedSize;
+			stream << ",\"free\":" << (section.size - section.usedSize) << ",\"symbols\":" << section.numSymbols << ",\"percent\":";
+			WritePercent(section.usedSize, section.size, stream);
+			stream << "}\n";
+		}
+		else if(format == FORMAT_CSV)
+		{
+			stream << "section,";
+			WriteCSVField(name, stream);
+			stream << "," << section.address << "," << section.size << "," << section.usedSize << ",";
+			WritePercent(section.usedSize, section.size, stream);
+			stream << "\n";
+		}
+		else
+		{
+			stream << name << "\t0x" << Hex(section.address) << "\t" << section.size << "\t" << section.usedSize << "\t" << (section.size - section.usedSize) << "\t";
+			WritePercent(section.usedSize, section.size, stream);
+			stream << "%\n";
+		}
+	}
+
+	//Room left before the cartridge size has to double
+	if(format == FORMAT_JSON)
+	{
+		stream << "{\"type\":\"sizemapROM\",\"size\":" << sizeMap.romSize << ",\"paddedSize\":" << sizeMap.paddedROMSize << ",\"free\":" << (sizeMap.paddedROMSize - sizeMap.romSize) << "}\n";
+	}
+	else if(format == FORMAT_CSV)
+	{
+		stream << "rom,,," << sizeMap.paddedROMSize << "," << sizeMap.romSize << ",";
+		WritePercent(sizeMap.romSize, sizeMap.paddedROMSize, stream);
+		stream << "\n";
+	}
+	else
+	{
+		stream << "\n";
+		stream << "ROM size: " << sizeMap.romSize << " bytes\n";
+		stream << "Padded ROM size: " << sizeMap.paddedROMSize << " bytes (" << (sizeMap.paddedROMSize - sizeMap.romSize) << " bytes free)\n\n";
+	}
+
+	WriteSpanTable(coffFile, sizeMap, SIZEMAP_TABLE_SYMBOLS, maxRows, format, stream);
+	WriteSpanTable(coffFile, sizeMap, SIZEMAP_TABLE_FILES, maxRows, format, stream);
+	WriteSpanTable(coffFile, sizeMap, SIZEMAP_TABLE_GAPS, maxRows, format, stream);
+}
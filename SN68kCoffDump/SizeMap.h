@@ -0,0 +1,69 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#pragma once
+
+#include <vector>
+
+#include "FileCOFF.h"
+#include "OutputStream.h"
+#include "TableWriter.h"
+
+//Byte range owned by a symbol or file, or a gap in a section. Index is a symbol, file or
+//section header index, or -1 for bytes of no file.
+struct SizeMapSpan
+{
+	u32 index;
+	u32 address;
+	u32 size;
+};
+
+//Occupancy of one loaded section
+struct SizeMapSection
+{
+	u32 sectionIdx;
+	u32 address;
+	u32 size;
+	u32 usedSize;
+	u32 numSymbols;
+};
+
+struct SizeMap
+{
+	SizeMap()
+	{
+		totalSize = 0;
+		romSize = 0;
+		paddedROMSize = 0;
+	}
+
+	std::vector<SizeMapSection> sections;
+
+	//Symbol spans and gaps in address order within each section, file totals in file order
+	std::vector<SizeMapSpan> symbols;
+	std::vector<SizeMapSpan> files;
+	std::vector<SizeMapSpan> gaps;
+
+	//Sum of section sizes, percentages are of this
+	u64 totalSize;
+
+	//ROM section size, and the power of two size -rompad would pad it to
+	u32 romSize;
+	u32 paddedROMSize;
+};
+
+//One pass over the address sorted symbols. A symbol owns the bytes up to the next symbol in its section,
+//or only its aux record size if that's smaller, the rest is a gap. Labels inside a function of known size
+//are part of it. Symbols sharing an address are aliases, the first in sort order owns the span.
+//Each span is charged to the file of the line at its start address, walking the line table alongside.
+//Requires the symbol and line tables.
+void BuildSizeMap(const FileCOFF& coffFile, SizeMap& sizeMap);
+
+//Section occupancy, then the largest symbols, files and gaps, up to maxRows rows each, 0 for all.
+//Binary format is not supported.
+void WriteSizeMap(const FileCOFF& coffFile, const SizeMap& sizeMap, u32 maxRows, OutputFormat format, OutputStream& stream);
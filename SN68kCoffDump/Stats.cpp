@@ -0,0 +1,245 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#include <cstring>
+#include <string>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#include "Stats.h"
+
+//Per thread, so files processed in parallel count only their own
+static thread_local AllocationStats s_threadAllocations;
+
+u64 GetPeakMemoryKB()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return counters.PeakWorkingSetSize / 1024;
+	}
+
+	return 0;
+#else
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0;
+	}
+
+#if defined(__APPLE__)
+	return usage.ru_maxrss / 1024;
+#else
+	return usage.ru_maxrss;
+#endif
+#endif
+}
+
+void CountAllocation(u64 size)
+{
+	s_threadAllocations.numAllocations++;
+	s_threadAllocations.bytesAllocated += size;
+}
+
+AllocationStats GetAllocationStats()
+{
+	return s_threadAllocations;
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+	memset(m_buckets, 0, sizeof(m_buckets));
+	m_count = 0;
+	m_totalNs = 0;
+	m_minNs = (u64)-1;
+	m_maxNs = 0;
+}
+
+void LatencyHistogram::Add(u64 ns)
+{
+	//Bucket is the bit length
+	u32 bucket = 0;
+	for(u64 value = ns; value; value >>= 1)
+	{
+		bucket++;
+	}
+
+	m_buckets[bucket]++;
+	m_count++;
+	m_totalNs += ns;
+
+	if(ns < m_minNs)
+		m_minNs = ns;
+	if(ns > m_maxNs)
+		m_maxNs = ns;
+}
+
+u64 LatencyHistogram::GetBucketLimit(u32 bucket)
+{
+	return (bucket >= 64) ? (u64)-1 : ((1ull << bucket) - 1);
+}
+
+u64 LatencyHistogram::GetPercentile(u32 percent) const
+{
+	if(m_count == 0)
+	{
+		return 0;
+	}
+
+	//Rank of the sample, rounded up
+	u64 rank = (m_count * percent + 99) / 100;
+	if(rank == 0)
+		rank = 1;
+
+	u64 cumulative = 0;
+	for(u32 i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+	{
+		cumulative += m_buckets[i];
+		if(cumulative >= rank)
+		{
+			return (GetBucketLimit(i) < m_maxNs) ? GetBucketLimit(i) : m_maxNs;
+		}
+	}
+
+	return m_maxNs;
+}
+
+ProcessStats::ProcessStats()
+{
+	wallNs = 0;
+	allocations.numAllocations = 0;
+	allocations.bytesAllocated = 0;
+}
+
+static void WriteStat(const std::string& name, u64 value, const char* unit, OutputFormat format, OutputStream& stream)
+{
+	if(format == FORMAT_JSON)
+	{
+		stream << "{\"type\":\"stat\",\"name\":";
+		WriteJSONString(name.c_str(), stream);
+		stream << ",\"value\":" << value << ",\"unit\":";
+		WriteJSONString(unit, stream);
+		stream << "}\n";
+	}
+	else if(format == FORMAT_CSV)
+	{
+		WriteCSVField(name.c_str(), stream);
+		stream << "," << value << ",";
+		WriteCSVField(unit, stream);
+		stream << "\n";
+	}
+	else
+	{
+		stream << name;
+		for(u32 i = (u32)name.size(); i < 40; i++)
+			stream << " ";
+		stream << value;
+		if(unit[0])
+			stream << " " << unit;
+		stream << "\n";
+	}
+}
+
+static void WriteLatencyStats(const char* queryName, const LatencyHistogram& histogram, OutputFormat format, OutputStream& stream)
+{
+	if(histogram.GetCount() == 0)
+	{
+		return;
+	}
+
+	std::string prefix = std::string("latency.") + queryName + ".";
+
+	WriteStat(prefix + "count", histogram.GetCount(), "queries", format, stream);
+	WriteStat(prefix + "min", histogram.GetMin(), "ns", format, stream);
+	WriteStat(prefix + "mean", histogram.GetMean(), "ns", format, stream);
+	WriteStat(prefix + "p50", histogram.GetPercentile(50), "ns", format, stream);
+	WriteStat(prefix + "p90", histogram.GetPercentile(90), "ns", format, stream);
+	WriteStat(prefix + "p99", histogram.GetPercentile(99), "ns", format, stream);
+	WriteStat(prefix + "max", histogram.GetMax(), "ns", format, stream);
+
+	for(u32 i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+	{
+		if(histogram.GetBucketCount(i) > 0)
+		{
+			//Inclusive upper bound in the name
+			std::string bucketName;
+
+			{
+				OutputStream nameStream(&bucketName);
+				nameStream << prefix << "le_" << LatencyHistogram::GetBucketLimit(i) << "ns";
+			}
+
+			WriteStat(bucketName, histogram.GetBucketCount(i), "queries", format, stream);
+		}
+	}
+}
+
+void WriteStats(const FileCOFF& coffFile, const ProcessStats& stats, OutputFormat format, OutputStream& stream)
+{
+	if(format == FORMAT_TEXT)
+	{
+		stream << "-------------------------------------\n";
+		stream << "STATS\n";
+		stream << "-------------------------------------\n";
+	}
+	else if(format == FORMAT_CSV)
+	{
+		stream << "name,value,unit\n";
+	}
+
+	const FileCOFF::LoadStats& loadStats = coffFile.GetLoadStats();
+
+	WriteStat("load.map", loadStats.mapNs, "ns", format, stream);
+	WriteStat("load.symbol_records", loadStats.symbolRecordsNs, "ns", format, stream);
+	WriteStat("load.symbol_names", loadStats.symbolNamesNs, "ns", format, stream);
+	WriteStat("load.symbol_sort", loadStats.symbolSortNs, "ns", format, stream);
+	WriteStat("load.filenames", loadStats.filenamesNs, "ns", format, stream);
+	WriteStat("load.line_records", loadStats.lineRecordsNs, "ns", format, stream);
+	WriteStat("load.line_sort", loadStats.lineSortNs, "ns", format, stream);
+	WriteStat("load.relocations", loadStats.relocationsNs, "ns", format, stream);
+	WriteStat("load.index_cache_read", loadStats.indexCacheReadNs, "ns", format, stream);
+	WriteStat("load.index_cache_write", loadStats.indexCacheWriteNs, "ns", format, stream);
+	WriteStat("load.name_index", loadStats.nameIndexNs, "ns", format, stream);
+	WriteStat("wall", stats.wallNs, "ns", format, stream);
+
+	//Records as decoded, aux records counted through their symbols
+	const ArrayView<FileCOFF::Symbol>& symbols = coffFile.GetSymbols();
+	u64 numAuxRecords = 0;
+	for(u32 i = 0; i < symbols.size(); i++)
+	{
+		numAuxRecords += symbols[i].auxCount;
+	}
+
+	u64 numRelocations = 0;
+	for(u32 i = 0; i < coffFile.m_sectionHeaders.size(); i++)
+	{
+		numRelocations += coffFile.m_sectionHeaders[i].numRelocationEntries;
+	}
+
+	WriteStat("records.sections", coffFile.m_sectionHeaders.size(), "", format, stream);
+	WriteStat("records.symbols", symbols.size(), "", format, stream);
+	WriteStat("records.aux", numAuxRecords, "", format, stream);
+	WriteStat("records.lines", coffFile.GetLineTable().GetCount(), "", format, stream);
+	WriteStat("records.files", coffFile.GetNumLineFilenames(), "", format, stream);
+	WriteStat("records.relocations", numRelocations, "", format, stream);
+
+	WriteStat("memory.allocations", stats.allocations.numAllocations, "", format, stream);
+	WriteStat("memory.allocated", stats.allocations.bytesAllocated, "bytes", format, stream);
+	WriteStat("memory.peak_rss", GetPeakMemoryKB(), "KB", format, stream);
+
+	WriteLatencyStats("addr2line", stats.addressQueries, format, stream);
+	WriteLatencyStats("sym2addr", stats.nameQueries, format, stream);
+}
@@ -0,0 +1,73 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#pragma once
+
+#include "FileCOFF.h"
+#include "OutputStream.h"
+#include "TableWriter.h"
+#include "timeutils.h"
+
+//Peak resident set of the process so far, 0 if unknown
+u64 GetPeakMemoryKB();
+
+//Heap allocations made by the calling thread, counted by a replaced operator new calling CountAllocation().
+//Stay zero in programs that don't replace it, or only count when asked, as sn68kcoffdump does for -stats.
+struct AllocationStats
+{
+	u64 numAllocations;
+	u64 bytesAllocated;
+};
+
+void CountAllocation(u64 size);
+AllocationStats GetAllocationStats();
+
+//Query latencies in power of two nanosecond buckets, bucket i holding [2^(i-1), 2^i)
+#define LATENCY_HISTOGRAM_BUCKETS	65
+
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+
+	void Add(u64 ns);
+
+	u64 GetCount() const { return m_count; }
+	u64 GetMin() const { return m_count ? m_minNs : 0; }
+	u64 GetMax() const { return m_maxNs; }
+	u64 GetMean() const { return m_count ? (m_totalNs / m_count) : 0; }
+
+	//Upper bound of the bucket holding the percentile, clamped to the maximum
+	u64 GetPercentile(u32 percent) const;
+
+	u64 GetBucketCount(u32 bucket) const { return m_buckets[bucket]; }
+	static u64 GetBucketLimit(u32 bucket);
+
+private:
+	u64 m_buckets[LATENCY_HISTOGRAM_BUCKETS];
+	u64 m_count;
+	u64 m_totalNs;
+	u64 m_minNs;
+	u64 m_maxNs;
+};
+
+//Everything -stats reports for one processed file, besides the file's own load stats
+struct ProcessStats
+{
+	ProcessStats();
+
+	u64 wallNs;
+	AllocationStats allocations;
+	LatencyHistogram addressQueries;
+	LatencyHistogram nameQueries;
+};
+
+//Flat name/value/unit metrics: load phase times, record counts, allocations, peak memory, then latency
+//percentiles and non-empty buckets of query modes that ran. Text is one aligned metric per line, JSON one
+//"stat" object per metric, CSV a name,value,unit row per metric. Binary format is not supported.
+void WriteStats(const FileCOFF& coffFile, const ProcessStats& stats, OutputFormat format, OutputStream& stream);
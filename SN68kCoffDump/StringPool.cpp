@@ -0,0 +1,146 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#include <algorithm>
+#include <cstring>
+
+#include "StringPool.h"
+
+StringPool::StringPool()
+{
+	Clear();
+}
+
+void StringPool::Clear()
+{
+	m_arena.assign(1, 0);
+	m_buckets.assign(16, Bucket());
+	m_numStrings = 0;
+	m_data = &m_arena[0];
+	m_size = 1;
+	m_external = NULL;
+	m_externalSize = 0;
+}
+
+void StringPool::Reserve(u32 numStrings, u32 numBytes)
+{
+	m_arena.reserve(numBytes + 1);
+	m_data = &m_arena[0];
+
+	//Keep at most half full
+	u32 numBuckets = (u32)m_buckets.size();
+	while(numBuckets < numStrings * 2)
+	{
+		numBuckets <<= 1;
+	}
+
+	if(numBuckets > m_buckets.size())
+	{
+		m_buckets.resize(numBuckets);
+		Grow();
+	}
+}
+
+void StringPool::SetView(const char* data, u32 size)
+{
+	m_arena.clear();
+	m_buckets.clear();
+	m_numStrings = 0;
+	m_data = data;
+	m_size = size;
+}
+
+void StringPool::SetExternal(const char* data, u32 size)
+{
+	m_external = data;
+	m_externalSize = size;
+}
+
+u32 StringPool::Add(const char* string)
+{
+	return Add(string, (u32)strlen(string));
+}
+
+u32 StringPool::Add(const char* string, u32 length)
+{
+	if(length == 0)
+	{
+		return 0;
+	}
+
+	u32 mask = (u32)m_buckets.size() - 1;
+	u32 hash = Hash(string, length);
+	u32 bucket = hash & mask;
+
+	//Linear probe for an equal string
+	while(m_buckets[bucket].handle != 0)
+	{
+		if(m_buckets[bucket].hash == hash)
+		{
+			const char* existing = m_data + m_buckets[bucket].handle - 1;
+			if(memcmp(existing, string, length) == 0 && existing[length] == 0)
+			{
+				return m_buckets[bucket].handle - 1;
+			}
+		}
+
+		bucket = (bucket + 1) & mask;
+	}
+
+	u32 handle = (u32)m_arena.size();
+	m_arena.insert(m_arena.end(), string, string + length);
+	m_arena.push_back(0);
+	m_data = &m_arena[0];
+	m_size = (u32)m_arena.size();
+
+	m_buckets[bucket].hash = hash;
+	m_buckets[bucket].handle = handle + 1;
+	m_numStrings++;
+
+	if(m_numStrings * 2 > m_buckets.size())
+	{
+		m_buckets.resize(m_buckets.size() * 2);
+		Grow();
+	}
+
+	return handle;
+}
+
+void StringPool::Grow()
+{
+	//Rehash all handles into the resized bucket array
+	u32 mask = (u32)m_buckets.size() - 1;
+	std::fill(m_buckets.begin(), m_buckets.end(), Bucket());
+
+	for(u32 handle = 1; handle < m_size;)
+	{
+		u32 length = (u32)strlen(m_data + handle);
+		u32 hash = Hash(m_data + handle, length);
+		u32 bucket = hash & mask;
+		while(m_buckets[bucket].handle != 0)
+		{
+			bucket = (bucket + 1) & mask;
+		}
+
+		m_buckets[bucket].hash = hash;
+		m_buckets[bucket].handle = handle + 1;
+		handle += length + 1;
+	}
+}
+
+u32 StringPool::Hash(const char* string, u32 length)
+{
+	//FNV-1a
+	u32 hash = 0x811C9DC5;
+	for(u32 i = 0; i < length; i++)
+	{
+		hash = (hash ^ (u8)string[i]) * 0x01000193;
+	}
+
+	return hash;
+}
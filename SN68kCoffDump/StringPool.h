@@ -0,0 +1,75 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#pragma once
+
+#include <vector>
+
+#include "atoms.h"
+
+//Top handle bit selects the external string block
+#define STRING_POOL_EXTERNAL	0x80000000
+
+//Interned, NULL terminated strings in one contiguous arena. Each unique string is stored once
+//and referred to by a 32-bit handle, its byte offset in the arena. Handle 0 is the empty string.
+//Handles stay valid as the arena grows, pointers from Get() do not.
+//Strings that are already pooled elsewhere, like a COFF string table, can be attached as an
+//external block and referred to in place by offset, without copying or hashing.
+class StringPool
+{
+public:
+	StringPool();
+
+	//Returns handle of existing equal string, or appends it
+	u32 Add(const char* string, u32 length);
+	u32 Add(const char* string);
+
+	//Handle of a string at offset in the external block
+	static u32 GetExternalHandle(u32 offset) { return offset | STRING_POOL_EXTERNAL; }
+
+	const char* Get(u32 handle) const { return (handle & STRING_POOL_EXTERNAL) ? (m_external + (handle & ~STRING_POOL_EXTERNAL)) : (m_data + handle); }
+	bool IsValid(u32 handle) const { return (handle & STRING_POOL_EXTERNAL) ? ((handle & ~STRING_POOL_EXTERNAL) < m_externalSize) : (handle < m_size); }
+
+	//Uses existing pool data in place, e.g. from a mapped index. Data must be NULL terminated, and outlive the pool.
+	//Read only, Add() is not supported on a view.
+	void SetView(const char* data, u32 size);
+
+	//Attaches a block of NULL terminated strings, which must outlive the pool
+	void SetExternal(const char* data, u32 size);
+
+	void Reserve(u32 numStrings, u32 numBytes);
+	void Clear();
+
+	//Whole arena and external block, for saving
+	const char* GetData() const { return m_data; }
+	u32 GetSize() const { return m_size; }
+	const char* GetExternalData() const { return m_external; }
+	u32 GetExternalSize() const { return m_externalSize; }
+
+private:
+	static u32 Hash(const char* string, u32 length);
+	void Grow();
+
+	std::vector<char> m_arena;
+
+	//Open addressed hash of handle + 1, 0 is empty. Full hash kept alongside to skip most string compares.
+	struct Bucket
+	{
+		u32 hash;
+		u32 handle;
+	};
+
+	std::vector<Bucket> m_buckets;
+	u32 m_numStrings;
+
+	const char* m_data;
+	u32 m_size;
+
+	const char* m_external;
+	u32 m_externalSize;
+};
@@ -0,0 +1,579 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#include <sstream>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+
+#include "SymbolServer.h"
+#include "Query.h"
+
+#if !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#endif
+
+SymbolServer::SymbolServer()
+{
+	m_nextClientId = 0;
+	m_stopping = false;
+	m_wakePipe[0] = -1;
+	m_wakePipe[1] = -1;
+}
+
+void SymbolServer::AddFile(const std::string& filename, const FileCOFF* coffFile)
+{
+	m_filenames.push_back(filename);
+	m_files.push_back(coffFile);
+}
+
+bool SymbolServer::HandleRequest(const std::string& request, std::string& response) const
+{
+	std::istringstream requestStream(request);
+	std::string command;
+	requestStream >> command;
+
+	OutputStream responseStream(&response);
+
+	if(command.empty())
+	{
+		responseStream << "ERROR empty request\n";
+		return true;
+	}
+
+	if(command == "quit")
+	{
+		return false;
+	}
+	else if(command == "files")
+	{
+		responseStream << m_files.size() << "\n";
+		for(int i = 0; i < m_filenames.size(); i++)
+		{
+			responseStream << m_filenames[i] << "\n";
+		}
+	}
+	else if(command == "addr2line" || command == "sym2addr" || command == "romrange")
+	{
+		//Query argument, then optional file index
+		std::string argument;
+		if(command != "romrange")
+		{
+			requestStream >> argument;
+		}
+
+		int fileIndex = 0;
+		std::string fileIndexString;
+		if(requestStream >> fileIndexString)
+		{
+			fileIndex = atoi(fileIndexString.c_str());
+		}
+
+		if(command != "romrange" && argument.empty())
+		{
+			responseStream << "ERROR missing argument\n";
+		}
+		else if(fileIndex < 0 || fileIndex >= (int)m_files.size())
+		{
+			responseStream << "ERROR bad file index\n";
+		}
+		else if(command == "addr2line")
+		{
+			u32 address = 0;
+			if(ParseHexAddress(argument.c_str(), argument.c_str() + argument.size(), address))
+			{
+				WriteAddressQuery(*m_files[fileIndex], address, responseStream);
+				responseStream << "\n";
+			}
+			else
+			{
+				responseStream << "ERROR bad address\n";
+			}
+		}
+		else if(command == "sym2addr")
+		{
+			WriteSymbolQuery(*m_files[fileIndex], argument.c_str(), responseStream);
+			responseStream << "\n";
+		}
+		else
+		{
+			WriteROMRangeQuery(*m_files[fileIndex], responseStream);
+			responseStream << "\n";
+		}
+	}
+	else
+	{
+		responseStream << "ERROR unknown command\n";
+	}
+
+	return true;
+}
+
+#if defined(_WIN32)
+
+bool SymbolServer::Run(const std::string& socketPath, int numThreads)
+{
+	m_error = "Server mode is not supported on this platform";
+	return false;
+}
+
+void SymbolServer::WorkerThread()
+{
+}
+
+void SymbolServer::StopWorkers()
+{
+}
+
+void SymbolServer::DispatchRequests(u64 clientId, Client& client)
+{
+}
+
+void SymbolServer::SendOutput(Client& client)
+{
+}
+
+#else
+
+static bool SetNonBlocking(int fd)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+	return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+//Set by SIGINT/SIGTERM, which also wake the polling thread through its pipe
+static volatile sig_atomic_t s_stopRequested = 0;
+static volatile int s_stopWakeFd = -1;
+
+static void StopSignalHandler(int)
+{
+	//Don't clobber errno of whatever call was interrupted
+	int savedErrno = errno;
+	s_stopRequested = 1;
+
+	char wake = 0;
+	ssize_t written = write(s_stopWakeFd, &wake, 1);
+	(void)written;
+
+	errno = savedErrno;
+}
+
+//A socket left by a server that exited without cleaning up. Anything else at the path, including a
+//socket a running server still accepts on, is not ours to remove.
+static bool IsStaleSocket(const sockaddr_un& address)
+{
+	struct stat pathStat;
+	if(lstat(address.sun_path, &pathStat) != 0 || !S_ISSOCK(pathStat.st_mode))
+	{
+		return false;
+	}
+
+	int probeSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(probeSocket < 0)
+	{
+		return false;
+	}
+
+	bool listening = (connect(probeSocket, (const sockaddr*)&address, sizeof(address)) == 0);
+	close(probeSocket);
+	return !listening;
+}
+
+bool SymbolServer::Run(const std::string& socketPath, int numThreads)
+{
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+
+	if(socketPath.size() >= sizeof(address.sun_path))
+	{
+		m_error = "Socket path too long";
+		return false;
+	}
+
+	strcpy(address.sun_path, socketPath.c_str());
+
+	int listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(listenSocket < 0)
+	{
+		m_error = "Could not create socket";
+		return false;
+	}
+
+	//Remove stale socket from a previous run
+	if(IsStaleSocket(address))
+	{
+		unlink(socketPath.c_str());
+	}
+
+	if(bind(listenSocket, (sockaddr*)&address, sizeof(address)) != 0)
+	{
+		m_error = "Could not listen on " + socketPath + ((errno == EADDRINUSE) ? ", address in use" : "");
+		close(listenSocket);
+		return false;
+	}
+
+	if(listen(listenSocket, SOMAXCONN) != 0 || !SetNonBlocking(listenSocket))
+	{
+		m_error = "Could not listen on " + socketPath;
+		close(listenSocket);
+		unlink(socketPath.c_str());
+		return false;
+	}
+
+	if(pipe(m_wakePipe) != 0 || !SetNonBlocking(m_wakePipe[0]) || !SetNonBlocking(m_wakePipe[1]))
+	{
+		m_error = "Could not create wake pipe";
+		close(listenSocket);
+		unlink(socketPath.c_str());
+		return false;
+	}
+
+	//Stop cleanly on SIGINT/SIGTERM, previous handlers restored on return
+	struct sigaction stopAction;
+	struct sigaction previousIntAction;
+	struct sigaction previousTermAction;
+	memset(&stopAction, 0, sizeof(stopAction));
+	stopAction.sa_handler = StopSignalHandler;
+	sigemptyset(&stopAction.sa_mask);
+
+	s_stopRequested = 0;
+	s_stopWakeFd = m_wakePipe[1];
+	sigaction(SIGINT, &stopAction, &previousIntAction);
+	sigaction(SIGTERM, &stopAction, &previousTermAction);
+
+	//Start workers
+	if(numThreads < 1)
+	{
+		numThreads = 1;
+	}
+
+	m_stopping = false;
+
+	for(int i = 0; i < numThreads; i++)
+	{
+		m_workers.push_back(std::thread(&SymbolServer::WorkerThread, this));
+	}
+
+	std::vector<pollfd> pollFds;
+	std::vector<u64> pollClientIds;
+	char buffer[64 * 1024];
+	bool stopped = false;
+
+	while(true)
+	{
+		if(s_stopRequested)
+		{
+			stopped = true;
+			break;
+		}
+
+		//Listening socket and wake pipe, then clients. A client is only read while it has nothing in flight,
+		//so it can't queue more than one read ahead of its responses.
+		pollFds.clear();
+		pollClientIds.clear();
+
+		pollfd listenFd = { listenSocket, POLLIN, 0 };
+		pollfd wakeFd = { m_wakePipe[0], POLLIN, 0 };
+		pollFds.push_back(listenFd);
+		pollFds.push_back(wakeFd);
+
+		for(std::map<u64, Client>::iterator it = m_clients.begin(); it != m_clients.end(); ++it)
+		{
+			const Client& client = it->second;
+			short events = 0;
+
+			if(!client.inputClosed && !client.disconnect && !client.busy && client.output.empty())
+				events |= POLLIN;
+			if(!client.output.empty())
+				events |= POLLOUT;
+
+			if(events)
+			{
+				pollfd clientFd = { client.socket, events, 0 };
+				pollFds.push_back(clientFd);
+				pollClientIds.push_back(it->first);
+			}
+		}
+
+		if(poll(&pollFds[0], pollFds.size(), -1) < 0)
+		{
+			if(errno == EINTR)
+				continue;
+
+			m_error = "Poll failed";
+			break;
+		}
+
+		//Queue responses of answered batches, in order per client as each has at most one in flight
+		if(pollFds[1].revents & POLLIN)
+		{
+			char wake[256];
+			while(read(m_wakePipe[0], wake, sizeof(wake)) > 0)
+			{
+			}
+
+			std::deque<Batch> answered;
+
+			{
+				std::lock_guard<std::mutex> lock(m_batchMutex);
+				answered.swap(m_answeredBatches);
+			}
+
+			for(u32 i = 0; i < answered.size(); i++)
+			{
+				std::map<u64, Client>::iterator it = m_clients.find(answered[i].clientId);
+				if(it != m_clients.end())
+				{
+					Client& client = it->second;
+					client.output += answered[i].response;
+					client.busy = false;
+					client.disconnect = answered[i].disconnect;
+					SendOutput(client);
+				}
+			}
+		}
+
+		for(u32 i = 2; i < pollFds.size(); i++)
+		{
+			Client& client = m_clients[pollClientIds[i - 2]];
+			short revents = pollFds[i].revents;
+
+			if((pollFds[i].events & POLLOUT) && (revents & (POLLOUT | POLLHUP | POLLERR)))
+			{
+				SendOutput(client);
+			}
+
+			if((pollFds[i].events & POLLIN) && (revents & (POLLIN | POLLHUP | POLLERR)))
+			{
+				ssize_t received = recv(client.socket, buffer, sizeof(buffer), 0);
+				if(received > 0)
+					client.input.append(buffer, (size_t)received);
+				else if(received == 0 || (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK))
+					client.inputClosed = true;
+			}
+		}
+
+		//Hand out complete lines, and close clients that are done once their responses are sent
+		for(std::map<u64, Client>::iterator it = m_clients.begin(); it != m_clients.end();)
+		{
+			Client& client = it->second;
+
+			if(!client.busy && !client.disconnect && !client.dropped)
+			{
+				DispatchRequests(it->first, client);
+			}
+
+			if(client.dropped || ((client.disconnect || client.inputClosed) && !client.busy && client.output.empty()))
+			{
+				close(client.socket);
+				m_clients.erase(it++);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		if(pollFds[0].revents & POLLIN)
+		{
+			int clientSocket = accept(listenSocket, NULL, NULL);
+			if(clientSocket >= 0)
+			{
+				if(SetNonBlocking(clientSocket))
+				{
+					Client& client = m_clients[m_nextClientId++];
+					client.socket = clientSocket;
+					client.busy = false;
+					client.inputClosed = false;
+					client.disconnect = false;
+					client.dropped = false;
+				}
+				else
+				{
+					close(clientSocket);
+				}
+			}
+			else if(errno != EINTR && errno != ECONNABORTED && errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				m_error = "Accept failed";
+				break;
+			}
+		}
+	}
+
+	sigaction(SIGINT, &previousIntAction, NULL);
+	sigaction(SIGTERM, &previousTermAction, NULL);
+	s_stopWakeFd = -1;
+
+	StopWorkers();
+
+	for(std::map<u64, Client>::iterator it = m_clients.begin(); it != m_clients.end(); ++it)
+	{
+		close(it->second.socket);
+	}
+
+	m_clients.clear();
+
+	close(m_wakePipe[0]);
+	close(m_wakePipe[1]);
+	m_wakePipe[0] = -1;
+	m_wakePipe[1] = -1;
+
+	close(listenSocket);
+	unlink(socketPath.c_str());
+	return stopped;
+}
+
+void SymbolServer::WorkerThread()
+{
+	while(true)
+	{
+		Batch batch;
+
+		{
+			std::unique_lock<std::mutex> lock(m_batchMutex);
+			while(m_pendingBatches.empty() && !m_stopping)
+			{
+				m_batchCondition.wait(lock);
+			}
+
+			if(m_stopping)
+			{
+				return;
+			}
+
+			batch.requests.swap(m_pendingBatches.front().requests);
+			batch.clientId = m_pendingBatches.front().clientId;
+			m_pendingBatches.pop_front();
+		}
+
+		//Requests after a quit are dropped with the connection
+		batch.disconnect = false;
+
+		for(u32 i = 0; i < batch.requests.size() && !batch.disconnect; i++)
+		{
+			batch.disconnect = !HandleRequest(batch.requests[i], batch.response);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_batchMutex);
+			m_answeredBatches.push_back(Batch());
+			m_answeredBatches.back().clientId = batch.clientId;
+			m_answeredBatches.back().response.swap(batch.response);
+			m_answeredBatches.back().disconnect = batch.disconnect;
+		}
+
+		//If the pipe is full the poller is already due to wake
+		char wake = 0;
+		ssize_t written = write(m_wakePipe[1], &wake, 1);
+		(void)written;
+	}
+}
+
+void SymbolServer::StopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_batchMutex);
+		m_stopping = true;
+	}
+
+	m_batchCondition.notify_all();
+
+	for(u32 i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i].join();
+	}
+
+	m_workers.clear();
+	m_pendingBatches.clear();
+	m_answeredBatches.clear();
+}
+
+void SymbolServer::DispatchRequests(u64 clientId, Client& client)
+{
+	Batch batch;
+	batch.clientId = clientId;
+	batch.disconnect = false;
+
+	size_t lineStart = 0;
+	size_t lineEnd;
+	while((lineEnd = client.input.find('\n', lineStart)) != std::string::npos)
+	{
+		size_t length = lineEnd - lineStart;
+		if(length > 0 && client.input[lineEnd - 1] == '\r')
+			length--;
+
+		if(length > SYMBOL_SERVER_MAX_LINE)
+		{
+			client.dropped = true;
+			return;
+		}
+
+		batch.requests.push_back(client.input.substr(lineStart, length));
+		lineStart = lineEnd + 1;
+	}
+
+	client.input.erase(0, lineStart);
+
+	//Nothing sane sends lines this long, don't buffer without limit waiting for the end
+	if(client.input.size() > SYMBOL_SERVER_MAX_LINE)
+	{
+		client.dropped = true;
+		return;
+	}
+
+	if(!batch.requests.empty())
+	{
+		client.busy = true;
+
+		{
+			std::lock_guard<std::mutex> lock(m_batchMutex);
+			m_pendingBatches.push_back(Batch());
+			m_pendingBatches.back().clientId = clientId;
+			m_pendingBatches.back().requests.swap(batch.requests);
+		}
+
+		m_batchCondition.notify_one();
+	}
+}
+
+void SymbolServer::SendOutput(Client& client)
+{
+	size_t sent = 0;
+
+	while(sent < client.output.size())
+	{
+		ssize_t result = send(client.socket, client.output.data() + sent, client.output.size() - sent, MSG_NOSIGNAL);
+		if(result < 0 && errno == EINTR)
+			continue;
+
+		//Rest when writable again
+		if(result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+
+		if(result <= 0)
+		{
+			client.dropped = true;
+			break;
+		}
+
+		sent += (size_t)result;
+	}
+
+	client.output.erase(0, sent);
+}
+
+#endif
@@ -0,0 +1,98 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "FileCOFF.h"
+
+//Resident symbolisation server, answers line based queries over a Unix domain socket.
+//
+//Requests, one per line, optional file index defaults to 0:
+//	addr2line [hex address] [file]	->	address, file:line, symbol+offset
+//	sym2addr [name] [file]			->	name, address, section
+//	romrange [file]					->	ROM start, ROM end
+//	files							->	file count, then one filename per line
+//	quit							->	closes connection
+//
+//Each request line, empty ones included, gets exactly one response line (except files), errors start with "ERROR".
+//A client sending a line longer than SYMBOL_SERVER_MAX_LINE is disconnected.
+#define SYMBOL_SERVER_MAX_LINE	4096
+
+class SymbolServer
+{
+public:
+	SymbolServer();
+
+	//Files must be loaded, with name index built, and outlive the server
+	void AddFile(const std::string& filename, const FileCOFF* coffFile);
+
+	//Listens and polls all clients on the calling thread, handing each client's complete request lines to a pool
+	//of worker threads as one batch. Blocks until SIGINT/SIGTERM or a socket error, then stops and joins the workers
+	//and removes the socket. Returns true if stopped by a signal. Won't replace a socket another server is listening on.
+	bool Run(const std::string& socketPath, int numThreads);
+
+	//Handles one request line, appends response line(s). Returns false if the client should be disconnected.
+	bool HandleRequest(const std::string& request, std::string& response) const;
+
+	const std::string& GetError() const { return m_error; }
+
+private:
+	//Connection state, owned by the polling thread
+	struct Client
+	{
+		int socket;
+		std::string input;
+		std::string output;
+		bool busy;			//Batch with a worker, the next waits so responses stay in order
+		bool inputClosed;
+		bool disconnect;	//Quit, closed once the responses before it are sent
+		bool dropped;		//Closed now, e.g. on a send error or an overlong line
+	};
+
+	//Request lines of one client, and their responses
+	struct Batch
+	{
+		u64 clientId;
+		std::vector<std::string> requests;
+		std::string response;
+		bool disconnect;
+	};
+
+	void WorkerThread();
+	void StopWorkers();
+	void DispatchRequests(u64 clientId, Client& client);
+	void SendOutput(Client& client);
+
+	std::vector<std::string> m_filenames;
+	std::vector<const FileCOFF*> m_files;
+
+	std::map<u64, Client> m_clients;
+	u64 m_nextClientId;
+
+	//Batches waiting for a worker, and answered ones waiting for the polling thread
+	std::deque<Batch> m_pendingBatches;
+	std::deque<Batch> m_answeredBatches;
+	std::mutex m_batchMutex;
+	std::condition_variable m_batchCondition;
+	bool m_stopping;
+
+	std::vector<std::thread> m_workers;
+
+	//Workers write a byte to wake the polling thread when a batch is answered
+	int m_wakePipe[2];
+
+	std::string m_error;
+};
@@ -0,0 +1,304 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#include <cstring>
+#include <string>
+
+#include "TableWriter.h"
+
+#if defined(_WIN32)
+#define strcasecmp _stricmp
+#else
+#include <strings.h>
+#endif
+
+static void AppendU16(std::string& buffer, u16 value)
+{
+	char bytes[2] = { (char)(value & 0xFF), (char)(value >> 8) };
+	buffer.append(bytes, sizeof(bytes));
+}
+
+static void AppendU32(std::string& buffer, u32 value)
+{
+	char bytes[4] = { (char)(value & 0xFF), (char)((value >> 8) & 0xFF), (char)((value >> 16) & 0xFF), (char)(value >> 24) };
+	buffer.append(bytes, sizeof(bytes));
+}
+
+static u32 AppendString(std::string& strings, const char* string)
+{
+	u32 offset = (u32)strings.size();
+	strings.append(string);
+	strings.push_back(0);
+	return offset;
+}
+
+static void WriteTableBlock(u32 tableType, u32 recordCount, u32 recordSize, const std::string& records, const std::string& strings, OutputStream& stream)
+{
+	std::string header;
+	AppendU32(header, TABLE_BLOCK_MAGIC);
+	AppendU32(header, tableType);
+	AppendU32(header, recordCount);
+	AppendU32(header, recordSize);
+	AppendU32(header, (u32)strings.size());
+
+	stream << header << records << strings;
+}
+
+bool ParseOutputFormat(const char* name, OutputFormat& format)
+{
+	if(strcasecmp(name, "text") == 0)
+		format = FORMAT_TEXT;
+	else if(strcasecmp(name, "json") == 0)
+		format = FORMAT_JSON;
+	else if(strcasecmp(name, "csv") == 0)
+		format = FORMAT_CSV;
+	else if(strcasecmp(name, "binary") == 0)
+		format = FORMAT_BINARY;
+	else
+		return false;
+
+	return true;
+}
+
+void WriteJSONString(const char* string, OutputStream& stream)
+{
+	stream << '"';
+
+	for(const char* ptr = string; *ptr; ptr++)
+	{
+		char character = *ptr;
+
+		if(character == '"' || character == '\\')
+			stream << '\\' << character;
+		else if((u8)character < 0x20)
+			stream << "\\u" << Hex((u8)character, 4);
+		else
+			stream << character;
+	}
+
+	stream << '"';
+}
+
+void WriteCSVField(const char* string, OutputStream& stream)
+{
+	//Only quote when needed, quotes are doubled
+	if(!strpbrk(string, ",\"\r\n"))
+	{
+		stream << string;
+		return;
+	}
+
+	stream << '"';
+
+	for(const char* ptr = string; *ptr; ptr++)
+	{
+		if(*ptr == '"')
+			stream << '"';
+
+		stream << *ptr;
+	}
+
+	stream << '"';
+}
+
+void WritePercent(u64 value, u64 total, OutputStream& stream)
+{
+	u64 hundredths = (total > 0) ? (((value * 10000) + (total / 2)) / total) : 0;
+	stream << (hundredths / 100) << "." << (char)('0' + (hundredths / 10) % 10) << (char)('0' + hundredths % 10);
+}
+
+void WriteSectionTable(const FileCOFF& coffFile, OutputFormat format, OutputStream& stream)
+{
+	const std::vector<FileCOFF::SectionHeader>& sections = coffFile.m_sectionHeaders;
+
+	if(format == FORMAT_CSV)
+	{
+		stream << "index,name,physicalAddr,virtualAddr,size,dataOffset,relocationOffset,lineNumberOffset,numRelocations,numLineNumbers,flags\n";
+	}
+
+	std::string records;
+	std::string strings;
+
+	for(int i = 0; i < sections.size(); i++)
+	{
+		const FileCOFF::SectionHeader& section = sections[i];
+
+		if(format == FORMAT_JSON)
+		{
+			stream << "{\"type\":\"section\",\"index\":" << (i + 1) << ",\"name\":";
+			WriteJSONString(section.name.c_str(), stream);
+			stream << ",\"physicalAddr\":" << section.physicalAddr << ",\"virtualAddr\":" << section.virtualAddr << ",\"size\":" << section.size;
+			stream << ",\"dataOffset\":" << section.sectiondataOffset << ",\"relocationOffset\":" << section.relocationTableOffset << ",\"lineNumberOffset\":" << section.lineNumberTableOffset;
+			stream << ",\"numRelocations\":" << section.numRelocationEntries << ",\"numLineNumbers\":" << section.numLineNumberTableEntries << ",\"flags\":" << section.flags << "}\n";
+		}
+		else if(format == FORMAT_CSV)
+		{
+			stream << (i + 1) << ",";
+			WriteCSVField(section.name.c_str(), stream);
+			stream << "," << section.physicalAddr << "," << section.virtualAddr << "," << section.size;
+			stream << "," << section.sectiondataOffset << "," << section.relocationTableOffset << "," << section.lineNumberTableOffset;
+			stream << "," << section.numRelocationEntries << "," << section.numLineNumberTableEntries << "," << section.flags << "\n";
+		}
+		else if(format == FORMAT_BINARY)
+		{
+			char name[COFF_SECTION_NAME_SIZE] = { 0 };
+			strncpy(name, section.name.c_str(), COFF_SECTION_NAME_SIZE);
+			records.append(name, COFF_SECTION_NAME_SIZE);
+			AppendU32(records, section.physicalAddr);
+			AppendU32(records, section.virtualAddr);
+			AppendU32(records, section.size);
+			AppendU32(records, section.sectiondataOffset);
+			AppendU32(records, section.relocationTableOffset);
+			AppendU32(records, section.lineNumberTableOffset);
+			AppendU16(records, section.numRelocationEntries);
+			AppendU16(records, section.numLineNumberTableEntries);
+			AppendU32(records, section.flags);
+		}
+	}
+
+	if(format == FORMAT_BINARY)
+	{
+		WriteTableBlock(TABLE_TYPE_SECTIONS, (u32)sections.size(), COFF_SECTION_HEADER_SIZE, records, strings, stream);
+	}
+}
+
+void WriteSymbolTable(const FileCOFF& coffFile, OutputFormat format, OutputStream& stream)
+{
+	const ArrayView<FileCOFF::Symbol>& symbols = coffFile.GetSymbols();
+	const ArrayView<u32>& sortedIndices = coffFile.GetSortedSymbolIndices();
+
+	if(format == FORMAT_TEXT)
+	{
+		stream << "-------------------------------------\n";
+		stream << "SYMBOLS\n";
+		stream << "-------------------------------------\n";
+	}
+	else if(format == FORMAT_CSV)
+	{
+		stream << "name,value,section,sectionName,symbolType,storageClass\n";
+	}
+
+	std::string records;
+	std::string strings;
+
+	if(format == FORMAT_BINARY)
+	{
+		records.reserve(symbols.size() * 16);
+	}
+
+	for(int i = 0; i < sortedIndices.size(); i++)
+	{
+		const FileCOFF::Symbol& symbol = symbols[sortedIndices[i]];
+
+		if(format == FORMAT_TEXT)
+		{
+			stream << "0x" << Hex(symbol.value) << "\t" << coffFile.GetSymbolName(symbol) << "\n";
+		}
+		else if(format == FORMAT_JSON)
+		{
+			stream << "{\"type\":\"symbol\",\"name\":";
+			WriteJSONString(coffFile.GetSymbolName(symbol), stream);
+			stream << ",\"value\":" << symbol.value << ",\"section\":" << symbol.sectionIndex << ",\"sectionName\":";
+			WriteJSONString(coffFile.GetSectionName(symbol.sectionIndex), stream);
+			stream << ",\"symbolType\":" << symbol.symbolType << ",\"storageClass\":" << symbol.storageClass << ",\"typeName\":";
+			WriteJSONString(FileCOFF::GetSymbolTypeName(symbol.symbolType).c_str(), stream);
+			stream << ",\"storageClassName\":";
+			WriteJSONString(FileCOFF::GetStorageClassName(symbol.storageClass), stream);
+			stream << ",\"size\":" << symbol.size << "}\n";
+		}
+		else if(format == FORMAT_CSV)
+		{
+			WriteCSVField(coffFile.GetSymbolName(symbol), stream);
+			stream << "," << symbol.value << "," << symbol.sectionIndex << ",";
+			WriteCSVField(coffFile.GetSectionName(symbol.sectionIndex), stream);
+			stream << "," << symbol.symbolType << "," << symbol.storageClass << "\n";
+		}
+		else
+		{
+			AppendU32(records, symbol.value);
+			AppendU32(records, AppendString(strings, coffFile.GetSymbolName(symbol)));
+			AppendU16(records, (u16)symbol.sectionIndex);
+			AppendU16(records, symbol.symbolType);
+			records.push_back((char)symbol.storageClass);
+			records.push_back((char)symbol.auxCount);
+			AppendU16(records, 0);
+		}
+	}
+
+	if(format == FORMAT_BINARY)
+	{
+		WriteTableBlock(TABLE_TYPE_SYMBOLS, (u32)symbols.size(), 16, records, strings, stream);
+	}
+}
+
+void WriteLineTable(const FileCOFF& coffFile, OutputFormat format, OutputStream& stream)
+{
+	const FileCOFF::LineTable& lineTable = coffFile.GetLineTable();
+	u32 count = lineTable.GetCount();
+
+	if(format == FORMAT_TEXT)
+	{
+		stream << "-------------------------------------\n";
+		stream << "LINES\n";
+		stream << "-------------------------------------\n";
+	}
+	else if(format == FORMAT_CSV)
+	{
+		stream << "address,endAddress,filename,line\n";
+	}
+
+	std::string records;
+	std::string strings;
+	std::vector<u32> filenameOffsets;
+
+	if(format == FORMAT_BINARY)
+	{
+		//Each filename stored once
+		for(u32 i = 0; i < coffFile.GetNumLineFilenames(); i++)
+		{
+			filenameOffsets.push_back(AppendString(strings, coffFile.GetLineFilename(i)));
+		}
+
+		records.reserve(count * 16);
+	}
+
+	for(u32 i = 0; i < count; i++)
+	{
+		const char* filename = coffFile.GetLineFilename(lineTable.fileIndices[i]);
+
+		if(format == FORMAT_TEXT)
+		{
+			stream << "0x" << Hex(lineTable.addresses[i]) << "\t0x" << Hex(lineTable.endAddresses[i]) << "\t" << filename << ":" << lineTable.lineNumbers[i] << "\n";
+		}
+		else if(format == FORMAT_JSON)
+		{
+			stream << "{\"type\":\"line\",\"address\":" << lineTable.addresses[i] << ",\"endAddress\":" << lineTable.endAddresses[i] << ",\"filename\":";
+			WriteJSONString(filename, stream);
+			stream << ",\"line\":" << lineTable.lineNumbers[i] << "}\n";
+		}
+		else if(format == FORMAT_CSV)
+		{
+			stream << lineTable.addresses[i] << "," << lineTable.endAddresses[i] << ",";
+			WriteCSVField(filename, stream);
+			stream << "," << lineTable.lineNumbers[i] << "\n";
+		}
+		else
+		{
+			AppendU32(records, lineTable.addresses[i]);
+			AppendU32(records, lineTable.endAddresses[i]);
+			AppendU32(records, filenameOffsets[lineTable.fileIndices[i]]);
+			AppendU16(records, (u16)lineTable.lineNumbers[i]);
+			AppendU16(records, 0);
+		}
+	}
+
+	if(format == FORMAT_BINARY)
+	{
+		WriteTableBlock(TABLE_TYPE_LINES, count, 16, records, strings, stream);
+	}
+}
@@ -0,0 +1,48 @@
+// ============================================================
+//   Matt Phillips (c) 2016 BIG EVIL CORPORATION
+// ============================================================
+//   http://www.bigevilcorporation.co.uk
+// ============================================================
+//   sn68kcoffdump - A SNASM68K COFF file info dump utility
+// ============================================================
+
+#pragma once
+
+#include "FileCOFF.h"
+#include "OutputStream.h"
+
+enum OutputFormat
+{
+	FORMAT_TEXT,
+	FORMAT_JSON,	//One JSON object per line, with a "type" field
+	FORMAT_CSV,		//Header row, then one row per record
+	FORMAT_BINARY	//Packed little endian table blocks, see below
+};
+
+//Binary table block:
+//	u32 magic ('SNCT'), u32 table type, u32 record count, u32 record size, u32 strings size
+//	records[record count], each record size bytes
+//	strings[strings size], NULL terminated, referenced by offset from records
+//Blocks may be concatenated, readers should skip unknown table types using the sizes.
+#define TABLE_BLOCK_MAGIC		0x54434E53
+#define TABLE_TYPE_SECTIONS		1
+#define TABLE_TYPE_SYMBOLS		2
+#define TABLE_TYPE_LINES		3
+
+//Section record (40 bytes): char name[8], u32 physicalAddr, u32 virtualAddr, u32 size, u32 dataOffset,
+//	u32 relocationOffset, u32 lineNumberOffset, u16 numRelocations, u16 numLineNumbers, u32 flags
+//Symbol record (16 bytes): u32 value, u32 nameOffset, s16 sectionIndex, u16 symbolType, s8 storageClass, u8 auxCount, u16 padding
+//Line record (16 bytes): u32 address, u32 endAddress, u32 filenameOffset, s16 lineNumber, u16 padding
+
+bool ParseOutputFormat(const char* name, OutputFormat& format);
+
+void WriteSectionTable(const FileCOFF& coffFile, OutputFormat format, OutputStream& stream);
+void WriteSymbolTable(const FileCOFF& coffFile, OutputFormat format, OutputStream& stream);
+void WriteLineTable(const FileCOFF& coffFile, OutputFormat format, OutputStream& stream);
+
+//Escaped field writers, shared with query output
+void WriteJSONString(const char* string, OutputStream& stream);
+void WriteCSVField(const char* string, OutputStream& stream);
+
+//Percentage of total to two decimal places, e.g. 12.34, without floating point formatting
+void WritePercent(u64 value, u64 total, OutputStream& stream);
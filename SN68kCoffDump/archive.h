@@ -1,9 +1,20 @@
 #pragma once
 
 #include <string>
+#include <cstring>
 
 #include "atoms.h"
 
+//Explicit byte order decoding, independent of host endianness
+inline u16 ReadU16LE(const u8* data) { return (u16)(data[0] | (data[1] << 8)); }
+inline u32 ReadU32LE(const u8* data) { return (u32)data[0] | ((u32)data[1] << 8) | ((u32)data[2] << 16) | ((u32)data[3] << 24); }
+inline u16 ReadU16BE(const u8* data) { return (u16)((data[0] << 8) | data[1]); }
+inline u32 ReadU32BE(const u8* data) { return ((u32)data[0] << 24) | ((u32)data[1] << 16) | ((u32)data[2] << 8) | (u32)data[3]; }
+inline void WriteU16LE(u8* data, u16 value) { data[0] = (u8)value; data[1] = (u8)(value >> 8); }
+inline void WriteU32LE(u8* data, u32 value) { data[0] = (u8)value; data[1] = (u8)(value >> 8); data[2] = (u8)(value >> 16); data[3] = (u8)(value >> 24); }
+
+//Serialises in both directions over a fixed size buffer. Output streams write into
+//the caller's buffer, which must be zeroed and big enough for the whole layout.
 class Stream
 {
 public:
@@ -19,24 +30,66 @@ public:
 		SEEK_CURRENT
 	};
 
-	Stream(char* ptr)
+	Stream(char* ptr, u64 size, Direction direction = STREAM_IN)
 	{
-		//TODO: Output support
-		m_direction = STREAM_IN;
+		m_direction = direction;
 		m_start = ptr;
 		m_ptr = ptr;
+		m_end = ptr + size;
+		m_error = false;
 	}
 
 	Direction GetDirection() const { return m_direction; }
+	char* GetPtr() const { return m_ptr; }
+	u64 GetSize() const { return (u64)(m_end - m_start); }
+	u64 GetPosition() const { return (u64)(m_ptr - m_start); }
+
+	//Set on any out of bounds seek, read or write, reads past the end return zeroes
+	bool HasError() const { return m_error; }
+
+	//Checks a range lies within the stream, without moving
+	bool IsInRange(u64 offset, u64 length) const
+	{
+		return offset <= GetSize() && length <= (GetSize() - offset);
+	}
 
 	s64 Seek(s64 offset, SeekBase base)
 	{
-		if(base == SEEK_START)
-			m_ptr = (char*)(m_start + offset);
-		else if(base == SEEK_CURRENT)
-			m_ptr += offset;
+		s64 position = offset;
+		if(base == SEEK_CURRENT)
+			position += (s64)GetPosition();
+
+		if(position < 0 || (u64)position > GetSize())
+		{
+			m_error = true;
+			position = (s64)GetSize();
+		}
+
+		m_ptr = (char*)(m_start + position);
+
+		return position;
+	}
+
+	//Returns a view of the next length bytes and skips them, or NULL if out of bounds
+	const u8* Read(u64 length)
+	{
+		if(!Reserve(length))
+			return NULL;
+
+		const u8* data = (const u8*)m_ptr;
+		m_ptr += length;
+		return data;
+	}
+
+	//Returns space for the next length bytes and skips it, or NULL if out of bounds
+	u8* Write(u64 length)
+	{
+		if(!Reserve(length))
+			return NULL;
 
-		return (s64)(m_ptr - m_start);
+		u8* data = (u8*)m_ptr;
+		m_ptr += length;
+		return data;
 	}
 
 	template <typename T> void Serialise(T& value)
@@ -46,65 +99,117 @@ public:
 
 	void Serialise(u8& value)
 	{
-		value = *(u8*)m_ptr;
-		m_ptr += sizeof(u8);
+		Serialise(&value, sizeof(u8));
 	}
 
 	void Serialise(s8& value)
 	{
-		value = *(s8*)m_ptr;
-		m_ptr += sizeof(s8);
+		Serialise((u8*)&value, sizeof(s8));
 	}
 
 	void Serialise(u16& value)
 	{
-		value = *(u16*)m_ptr;
-		m_ptr += sizeof(u16);
+		if(m_direction == STREAM_OUT)
+		{
+			u8* data = Write(sizeof(u16));
+			if(data)
+				WriteU16LE(data, value);
+		}
+		else
+		{
+			const u8* data = Read(sizeof(u16));
+			value = data ? ReadU16LE(data) : 0;
+		}
 	}
 
 	void Serialise(s16& value)
 	{
-		value = *(s16*)m_ptr;
-		m_ptr += sizeof(s16);
+		Serialise((u16&)value);
 	}
 
 	void Serialise(u32& value)
 	{
-		value = *(u32*)m_ptr;
-		m_ptr += sizeof(u32);
+		if(m_direction == STREAM_OUT)
+		{
+			u8* data = Write(sizeof(u32));
+			if(data)
+				WriteU32LE(data, value);
+		}
+		else
+		{
+			const u8* data = Read(sizeof(u32));
+			value = data ? ReadU32LE(data) : 0;
+		}
 	}
 
 	void Serialise(s32& value)
 	{
-		value = *(s32*)m_ptr;
-		m_ptr += sizeof(s32);
+		Serialise((u32&)value);
 	}
 
+	//Length prefixed, up to 255 characters
 	void Serialise(std::string& value)
 	{
-		u8 length;
+		u8 length = (u8)((value.size() < 0xFF) ? value.size() : 0xFF);
 		Serialise(length);
+		Serialise(value, length);
 		value.resize(length);
-		memcpy(&value[0], m_ptr, length);
-		m_ptr += length;
 	}
 
+	//Fixed length field, zero padded on output
 	void Serialise(std::string& value, u32 length)
 	{
-		value.resize(length + 1);
-		memcpy(&value[0], m_ptr, length);
-		value[length] = 0;
-		m_ptr += length;
+		if(m_direction == STREAM_OUT)
+		{
+			u8* data = Write(length);
+			if(data)
+			{
+				u32 copyLength = (value.size() < length) ? (u32)value.size() : length;
+				memcpy(data, value.data(), copyLength);
+				memset(data + copyLength, 0, length - copyLength);
+			}
+		}
+		else
+		{
+			value.resize(length + 1);
+			Serialise((u8*)&value[0], length);
+			value[length] = 0;
+		}
 	}
 
 	void Serialise(u8* value, u32 length)
 	{
-		memcpy(value, m_ptr, length);
-		m_ptr += length;
+		if(m_direction == STREAM_OUT)
+		{
+			u8* data = Write(length);
+			if(data)
+				memcpy(data, value, length);
+		}
+		else
+		{
+			const u8* data = Read(length);
+			if(data)
+				memcpy(value, data, length);
+			else
+				memset(value, 0, length);
+		}
 	}
 
 private:
+	bool Reserve(u64 length)
+	{
+		if(length > (u64)(m_end - m_ptr))
+		{
+			m_error = true;
+			return false;
+		}
+
+		return true;
+	}
+
 	const char* m_start;
+	const char* m_end;
 	char* m_ptr;
 	Direction m_direction;
-};
\ No newline at end of file
+	bool m_error;
+};
@@ -5,11 +5,22 @@
 
 #pragma once
 
-#include "targetver.h"
-
 #include <stdio.h>
+
+#if defined(_WIN32)
+
+#include "targetver.h"
 #include <tchar.h>
 
+#else
+
+//Portable equivalents of the MSVC entry point and string functions
+#include <strings.h>
+
+typedef char _TCHAR;
+#define _tmain main
+#define _stricmp strcasecmp
 
+#endif
 
 // TODO: reference additional headers your program requires here
@@ -1,18 +1,44 @@
 #pragma once
 
+#include <chrono>
+
 #include "atoms.h"
-#include "windows.h"
 
-void UnixTimeToFileTime(u32 unixTime, FILETIME& fileTime)
+//Monotonic wall clock for timing, in nanoseconds from an arbitrary start
+inline u64 GetTimeNs()
 {
-	u64 temp = Int32x32To64(unixTime, 10000000) + 116444736000000000;
-	fileTime.dwLowDateTime = (u32)temp;
-	fileTime.dwHighDateTime = temp >> 32;
+	return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
-void UnixTimeToSystemTime(u32 unixTime, SYSTEMTIME& systemTime)
+struct DateTime
+{
+	u16 year;
+	u16 month;
+	u16 day;
+	u16 hour;
+	u16 minute;
+	u16 second;
+};
+
+//UTC calendar date from Unix time, proleptic Gregorian (days-from-civil inverse)
+inline void UnixTimeToDateTime(u32 unixTime, DateTime& dateTime)
 {
-	FILETIME fileTime;
-	UnixTimeToFileTime(unixTime, fileTime);
-	FileTimeToSystemTime(&fileTime, &systemTime);
-}
\ No newline at end of file
+	s64 days = unixTime / 86400;
+	u32 secondOfDay = unixTime % 86400;
+
+	dateTime.hour = (u16)(secondOfDay / 3600);
+	dateTime.minute = (u16)((secondOfDay % 3600) / 60);
+	dateTime.second = (u16)(secondOfDay % 60);
+
+	//Shift epoch to 0000-03-01 so leap days fall at end of year
+	days += 719468;
+	s64 era = days / 146097;
+	u32 dayOfEra = (u32)(days - era * 146097);
+	u32 yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+	u32 dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+	u32 monthIndex = (5 * dayOfYear + 2) / 153;
+
+	dateTime.day = (u16)(dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+	dateTime.month = (u16)(monthIndex < 10 ? monthIndex + 3 : monthIndex - 9);
+	dateTime.year = (u16)(yearOfEra + era * 400 + (dateTime.month <= 2 ? 1 : 0));
+}